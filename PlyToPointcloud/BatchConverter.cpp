@@ -0,0 +1,310 @@
+#include "BatchConverter.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <filesystem>
+#include <chrono>
+#include <cctype>
+
+BatchConverter::BatchConverter(UINT workerCount, UINT64 memoryBudget) : workerCount(max(1U, workerCount)), memoryBudget(memoryBudget)
+{
+}
+
+bool BatchConverter::Add(const std::string& path)
+{
+	std::error_code error;
+	bool found = false;
+	std::string pattern = std::filesystem::path(path).generic_string();
+	size_t wildcard = pattern.find_first_of("*?");
+
+	if (wildcard != std::string::npos)
+	{
+		// Search the directory in front of the first wildcard and match the remaining pattern against the relative paths
+		size_t separator = pattern.find_last_of('/', wildcard);
+		std::filesystem::path root = (separator == std::string::npos) ? "." : pattern.substr(0, separator + 1);
+		std::string remainder = (separator == std::string::npos) ? pattern : pattern.substr(separator + 1);
+
+		for (std::filesystem::recursive_directory_iterator it(root, error), end; !error && it != end; it.increment(error))
+		{
+			std::error_code fileError;
+			std::string relative = it->path().lexically_relative(root).generic_string();
+
+			if (it->is_regular_file(fileError) && MatchPattern(remainder.c_str(), relative.c_str()))
+			{
+				found |= AddFile(it->path().string());
+			}
+		}
+	}
+	else if (std::filesystem::is_directory(path, error))
+	{
+		for (std::filesystem::recursive_directory_iterator it(path, error), end; !error && it != end; it.increment(error))
+		{
+			std::error_code fileError;
+
+			if (it->is_regular_file(fileError) && IsInputFile(it->path().string()))
+			{
+				found |= AddFile(it->path().string());
+			}
+		}
+	}
+	else if (std::filesystem::is_regular_file(path, error))
+	{
+		found |= AddFile(path);
+	}
+
+	return found;
+}
+
+bool BatchConverter::IsEmpty() const
+{
+	return jobs.empty();
+}
+
+UINT64 BatchConverter::Convert(const ConvertFunction& convert, const std::string& summaryFilename)
+{
+	auto batchStart = std::chrono::steady_clock::now();
+
+	// Files that are matched by several arguments are only added once (see AddFile)
+	std::sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) { return a.plyfile < b.plyfile; });
+
+	std::vector<UINT64> pending;
+
+	for (UINT64 i = 0; i < jobs.size(); i++)
+	{
+		Job& job = jobs[i];
+		std::error_code error, outputError;
+		job.inputBytes = std::filesystem::file_size(job.plyfile, error);
+
+		// The .pointcloud file is up to date if it was written after the last change of the .ply file
+		auto inputTime = std::filesystem::last_write_time(job.plyfile, error);
+		auto outputTime = std::filesystem::last_write_time(job.pointcloudfile, outputError);
+
+		if (!error && !outputError && outputTime >= inputTime)
+		{
+			job.status = "skipped";
+			job.outputBytes = std::filesystem::file_size(job.pointcloudfile, outputError);
+			std::cout << "Skipping \"" << job.plyfile << "\", the .pointcloud file is up to date" << std::endl;
+		}
+		else
+		{
+			pending.push_back(i);
+		}
+	}
+
+	// Start with the largest files so that the small ones fill the gaps at the end
+	std::stable_sort(pending.begin(), pending.end(), [&](UINT64 a, UINT64 b) { return jobs[a].inputBytes > jobs[b].inputBytes; });
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	UINT64 nextJob = 0;
+	UINT64 reservedMemory = 0;
+	UINT runningJobs = 0;
+
+	auto work = [&]()
+	{
+		while (true)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			if (nextJob >= pending.size())
+			{
+				return;
+			}
+
+			Job& job = jobs[pending[nextJob++]];
+
+			// Each vertex needs about twice its .ply size for the in memory shuffle and ordering, a single job may always use the whole budget
+			job.memoryBudget = min(memoryBudget, max(minimumJobMemory, 2 * job.inputBytes));
+			condition.wait(lock, [&] { return runningJobs == 0 || reservedMemory + job.memoryBudget <= memoryBudget; });
+			reservedMemory += job.memoryBudget;
+			runningJobs++;
+			lock.unlock();
+
+			// Collect the messages so that the lines of concurrent conversions are not interleaved
+			std::ostringstream log;
+			auto start = std::chrono::steady_clock::now();
+			bool success = convert(job.plyfile, job.memoryBudget, log, job.vertexCount);
+			job.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			// Failed conversions only remove their temporary file, an older .pointcloud file stays and is converted again by the next batch
+			std::error_code error;
+			job.outputBytes = success ? std::filesystem::file_size(job.pointcloudfile, error) : 0;
+			job.status = success ? "converted" : "failed";
+
+			lock.lock();
+			reservedMemory -= job.memoryBudget;
+			runningJobs--;
+			std::cout << log.str() << std::flush;
+			condition.notify_all();
+		}
+	};
+
+	// The calling thread is one of the workers, the conversions share the thread pool for their parallel loops
+	std::vector<std::thread> workers;
+
+	for (UINT i = 1; i < min((UINT64)workerCount, (UINT64)pending.size()); i++)
+	{
+		workers.push_back(std::thread(work));
+	}
+
+	work();
+
+	for (auto it = workers.begin(); it != workers.end(); it++)
+	{
+		it->join();
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+	UINT64 failedCount = std::count_if(jobs.begin(), jobs.end(), [](const Job& job) { return job.status.compare("failed") == 0; });
+	UINT64 skippedCount = std::count_if(jobs.begin(), jobs.end(), [](const Job& job) { return job.status.compare("skipped") == 0; });
+
+	WriteSummary(summaryFilename, seconds);
+
+	std::cout << "Converted " << jobs.size() - skippedCount - failedCount << " files, skipped " << skippedCount << " up to date files, " << failedCount << " failed in " << seconds << " seconds";
+	std::cout << " with " << min((UINT64)workerCount, max(1ULL, (UINT64)pending.size())) << " concurrent conversions, summary written to \"" << summaryFilename << "\"" << std::endl;
+
+	return failedCount;
+}
+
+std::string BatchConverter::GetPointcloudFilename(const std::string& plyfile)
+{
+	return plyfile.substr(0, plyfile.length() - 3) + "pointcloud";
+}
+
+bool BatchConverter::AddFile(const std::string& plyfile)
+{
+	if (!IsInputFile(plyfile))
+	{
+		return false;
+	}
+
+	Job job;
+	job.plyfile = plyfile;
+	job.pointcloudfile = GetPointcloudFilename(plyfile);
+
+	// The same file can be matched by several arguments, different inputs must not overwrite the .pointcloud file of each other
+	std::string output = std::filesystem::path(job.pointcloudfile).lexically_normal().string();
+	auto existing = outputs.find(output);
+
+	if (existing == outputs.end())
+	{
+		outputs[output] = plyfile;
+		jobs.push_back(job);
+	}
+	else if (std::filesystem::path(existing->second).lexically_normal() != std::filesystem::path(plyfile).lexically_normal())
+	{
+		std::cout << "Skipping \"" << plyfile << "\", \"" << existing->second << "\" is converted into the same .pointcloud file" << std::endl;
+	}
+
+	return true;
+}
+
+void BatchConverter::WriteSummary(const std::string& summaryFilename, double seconds) const
+{
+	std::ofstream summary(summaryFilename, std::ios::out | std::ios::trunc);
+	summary << std::setprecision(6) << std::fixed;
+	summary << "{" << std::endl;
+	summary << "\t\"seconds\": " << seconds << "," << std::endl;
+	summary << "\t\"workers\": " << workerCount << "," << std::endl;
+	summary << "\t\"memoryBudget\": " << memoryBudget << "," << std::endl;
+	summary << "\t\"files\": [" << std::endl;
+
+	for (UINT64 i = 0; i < jobs.size(); i++)
+	{
+		const Job& job = jobs[i];
+		bool converted = job.status.compare("converted") == 0;
+		double megabytesPerSecond = (converted && job.seconds > 0) ? job.inputBytes / (1024.0 * 1024.0) / job.seconds : 0;
+		double pointsPerSecond = (converted && job.seconds > 0) ? job.vertexCount / job.seconds : 0;
+
+		summary << "\t\t{ \"input\": \"" << EscapeJson(job.plyfile) << "\", \"output\": \"" << EscapeJson(job.pointcloudfile) << "\", \"status\": \"" << job.status << "\"";
+		summary << ", \"seconds\": " << job.seconds << ", \"points\": " << job.vertexCount << ", \"inputBytes\": " << job.inputBytes << ", \"outputBytes\": " << job.outputBytes;
+		summary << ", \"memoryBudget\": " << job.memoryBudget << ", \"megabytesPerSecond\": " << megabytesPerSecond << ", \"pointsPerSecond\": " << pointsPerSecond << " }";
+		summary << ((i + 1 < jobs.size()) ? "," : "") << std::endl;
+	}
+
+	summary << "\t]" << std::endl;
+	summary << "}" << std::endl;
+}
+
+bool BatchConverter::IsInputFile(const std::string& filename)
+{
+	std::string filetype = filename.substr(filename.find_last_of(".") + 1, filename.length());
+
+	return filetype.compare("ply") == 0 || filetype.compare("PLY") == 0 || filetype.compare("las") == 0 || filetype.compare("LAS") == 0 || filetype.compare("xyz") == 0 || filetype.compare("XYZ") == 0 || filetype.compare("pts") == 0 || filetype.compare("PTS") == 0;
+}
+
+bool BatchConverter::MatchPattern(const char* pattern, const char* path)
+{
+	if (pattern[0] == '*' && pattern[1] == '*')
+	{
+		// Matches any number of directories, "**/" also matches no directory at all
+		const char* rest = pattern + 2;
+		bool directories = (*rest == '/');
+		rest += directories ? 1 : 0;
+
+		for (const char* p = path; ; p++)
+		{
+			if ((!directories || p == path || p[-1] == '/') && MatchPattern(rest, p))
+			{
+				return true;
+			}
+
+			if (*p == '\0')
+			{
+				return false;
+			}
+		}
+	}
+	else if (pattern[0] == '*')
+	{
+		// Matches any number of characters inside the path component
+		for (const char* p = path; ; p++)
+		{
+			if (MatchPattern(pattern + 1, p))
+			{
+				return true;
+			}
+
+			if (*p == '\0' || *p == '/')
+			{
+				return false;
+			}
+		}
+	}
+	else if (pattern[0] == '?')
+	{
+		return *path != '\0' && *path != '/' && MatchPattern(pattern + 1, path + 1);
+	}
+	else if (pattern[0] == '\0')
+	{
+		return *path == '\0';
+	}
+
+	// Windows file names are not case sensitive
+	return std::tolower((unsigned char)*pattern) == std::tolower((unsigned char)*path) && MatchPattern(pattern + 1, path + 1);
+}
+
+std::string BatchConverter::EscapeJson(const std::string& value)
+{
+	std::ostringstream escaped;
+
+	for (char c : value)
+	{
+		if (c == '"' || c == '\\')
+		{
+			escaped << '\\' << c;
+		}
+		else if ((unsigned char)c < 0x20)
+		{
+			escaped << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)(unsigned char)c << std::dec;
+		}
+		else
+		{
+			escaped << c;
+		}
+	}
+
+	return escaped.str();
+}
@@ -0,0 +1,68 @@
+#ifndef BATCHCONVERTER_H
+#define BATCHCONVERTER_H
+
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <ostream>
+#include <functional>
+#include "../PointCloudEngine/ThreadPool.h"
+
+using namespace PointCloudEngine;
+
+// Converts the .ply and .las files of whole directory trees and glob patterns with a bounded number of concurrent conversions
+// Every conversion reserves its memory from a shared budget before it starts, therefore large files run next to fewer other files
+// Files whose .pointcloud file is newer than the input file are skipped, the result of every file is written into a JSON summary
+class BatchConverter
+{
+public:
+	// Converts the .ply file with the given memory budget and writes its messages into the log, returns false if the conversion failed
+	typedef std::function<bool(const std::string& plyfile, UINT64 memoryBudget, std::ostream& log, UINT64& outVertexCount)> ConvertFunction;
+
+	// Memory that every conversion reserves at least, covers the buffers of the chunked .ply reading
+	static const UINT64 minimumJobMemory = 64 * 1024 * 1024;
+
+	BatchConverter(UINT workerCount, UINT64 memoryBudget);
+
+	// Directories are searched recursively for .ply and .las files
+	// Patterns support * and ? inside a path component and ** for any number of directories, e.g. scans/**/*.ply
+	// Returns false if the path does not exist and the pattern does not match any file
+	bool Add(const std::string& path);
+	bool IsEmpty() const;
+
+	// Converts all the files that were added and writes the summary, returns the number of failed conversions
+	UINT64 Convert(const ConvertFunction& convert, const std::string& summaryFilename);
+
+	static std::string GetPointcloudFilename(const std::string& plyfile);
+
+private:
+	struct Job
+	{
+		std::string plyfile;
+		std::string pointcloudfile;
+		std::string status;
+		UINT64 inputBytes = 0;
+		UINT64 outputBytes = 0;
+		UINT64 vertexCount = 0;
+		UINT64 memoryBudget = 0;
+		double seconds = 0;
+	};
+
+	UINT workerCount;
+	UINT64 memoryBudget;
+	std::vector<Job> jobs;
+
+	// Input file of each .pointcloud file, inputs with the same name but another extension (e.g. scan.ply and scan.las) are skipped
+	std::map<std::string, std::string> outputs;
+
+	// Returns false if the file is not an input file, files that were already added or that have the same output are not added again
+	bool AddFile(const std::string& plyfile);
+	void WriteSummary(const std::string& summaryFilename, double seconds) const;
+
+	static bool IsInputFile(const std::string& filename);
+	static bool MatchPattern(const char* pattern, const char* path);
+	static std::string EscapeJson(const std::string& value);
+};
+
+#endif
@@ -0,0 +1,167 @@
+#include "LasReader.h"
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+
+LasReader::LasReader(const std::string& filename, UINT colorBits) : colorShift((colorBits > 8) ? colorBits - 8 : 0)
+{
+	file.open(filename, std::ios::in | std::ios::binary);
+
+	if (!file.is_open())
+	{
+		throw std::exception("Could not open the .las file");
+	}
+
+	ParseHeader();
+}
+
+UINT LasReader::GetPointFormat() const
+{
+	return pointFormat;
+}
+
+const double* LasReader::GetOrigin() const
+{
+	return origin;
+}
+
+UINT64 LasReader::GetVertexCount() const
+{
+	return pointCount;
+}
+
+UINT LasReader::GetVertexSize() const
+{
+	return recordLength;
+}
+
+UINT64 LasReader::ReadRecords(UINT64 maxCount)
+{
+	UINT64 count = min(maxCount, pointCount - pointsRead);
+
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	chunk.resize(count * recordLength);
+	file.read((char*)chunk.data(), count * recordLength);
+
+	if ((UINT64)file.gcount() != count * recordLength)
+	{
+		throw std::exception("The .las file is truncated");
+	}
+
+	pointsRead += count;
+
+	return count;
+}
+
+const BYTE* LasReader::GetRecord(UINT64 index) const
+{
+	return chunk.data() + index * recordLength;
+}
+
+void LasReader::ReadVertex(const BYTE* record, PlyVertex& outVertex) const
+{
+	// The coordinates are computed in double precision and only converted to float relative to the origin, where the scale is still representable
+	double x = ReadValue<int>(record, 0) * scale[0] + (offset[0] - origin[0]);
+	double y = ReadValue<int>(record, 4) * scale[1] + (offset[1] - origin[1]);
+	double z = ReadValue<int>(record, 8) * scale[2] + (offset[2] - origin[2]);
+
+	outVertex.position = Vector3((float)x, (float)y, (float)z);
+	outVertex.normal = Vector3::Zero;
+
+	for (UINT i = 0; i < 3; i++)
+	{
+		outVertex.color[i] = (unsigned char)min(255, ReadColorValue(record, hasColors ? i : 0) >> colorShift);
+	}
+}
+
+bool LasReader::IsLasFile(const std::string& filename)
+{
+	std::string filetype = filename.substr(filename.find_last_of(".") + 1, filename.length());
+
+	return filetype.compare("las") == 0 || filetype.compare("LAS") == 0;
+}
+
+void LasReader::ParseHeader()
+{
+	// The public header block of version 1.4 has 375 bytes, older versions have a shorter header
+	BYTE header[375] = {};
+	file.read((char*)header, sizeof(header));
+
+	if (file.gcount() < 227 || memcmp(header, "LASF", 4) != 0)
+	{
+		throw std::exception("Not a .las file");
+	}
+
+	file.clear();
+
+	UINT versionMajor = header[24];
+	UINT versionMinor = header[25];
+	UINT headerSize = ReadValue<USHORT>(header, 94);
+	UINT pointDataOffset = ReadValue<UINT>(header, 96);
+
+	if (versionMajor != 1 || versionMinor > 4 || headerSize < 227)
+	{
+		throw std::exception("Unsupported .las file version");
+	}
+
+	// LASzip sets the highest bits of the point format of compressed files
+	if ((header[104] & 0xC0) != 0)
+	{
+		throw std::exception("Compressed .laz files are not supported, decompress them with laszip first");
+	}
+
+	pointFormat = header[104];
+	recordLength = ReadValue<USHORT>(header, 105);
+	pointCount = ReadValue<UINT>(header, 107);
+
+	// Version 1.4 files store the number of points as 64 bit value, the legacy value is zero for more than 2^32 - 1 points
+	if (versionMinor >= 4 && headerSize >= 375)
+	{
+		pointCount = ReadValue<UINT64>(header, 247);
+	}
+
+	for (UINT i = 0; i < 3; i++)
+	{
+		scale[i] = ReadValue<double>(header, 131 + 8 * i);
+		offset[i] = ReadValue<double>(header, 155 + 8 * i);
+
+		// The bounds are stored as max x, min x, max y, min y, max z, min z, the offset is used if they are not set
+		double maxBound = ReadValue<double>(header, 179 + 16 * i);
+		double minBound = ReadValue<double>(header, 187 + 16 * i);
+		origin[i] = (minBound <= maxBound && std::isfinite(minBound) && std::isfinite(maxBound)) ? 0.5 * (minBound + maxBound) : offset[i];
+	}
+
+	// Size of the point record without extra bytes and the offset of the colors for each point format
+	const UINT minimumLengths[] = { 20, 28, 26, 34, 57, 63, 30, 36, 38, 59, 67 };
+	const int colorOffsets[] = { -1, -1, 20, 28, -1, 28, -1, 30, 30, -1, 30 };
+
+	if (pointFormat > 10)
+	{
+		throw std::exception("Unsupported .las point format");
+	}
+
+	if (recordLength < minimumLengths[pointFormat])
+	{
+		throw std::exception("The .las point records are smaller than their point format");
+	}
+
+	// The intensity is stored right after the coordinates in every point format
+	hasColors = colorOffsets[pointFormat] >= 0;
+	colorOffset = hasColors ? colorOffsets[pointFormat] : 12;
+
+	file.seekg(pointDataOffset);
+
+	if (!file)
+	{
+		throw std::exception("The .las file is truncated");
+	}
+}
+
+USHORT LasReader::ReadColorValue(const BYTE* record, UINT index) const
+{
+	return ReadValue<USHORT>(record, colorOffset + 2 * index);
+}
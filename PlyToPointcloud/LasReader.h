@@ -0,0 +1,65 @@
+#ifndef LASREADER_H
+#define LASREADER_H
+
+#pragma once
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include "PlyReader.h"
+
+// Reads the point records of an uncompressed .las file (versions 1.0 to 1.4, point formats 0 to 10) in chunks
+// Only the public header block is parsed in the constructor, the point records are read on demand with ReadRecords
+// The positions are the integer coordinates multiplied with the scale and added to the offset of the header, relative to the origin
+// The origin is the center of the bounds in the header, georeferenced coordinates (e.g. UTM) would lose their precision as floats otherwise
+// Point formats with rgb colors use them, the other formats use the intensity as gray value
+// The .las format has no normals, they are estimated during the conversion
+class LasReader
+{
+public:
+	// The specification stores the colors and intensities with 16 bits, colorBits = 8 reads the files of writers that store 8 bit values instead
+	LasReader(const std::string& filename, UINT colorBits = 16);
+
+	UINT GetPointFormat() const;
+	const double* GetOrigin() const;
+	UINT64 GetVertexCount() const;
+	UINT GetVertexSize() const;
+
+	// Reads at most maxCount point records into the internal buffer and returns how many were read, zero at the end of the point data
+	UINT64 ReadRecords(UINT64 maxCount);
+	const BYTE* GetRecord(UINT64 index) const;
+
+	// Converts one of the records that were read, does not modify the reader and can therefore be called from multiple threads
+	void ReadVertex(const BYTE* record, PlyVertex& outVertex) const;
+
+	static bool IsLasFile(const std::string& filename);
+
+private:
+	std::ifstream file;
+	std::vector<BYTE> chunk;
+	UINT pointFormat = 0;
+	UINT recordLength = 0;
+	UINT64 pointCount = 0;
+	UINT64 pointsRead = 0;
+	double scale[3] = { 1, 1, 1 };
+	double offset[3] = { 0, 0, 0 };
+	double origin[3] = { 0, 0, 0 };
+
+	// Byte offset of the red, green and blue values in the record, or of the intensity if there are no colors
+	UINT colorOffset = 0;
+	bool hasColors = false;
+	UINT colorShift = 8;
+
+	void ParseHeader();
+	USHORT ReadColorValue(const BYTE* record, UINT index) const;
+
+	template<typename T> static T ReadValue(const BYTE* data, UINT offset)
+	{
+		T value;
+		memcpy(&value, data + offset, sizeof(T));
+
+		return value;
+	}
+};
+
+#endif
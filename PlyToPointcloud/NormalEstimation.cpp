@@ -0,0 +1,166 @@
+#include "NormalEstimation.h"
+#include <chrono>
+#include <cmath>
+
+UINT64 NormalEstimation::GetRequiredMemory(UINT64 count)
+{
+	return SpatialGrid::GetRequiredMemory(count);
+}
+
+NormalEstimation::Timings NormalEstimation::Estimate(PointcloudVertex* vertices, UINT64 count, const Vector3& boundingCubePosition, float boundingCubeSize, UINT neighborCount, const Vector3* viewpoint)
+{
+	Timings timings;
+	auto start = std::chrono::steady_clock::now();
+
+	// The 3x3x3 cells around a point contain about 9 cells worth of points on a surface and 27 inside a volume
+	SpatialGrid grid(vertices, count, boundingCubePosition, boundingCubeSize, max(1U, neighborCount / 4));
+
+	auto gridEnd = std::chrono::steady_clock::now();
+	timings.grid = std::chrono::duration<double>(gridEnd - start).count();
+
+	// The points are processed in sorted order, therefore the neighbor queries of a block touch the same cells
+	ThreadPool::Get().ParallelFor(count, 4096, [&](UINT64 blockStart, UINT64 blockEnd)
+	{
+		std::vector<std::pair<float, UINT64>> candidates;
+		std::vector<UINT64> neighbors;
+
+		for (UINT64 i = blockStart; i < blockEnd; i++)
+		{
+			const Vector3& position = grid.GetPosition(i);
+			Vector3 direction = (viewpoint != NULL) ? (*viewpoint - position) : (position - boundingCubePosition);
+			Vector3 normal;
+
+			direction.Normalize();
+
+			grid.FindNeighbors(i, neighborCount, false, candidates, neighbors);
+
+			if (!ComputeNormal(grid, neighbors, normal))
+			{
+				normal = (direction.LengthSquared() > 0.5f) ? direction : Vector3(0, 0, 1);
+			}
+			else if (normal.Dot(direction) < 0)
+			{
+				normal = -normal;
+			}
+
+			PointcloudVertex& vertex = vertices[grid.GetVertexIndex(i)];
+			vertex.normal[0] = 127 * normal.x;
+			vertex.normal[1] = 127 * normal.y;
+			vertex.normal[2] = 127 * normal.z;
+		}
+	});
+
+	timings.normals = std::chrono::duration<double>(std::chrono::steady_clock::now() - gridEnd).count();
+
+	return timings;
+}
+
+bool NormalEstimation::ComputeNormal(const SpatialGrid& grid, const std::vector<UINT64>& neighbors, Vector3& outNormal)
+{
+	if (neighbors.size() < 3)
+	{
+		return false;
+	}
+
+	// Positions relative to the first neighbor avoid the cancellation of large coordinates
+	const Vector3& origin = grid.GetPosition(neighbors[0]);
+	double mean[3] = { 0, 0, 0 };
+	double covariance[6] = { 0, 0, 0, 0, 0, 0 };
+
+	for (UINT64 neighbor : neighbors)
+	{
+		Vector3 offset = grid.GetPosition(neighbor) - origin;
+		mean[0] += offset.x;
+		mean[1] += offset.y;
+		mean[2] += offset.z;
+		covariance[0] += (double)offset.x * offset.x;
+		covariance[1] += (double)offset.x * offset.y;
+		covariance[2] += (double)offset.x * offset.z;
+		covariance[3] += (double)offset.y * offset.y;
+		covariance[4] += (double)offset.y * offset.z;
+		covariance[5] += (double)offset.z * offset.z;
+	}
+
+	double n = (double)neighbors.size();
+
+	for (int i = 0; i < 3; i++)
+	{
+		mean[i] /= n;
+	}
+
+	covariance[0] = covariance[0] / n - mean[0] * mean[0];
+	covariance[1] = covariance[1] / n - mean[0] * mean[1];
+	covariance[2] = covariance[2] / n - mean[0] * mean[2];
+	covariance[3] = covariance[3] / n - mean[1] * mean[1];
+	covariance[4] = covariance[4] / n - mean[1] * mean[2];
+	covariance[5] = covariance[5] / n - mean[2] * mean[2];
+
+	return SmallestEigenvector(covariance, outNormal);
+}
+
+bool NormalEstimation::SmallestEigenvector(const double* covariance, Vector3& outEigenvector)
+{
+	// Scale the matrix so that the thresholds do not depend on the size of the point cloud
+	double scale = 0;
+
+	for (int i = 0; i < 6; i++)
+	{
+		scale = max(scale, std::abs(covariance[i]));
+	}
+
+	if (scale <= 0)
+	{
+		return false;
+	}
+
+	double a = covariance[0] / scale, b = covariance[1] / scale, c = covariance[2] / scale;
+	double d = covariance[3] / scale, e = covariance[4] / scale, f = covariance[5] / scale;
+
+	// Closed form eigenvalues of a symmetric 3x3 matrix
+	double q = (a + d + f) / 3;
+	double p2 = (a - q) * (a - q) + (d - q) * (d - q) + (f - q) * (f - q) + 2 * (b * b + c * c + e * e);
+	double p = std::sqrt(p2 / 6);
+
+	if (p <= 1e-12)
+	{
+		// Multiple of the identity, every direction has the same variance
+		return false;
+	}
+
+	double ba = (a - q) / p, bb = b / p, bc = c / p, bd = (d - q) / p, be = e / p, bf = (f - q) / p;
+	double r = (ba * (bd * bf - be * be) - bb * (bb * bf - be * bc) + bc * (bb * be - bd * bc)) / 2;
+	double phi = std::acos(min(1.0, max(-1.0, r))) / 3;
+	double smallest = q + 2 * p * std::cos(phi + 2.0943951023931957);
+
+	// The eigenvector is orthogonal to the rows of the matrix minus the eigenvalue, the largest cross product is the most accurate
+	double rows[3][3] = { { a - smallest, b, c }, { b, d - smallest, e }, { c, e, f - smallest } };
+	double best[3] = { 0, 0, 0 };
+	double bestLength = 0;
+
+	for (int i = 0; i < 3; i++)
+	{
+		const double* u = rows[i];
+		const double* v = rows[(i + 1) % 3];
+		double cross[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+		double length = cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2];
+
+		if (length > bestLength)
+		{
+			bestLength = length;
+			best[0] = cross[0];
+			best[1] = cross[1];
+			best[2] = cross[2];
+		}
+	}
+
+	// The two smallest eigenvalues are equal if the neighbors lie on a line, then there is no unique normal
+	if (bestLength <= 1e-12)
+	{
+		return false;
+	}
+
+	double length = std::sqrt(bestLength);
+	outEigenvector = Vector3((float)(best[0] / length), (float)(best[1] / length), (float)(best[2] / length));
+
+	return true;
+}
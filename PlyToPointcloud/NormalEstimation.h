@@ -0,0 +1,36 @@
+#ifndef NORMALESTIMATION_H
+#define NORMALESTIMATION_H
+
+#pragma once
+#include <vector>
+#include "SpatialGrid.h"
+
+using namespace PointCloudEngine;
+
+// Estimates the normals of point clouds without normals from the k nearest neighbors of each point
+// The normal is the direction of the smallest variance of the neighbor positions (principal component analysis)
+// Normals are oriented towards a viewpoint (e.g. the scanner origin) or away from the center of the bounding cube
+class NormalEstimation
+{
+public:
+	// Seconds spent in each stage
+	struct Timings
+	{
+		double grid = 0;
+		double normals = 0;
+	};
+
+	static UINT64 GetRequiredMemory(UINT64 count);
+
+	// Overwrites the normals of all the vertices, points without enough neighbors get the orientation direction as normal
+	static Timings Estimate(PointcloudVertex* vertices, UINT64 count, const Vector3& boundingCubePosition, float boundingCubeSize, UINT neighborCount, const Vector3* viewpoint);
+
+private:
+	// Returns false if the neighbors do not span a plane
+	static bool ComputeNormal(const SpatialGrid& grid, const std::vector<UINT64>& neighbors, Vector3& outNormal);
+
+	// Eigenvector of the smallest eigenvalue of the symmetric matrix (xx, xy, xz, yy, yz, zz)
+	static bool SmallestEigenvector(const double* covariance, Vector3& outEigenvector);
+};
+
+#endif
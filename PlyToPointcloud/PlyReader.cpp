@@ -0,0 +1,384 @@
+#include "PlyReader.h"
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+
+PlyReader::PlyReader(const std::string& filename)
+{
+	file.open(filename, std::ios::in | std::ios::binary);
+
+	if (!file.is_open())
+	{
+		throw std::exception("Could not open the .ply file");
+	}
+
+	ParseHeader();
+
+	// Streamable files are read from the mapping, the stream is only a fallback if the file cannot be mapped
+	if (IsStreamable() && mappedFile.Open(filename))
+	{
+		file.close();
+	}
+}
+
+bool PlyReader::IsStreamable() const
+{
+	if (!binary || vertexElement < 0 || elements[vertexElement].hasList)
+	{
+		return false;
+	}
+
+	// The position of the vertex records can only be computed if all the elements before have a fixed size
+	for (int i = 0; i < vertexElement; i++)
+	{
+		if (elements[i].hasList)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+PlyReader::VertexLayout PlyReader::GetVertexLayout() const
+{
+	return layout;
+}
+
+bool PlyReader::IsAscii() const
+{
+	return !binary;
+}
+
+bool PlyReader::HasNormals() const
+{
+	return nx != NULL && ny != NULL && nz != NULL;
+}
+
+UINT64 PlyReader::GetVertexCount() const
+{
+	return (vertexElement < 0) ? 0 : elements[vertexElement].count;
+}
+
+UINT PlyReader::GetVertexSize() const
+{
+	return (vertexElement < 0) ? 0 : elements[vertexElement].size;
+}
+
+const std::vector<PlyReader::Element>& PlyReader::GetElements() const
+{
+	return elements;
+}
+
+int PlyReader::GetVertexElementIndex() const
+{
+	return vertexElement;
+}
+
+UINT64 PlyReader::GetHeaderSize() const
+{
+	return headerSize;
+}
+
+UINT64 PlyReader::ReadRecords(UINT64 maxCount)
+{
+	if (!IsStreamable())
+	{
+		throw std::exception("The .ply file cannot be streamed");
+	}
+
+	// The normals are optional, they are estimated during the conversion if they are missing
+	if (x == NULL || y == NULL || z == NULL || red == NULL || green == NULL || blue == NULL)
+	{
+		throw std::exception("The .ply file does not have the x,y,z,red,green,blue vertex properties");
+	}
+
+	UINT64 count = min(maxCount, GetVertexCount() - verticesRead);
+
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	UINT size = GetVertexSize();
+
+	if (mappedFile.IsOpen())
+	{
+		if (mappedFile.GetSize() < dataOffset + (verticesRead + count) * size)
+		{
+			throw std::exception("The .ply file is truncated");
+		}
+
+		records = mappedFile.GetData() + dataOffset + verticesRead * size;
+	}
+	else
+	{
+		chunk.resize(count * size);
+		file.read((char*)chunk.data(), count * size);
+
+		if ((UINT64)file.gcount() != count * size)
+		{
+			throw std::exception("The .ply file is truncated");
+		}
+
+		records = chunk.data();
+	}
+
+	verticesRead += count;
+
+	return count;
+}
+
+const BYTE* PlyReader::GetRecord(UINT64 index) const
+{
+	return records + index * GetVertexSize();
+}
+
+void PlyReader::ReadVertex(const BYTE* record, PlyVertex& outVertex) const
+{
+	outVertex.position = Vector3(ReadFloat(record, x), ReadFloat(record, y), ReadFloat(record, z));
+	outVertex.normal = HasNormals() ? Vector3(ReadFloat(record, nx), ReadFloat(record, ny), ReadFloat(record, nz)) : Vector3::Zero;
+	outVertex.color[0] = ReadColor(record, red);
+	outVertex.color[1] = ReadColor(record, green);
+	outVertex.color[2] = ReadColor(record, blue);
+}
+
+void PlyReader::ParseHeader()
+{
+	std::string line;
+	std::getline(file, line);
+
+	if (line.compare(0, 3, "ply") != 0)
+	{
+		throw std::exception("Not a .ply file");
+	}
+
+	while (std::getline(file, line))
+	{
+		// Files written on Windows can have carriage returns at the end of each line
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+
+		std::istringstream lineStream(line);
+		std::string keyword;
+		lineStream >> keyword;
+
+		if (keyword.compare("format") == 0)
+		{
+			std::string format;
+			lineStream >> format;
+
+			binary = format.compare("ascii") != 0;
+			bigEndian = format.compare("binary_big_endian") == 0;
+		}
+		else if (keyword.compare("element") == 0)
+		{
+			Element element;
+			lineStream >> element.name >> element.count;
+			elements.push_back(element);
+		}
+		else if (keyword.compare("property") == 0)
+		{
+			if (elements.empty())
+			{
+				throw std::exception("The .ply header has a property without an element");
+			}
+
+			Element& element = elements.back();
+			Property property;
+			std::string typeName;
+			lineStream >> typeName;
+
+			if (typeName.compare("list") == 0)
+			{
+				// Lists have a size per entry, only the element layout is marked as variable
+				std::string countTypeName;
+				lineStream >> countTypeName >> typeName;
+				property.isList = true;
+				element.hasList = true;
+			}
+
+			if (!ParsePropertyType(typeName, property.type))
+			{
+				throw std::exception("The .ply header has an unknown property type");
+			}
+
+			lineStream >> property.name;
+			property.offset = element.size;
+			element.size += property.isList ? 0 : GetPropertyTypeSize(property.type);
+			element.properties.push_back(property);
+		}
+		else if (keyword.compare("end_header") == 0)
+		{
+			break;
+		}
+	}
+
+	if (!file)
+	{
+		throw std::exception("The .ply header is incomplete");
+	}
+
+	headerSize = file.tellg();
+
+	for (UINT64 i = 0; i < elements.size(); i++)
+	{
+		if (elements[i].name.compare("vertex") == 0)
+		{
+			vertexElement = (int)i;
+			break;
+		}
+	}
+
+	if (!IsStreamable())
+	{
+		return;
+	}
+
+	// Skip the fixed size elements that are stored before the vertices
+	UINT64 skip = 0;
+
+	for (int i = 0; i < vertexElement; i++)
+	{
+		skip += elements[i].count * elements[i].size;
+	}
+
+	dataOffset = headerSize + skip;
+	file.seekg(skip, std::ios::cur);
+
+	x = FindVertexProperty("x");
+	y = FindVertexProperty("y");
+	z = FindVertexProperty("z");
+	nx = FindVertexProperty("nx");
+	ny = FindVertexProperty("ny");
+	nz = FindVertexProperty("nz");
+	red = FindVertexProperty("red");
+	green = FindVertexProperty("green");
+	blue = FindVertexProperty("blue");
+	layout = FindVertexLayout();
+}
+
+const PlyReader::Property* PlyReader::FindVertexProperty(const std::string& name) const
+{
+	const std::vector<Property>& properties = elements[vertexElement].properties;
+
+	for (auto it = properties.begin(); it != properties.end(); it++)
+	{
+		if (it->name.compare(name) == 0)
+		{
+			return &(*it);
+		}
+	}
+
+	return NULL;
+}
+
+PlyReader::VertexLayout PlyReader::FindVertexLayout() const
+{
+	auto matches = [](const Property* property, PropertyType type, UINT offset)
+	{
+		return property != NULL && property->type == type && property->offset == offset;
+	};
+
+	if (bigEndian || !matches(x, PropertyType::Float, 0) || !matches(y, PropertyType::Float, 4) || !matches(z, PropertyType::Float, 8))
+	{
+		return VertexLayout::Generic;
+	}
+	else if (matches(nx, PropertyType::Float, 12) && matches(ny, PropertyType::Float, 16) && matches(nz, PropertyType::Float, 20) && matches(red, PropertyType::UChar, 24) && matches(green, PropertyType::UChar, 25) && matches(blue, PropertyType::UChar, 26))
+	{
+		return VertexLayout::PositionNormalColor;
+	}
+	else if (!HasNormals() && matches(red, PropertyType::UChar, 12) && matches(green, PropertyType::UChar, 13) && matches(blue, PropertyType::UChar, 14))
+	{
+		return VertexLayout::PositionColor;
+	}
+
+	return VertexLayout::Generic;
+}
+
+float PlyReader::ReadFloat(const BYTE* record, const Property* property) const
+{
+	BYTE bytes[8];
+	UINT size = GetPropertyTypeSize(property->type);
+	memcpy(bytes, record + property->offset, size);
+
+	if (bigEndian)
+	{
+		std::reverse(bytes, bytes + size);
+	}
+
+	switch (property->type)
+	{
+		case PropertyType::Char: return *(char*)bytes;
+		case PropertyType::UChar: return *(unsigned char*)bytes;
+		case PropertyType::Short: return *(short*)bytes;
+		case PropertyType::UShort: return *(unsigned short*)bytes;
+		case PropertyType::Int: return *(int*)bytes;
+		case PropertyType::UInt: return *(UINT*)bytes;
+		case PropertyType::Float: return *(float*)bytes;
+		case PropertyType::Double: return *(double*)bytes;
+	}
+
+	return 0;
+}
+
+unsigned char PlyReader::ReadColor(const BYTE* record, const Property* property) const
+{
+	if (property->type == PropertyType::UChar)
+	{
+		return record[property->offset];
+	}
+
+	// 16 and 32 bit colors are scaled down instead of clamped, otherwise almost every color would become white
+	float color = ReadFloat(record, property) * GetColorScale(property->type);
+
+	return (unsigned char)max(0.0f, min(color, 255.0f));
+}
+
+float PlyReader::GetColorScale(PropertyType type)
+{
+	switch (type)
+	{
+		case PropertyType::Short: return 1.0f / 128.0f;
+		case PropertyType::UShort: return 1.0f / 256.0f;
+		case PropertyType::Int: return 1.0f / 8388608.0f;
+		case PropertyType::UInt: return 1.0f / 16777216.0f;
+		case PropertyType::Float: return 255.0f;
+		case PropertyType::Double: return 255.0f;
+		default: return 1.0f;
+	}
+}
+
+bool PlyReader::ParsePropertyType(const std::string& name, PropertyType& outType)
+{
+	if (name.compare("char") == 0 || name.compare("int8") == 0) outType = PropertyType::Char;
+	else if (name.compare("uchar") == 0 || name.compare("uint8") == 0) outType = PropertyType::UChar;
+	else if (name.compare("short") == 0 || name.compare("int16") == 0) outType = PropertyType::Short;
+	else if (name.compare("ushort") == 0 || name.compare("uint16") == 0) outType = PropertyType::UShort;
+	else if (name.compare("int") == 0 || name.compare("int32") == 0) outType = PropertyType::Int;
+	else if (name.compare("uint") == 0 || name.compare("uint32") == 0) outType = PropertyType::UInt;
+	else if (name.compare("float") == 0 || name.compare("float32") == 0) outType = PropertyType::Float;
+	else if (name.compare("double") == 0 || name.compare("float64") == 0) outType = PropertyType::Double;
+	else return false;
+
+	return true;
+}
+
+UINT PlyReader::GetPropertyTypeSize(PropertyType type)
+{
+	switch (type)
+	{
+		case PropertyType::Char: return 1;
+		case PropertyType::UChar: return 1;
+		case PropertyType::Short: return 2;
+		case PropertyType::UShort: return 2;
+		case PropertyType::Int: return 4;
+		case PropertyType::UInt: return 4;
+		case PropertyType::Float: return 4;
+		case PropertyType::Double: return 8;
+	}
+
+	return 0;
+}
@@ -0,0 +1,134 @@
+#ifndef PLYREADER_H
+#define PLYREADER_H
+
+#pragma once
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <d3d11.h>
+#include <SimpleMath.h>
+#include "../PointCloudEngine/MappedFile.h"
+
+using namespace DirectX::SimpleMath;
+using namespace PointCloudEngine;
+
+struct PlyVertex
+{
+	// Stores the .ply file vertices
+	Vector3 position;
+	Vector3 normal;
+	unsigned char color[3];
+};
+
+// Reads the vertex element of a binary .ply file in chunks instead of loading the whole file into memory
+// Only the header is parsed in the constructor, the vertex records are read on demand with ReadVertices
+// The file is mapped into memory if possible, then the records are used in place without copying them
+// Files in ascii format or with variable sized elements before or inside the vertex element are not streamable
+class PlyReader
+{
+public:
+	enum class PropertyType { Char, UChar, Short, UShort, Int, UInt, Float, Double };
+
+	// Common vertex layouts of little endian files that are read with fixed offsets instead of converting each property by its type
+	// PositionNormalColor is float x,y,z,nx,ny,nz followed by uchar red,green,blue, PositionColor is the same without the normals
+	// The records can have more properties after these (e.g. alpha), only the stride differs then
+	enum class VertexLayout { Generic, PositionNormalColor, PositionColor };
+
+	struct Property
+	{
+		std::string name;
+		PropertyType type;
+		UINT offset = 0;
+		bool isList = false;
+	};
+
+	struct Element
+	{
+		std::string name;
+		UINT64 count = 0;
+		UINT size = 0;
+		std::vector<Property> properties;
+		bool hasList = false;
+	};
+
+	PlyReader(const std::string& filename);
+
+	bool IsStreamable() const;
+	bool IsAscii() const;
+	bool HasNormals() const;
+	VertexLayout GetVertexLayout() const;
+	UINT64 GetVertexCount() const;
+	UINT GetVertexSize() const;
+
+	// The layout of the elements for readers of the ascii format, the vertex element index is -1 if there is none
+	const std::vector<Element>& GetElements() const;
+	int GetVertexElementIndex() const;
+	UINT64 GetHeaderSize() const;
+
+	// Reads at most maxCount vertex records into the internal buffer and returns how many were read, zero at the end of the vertex element
+	UINT64 ReadRecords(UINT64 maxCount);
+	const BYTE* GetRecord(UINT64 index) const;
+
+	// Converts one of the records that were read, does not modify the reader and can therefore be called from multiple threads
+	// The normal is zero if the file does not have normals
+	void ReadVertex(const BYTE* record, PlyVertex& outVertex) const;
+
+	// Factor that maps the color values of a property type to [0, 255], floating point colors are in [0, 1] and wider integers use their whole range
+	static float GetColorScale(PropertyType type);
+
+	// Same as ReadVertex for records of a known layout, the offsets are compile time constants and the copies compile to a few moves
+	template<VertexLayout layout> static void ReadVertex(const BYTE* record, PlyVertex& outVertex)
+	{
+		static_assert(layout != VertexLayout::Generic, "The generic layout has no fixed offsets");
+
+		memcpy(&outVertex.position, record, 3 * sizeof(float));
+
+		if (layout == VertexLayout::PositionNormalColor)
+		{
+			memcpy(&outVertex.normal, record + 3 * sizeof(float), 3 * sizeof(float));
+			memcpy(outVertex.color, record + 6 * sizeof(float), 3);
+		}
+		else
+		{
+			outVertex.normal = Vector3::Zero;
+			memcpy(outVertex.color, record + 3 * sizeof(float), 3);
+		}
+	}
+
+private:
+	std::ifstream file;
+	MappedFile mappedFile;
+	std::vector<Element> elements;
+	std::vector<BYTE> chunk;
+	const BYTE* records = NULL;
+	VertexLayout layout = VertexLayout::Generic;
+	bool binary = false;
+	bool bigEndian = false;
+	int vertexElement = -1;
+	UINT64 headerSize = 0;
+	UINT64 dataOffset = 0;
+	UINT64 verticesRead = 0;
+
+	// Properties of the vertex element that are converted, NULL if they do not exist
+	const Property* x = NULL;
+	const Property* y = NULL;
+	const Property* z = NULL;
+	const Property* nx = NULL;
+	const Property* ny = NULL;
+	const Property* nz = NULL;
+	const Property* red = NULL;
+	const Property* green = NULL;
+	const Property* blue = NULL;
+
+	void ParseHeader();
+	const Property* FindVertexProperty(const std::string& name) const;
+	VertexLayout FindVertexLayout() const;
+	float ReadFloat(const BYTE* record, const Property* property) const;
+	unsigned char ReadColor(const BYTE* record, const Property* property) const;
+
+	static bool ParsePropertyType(const std::string& name, PropertyType& outType);
+	static UINT GetPropertyTypeSize(PropertyType type);
+};
+
+#endif
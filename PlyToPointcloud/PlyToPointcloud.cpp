@@ -4,196 +4,849 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <random>
+#include <chrono>
+#include <filesystem>
 #include <d3d11.h>
 #include <SimpleMath.h>
 #include "tinyply.h"
+#include "PlyReader.h"
+#include "LasReader.h"
+#include "TextReader.h"
+#include "PlyWriter.h"
+#include "PointcloudShuffler.h"
+#include "PointcloudStratifier.h"
+#include "PointcloudQuantizer.h"
+#include "BatchConverter.h"
+#include "NormalEstimation.h"
+#include "SplatRadiusEstimation.h"
+#include "VoxelFilter.h"
+#include "../PointCloudEngine/PointcloudFile.h"
 
 using namespace DirectX::SimpleMath;
+using namespace PointCloudEngine;
 
-struct PlyVertex
+// Size of the chunks that are read from the .ply file, the memory usage of the conversion does not depend on the file size
+const UINT64 chunkBytes = 16 * 1024 * 1024;
+
+// Command line options, the seed is chosen randomly unless it is specified
+bool hasSeed = false;
+UINT64 seed = 0;
+UINT64 memoryBudget = PointcloudShuffler::GetDefaultMemoryBudget();
+PointcloudOrder order = PointcloudOrder::Random;
+bool writeChecksums = true;
+PointcloudEncoding encoding = PointcloudEncoding::Float;
+bool compress = false;
+
+// Normals are estimated from the nearest neighbors if the .ply file has none or if this is requested
+bool estimateNormals = false;
+UINT neighborCount = 16;
+bool hasViewpoint = false;
+Vector3 viewpoint;
+
+// Vertices inside the same voxel of this size are merged into one vertex, zero keeps all the vertices
+float voxelSize = 0;
+
+// Splat radii from the distance to the k-th nearest neighbor are only stored if this is not zero
+UINT radiusNeighborCount = 0;
+
+// Bits of the .las colors, the specification uses 16 bits but some writers store 8 bit values
+UINT lasColorBits = 16;
+
+// The .ply files are parsed with tinyply and the readers of the conversion instead of being converted
+bool benchmark = false;
+
+// Batch conversion of directories and glob patterns, the number of concurrent conversions is the number of threads by default
+bool batch = false;
+UINT jobCount = ThreadPool::Get().GetThreadCount();
+std::string summaryFilename = "PlyToPointcloudSummary.json";
+
+// Chunk selection and format when converting .pointcloud files into .ply files
+PointcloudSelection selection;
+bool exportAscii = false;
+
+// Number of vertices that are converted, compacted and bounded together in the parallel conversion
+const UINT64 conversionBlockSize = 64 * 1024;
+
+// Buffers of the conversion that are reused for every chunk of the .ply file
+struct ConversionBuffers
 {
-	// Stores the .ply file vertices
-	Vector3 position;
-	Vector3 normal;
-	unsigned char color[3];
+	std::vector<PointcloudVertex> blockVertices;
+	std::vector<PointcloudVertex> pointcloudVertices;
+	std::vector<UINT64> blockOffsets;
+	std::vector<Vector3> blockMinPositions;
+	std::vector<Vector3> blockMaxPositions;
 };
 
-struct PointcloudVertex
+// Returns false for vertices with a zero normal, these are not written unless the normals are estimated later
+bool ConvertVertex(PlyVertex& plyVertex, bool keepNormals, PointcloudVertex& outVertex)
 {
-	// Stores the .pointcloud vertices
-	Vector3 position;
-	char normal[3];
-	unsigned char color[3];
-};
+	// Make sure that the normals are normalized
+	plyVertex.normal.Normalize();
 
-void PlyToPointcloud(const std::string& plyfile)
+	if (!keepNormals)
+	{
+		plyVertex.normal = Vector3::Zero;
+	}
+	else if (plyVertex.normal.LengthSquared() <= 0.5f)
+	{
+		return false;
+	}
+
+	// The padding bytes are zero so that the same input always produces the same file
+	memset(&outVertex, 0, sizeof(PointcloudVertex));
+
+	// Smaller size due to normal quantization
+	outVertex.position = plyVertex.position;
+	outVertex.normal[0] = 127 * plyVertex.normal.x;
+	outVertex.normal[1] = 127 * plyVertex.normal.y;
+	outVertex.normal[2] = 127 * plyVertex.normal.z;
+	outVertex.color[0] = plyVertex.color[0];
+	outVertex.color[1] = plyVertex.color[1];
+	outVertex.color[2] = plyVertex.color[2];
+
+	return true;
+}
+
+// Gathers, normalizes, filters and converts the vertices in one parallel pass, gather(i, plyVertex) reads the i-th .ply vertex
+// Each block compacts its vertices to the front of its range and computes its bounding box
+// A prefix sum over the block counts then gives the output position of each block and the blocks are copied in parallel
+template<typename Gather> void WritePointcloudVertices(std::ofstream& pointcloudFile, UINT64 count, const Gather& gather, bool keepNormals, ConversionBuffers& buffers, Vector3& minPosition, Vector3& maxPosition, UINT64& vertexCount)
 {
-	std::cout << "Converting \"" << plyfile << "\" to .pointcloud file format...";
+	UINT64 blockCount = (count + conversionBlockSize - 1) / conversionBlockSize;
+	buffers.blockVertices.resize(count);
+	buffers.blockOffsets.assign(blockCount + 1, 0);
+	buffers.blockMinPositions.assign(blockCount, Vector3(FLT_MAX, FLT_MAX, FLT_MAX));
+	buffers.blockMaxPositions.assign(blockCount, Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
 
-	try
+	ThreadPool::Get().ParallelFor(blockCount, 1, [&](UINT64 startBlock, UINT64 endBlock)
+	{
+		for (UINT64 block = startBlock; block < endBlock; block++)
+		{
+			UINT64 start = block * conversionBlockSize;
+			UINT64 end = min(start + conversionBlockSize, count);
+			PointcloudVertex* blockVertices = buffers.blockVertices.data() + start;
+			Vector3 blockMin = buffers.blockMinPositions[block];
+			Vector3 blockMax = buffers.blockMaxPositions[block];
+			UINT64 kept = 0;
+
+			for (UINT64 i = start; i < end; i++)
+			{
+				PlyVertex plyVertex;
+				gather(i, plyVertex);
+
+				if (ConvertVertex(plyVertex, keepNormals, blockVertices[kept]))
+				{
+					blockMin = Vector3::Min(blockMin, blockVertices[kept].position);
+					blockMax = Vector3::Max(blockMax, blockVertices[kept].position);
+					kept++;
+				}
+			}
+
+			buffers.blockOffsets[block + 1] = kept;
+			buffers.blockMinPositions[block] = blockMin;
+			buffers.blockMaxPositions[block] = blockMax;
+		}
+	});
+
+	for (UINT64 block = 0; block < blockCount; block++)
 	{
-		// Load ply file
-		std::ifstream ss(plyfile, std::ios::binary);
+		buffers.blockOffsets[block + 1] += buffers.blockOffsets[block];
+		minPosition = Vector3::Min(minPosition, buffers.blockMinPositions[block]);
+		maxPosition = Vector3::Max(maxPosition, buffers.blockMaxPositions[block]);
+	}
 
-		tinyply::PlyFile file;
-		file.parse_header(ss);
+	UINT64 keptCount = buffers.blockOffsets[blockCount];
+	buffers.pointcloudVertices.resize(keptCount);
 
-		// Tinyply untyped byte buffers for properties
-		std::shared_ptr<tinyply::PlyData> rawPositions, rawNormals, rawColors;
+	ThreadPool::Get().ParallelFor(blockCount, 1, [&](UINT64 startBlock, UINT64 endBlock)
+	{
+		for (UINT64 block = startBlock; block < endBlock; block++)
+		{
+			UINT64 offset = buffers.blockOffsets[block];
+			memcpy(buffers.pointcloudVertices.data() + offset, buffers.blockVertices.data() + block * conversionBlockSize, (buffers.blockOffsets[block + 1] - offset) * sizeof(PointcloudVertex));
+		}
+	});
 
-		// Hardcoded properties and elements
-		rawPositions = file.request_properties_from_element("vertex", { "x", "y", "z" });
-		rawNormals = file.request_properties_from_element("vertex", { "nx", "ny", "nz" });
-		rawColors = file.request_properties_from_element("vertex", { "red", "green", "blue" });
+	pointcloudFile.write((char*)buffers.pointcloudVertices.data(), keptCount * sizeof(PointcloudVertex));
+	vertexCount += keptCount;
+}
+
+// Returns false if the file has no normals, then the normals are zero and have to be estimated
+bool ConvertPlyVerticesInMemory(const std::string& plyfile, std::ofstream& pointcloudFile, ConversionBuffers& buffers, Vector3& minPosition, Vector3& maxPosition, UINT64& vertexCount)
+{
+	// Fallback for files with lists before or inside the vertices, tinyply buffers all the properties of the whole file
+	std::ifstream ss(plyfile, std::ios::binary);
 
-		// Read the file
-		file.read(ss);
+	tinyply::PlyFile file;
+	file.parse_header(ss);
 
-		// Create vertices
-		size_t count = rawPositions->count;
-		size_t stridePositions = rawPositions->buffer.size_bytes() / count;
-		size_t strideNormals = rawNormals->buffer.size_bytes() / count;
-		size_t strideColors = rawColors->buffer.size_bytes() / count;
+	// Tinyply untyped byte buffers for properties
+	std::shared_ptr<tinyply::PlyData> rawPositions, rawNormals, rawColors;
 
-		// When this trows an std::bad_alloc exception, the memory requirement is large -> build with x64
-		std::vector<PlyVertex> plyVertices(count);
+	// Hardcoded properties and elements
+	rawPositions = file.request_properties_from_element("vertex", { "x", "y", "z" });
+	rawColors = file.request_properties_from_element("vertex", { "red", "green", "blue" });
 
-		// Fill each vertex with its data
-		for (int i = 0; i < count; i++)
+	// The normals are optional, tinyply throws for missing properties
+	UINT normalProperties = 0;
+
+	for (const tinyply::PlyElement& element : file.get_elements())
+	{
+		for (const tinyply::PlyProperty& property : element.properties)
 		{
-			std::memcpy(&plyVertices[i].position, rawPositions->buffer.get() + i * stridePositions, stridePositions);
-			std::memcpy(&plyVertices[i].normal, rawNormals->buffer.get() + i * strideNormals, strideNormals);
-			std::memcpy(&plyVertices[i].color, rawColors->buffer.get() + i * strideColors, strideColors);
+			if (element.name.compare("vertex") == 0 && (property.name.compare("nx") == 0 || property.name.compare("ny") == 0 || property.name.compare("nz") == 0))
+			{
+				normalProperties++;
+			}
+		}
+	}
+
+	if (normalProperties == 3)
+	{
+		rawNormals = file.request_properties_from_element("vertex", { "nx", "ny", "nz" });
+	}
+
+	// Read the file
+	file.read(ss);
+
+	// The vertices are gathered directly from the property buffers
+	size_t count = rawPositions->count;
+	size_t stridePositions = rawPositions->buffer.size_bytes() / count;
+	size_t strideNormals = (rawNormals != NULL) ? rawNormals->buffer.size_bytes() / count : 0;
+	size_t strideColors = rawColors->buffer.size_bytes() / count;
+
+	if (stridePositions != 3 * sizeof(float) || strideColors != 3)
+	{
+		throw std::exception("Files with lists before or inside the vertices need float positions and uchar colors");
+	}
+
+	WritePointcloudVertices(pointcloudFile, count, [&](UINT64 i, PlyVertex& outPlyVertex)
+	{
+		outPlyVertex.normal = Vector3::Zero;
+		std::memcpy(&outPlyVertex.position, rawPositions->buffer.get() + i * stridePositions, stridePositions);
+		std::memcpy(&outPlyVertex.color, rawColors->buffer.get() + i * strideColors, strideColors);
 
-			// Make sure that the normals are normalized
-			plyVertices[i].normal.Normalize();
+		if (rawNormals != NULL)
+		{
+			std::memcpy(&outPlyVertex.normal, rawNormals->buffer.get() + i * strideNormals, strideNormals);
 		}
+	}, (rawNormals != NULL) && !estimateNormals, buffers, minPosition, maxPosition, vertexCount);
 
-		// Convert into .pointcloud vertices (smaller size due to normal quantization)
-		std::vector<PointcloudVertex> pointcloudVertices;
-		Vector3 minPosition = plyVertices.front().position;
-		Vector3 maxPosition = minPosition;
+	return rawNormals != NULL;
+}
 
-		// Also calculate center and size of the bounding cube that fully encloses the point cloud
-		for (UINT i = 0; i < count; i++)
+std::vector<PointcloudChunk> CreateChunkDirectory(const PointcloudVertex* pointcloudVertices, UINT64 vertexCount, UINT64 dataOffset, UINT recordSize)
+{
+	// Consecutive ranges of the final vertex order with their bounding box, computed in parallel before the positions are quantized
+	std::vector<PointcloudChunk> chunks((vertexCount + pointcloudChunkSize - 1) / pointcloudChunkSize);
+
+	ThreadPool::Get().ParallelFor(chunks.size(), 1, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 i = start; i < end; i++)
 		{
-			// Only add vertices with a non zero normal
-			if (plyVertices[i].normal.LengthSquared() > 0.5f)
+			PointcloudChunk& chunk = chunks[i];
+			const PointcloudVertex* chunkVertices = pointcloudVertices + i * pointcloudChunkSize;
+
+			chunk.vertexCount = min(pointcloudChunkSize, vertexCount - i * pointcloudChunkSize);
+			chunk.offset = dataOffset + i * pointcloudChunkSize * recordSize;
+			chunk.size = chunk.vertexCount * recordSize;
+			chunk.minPosition = chunkVertices[0].position;
+			chunk.maxPosition = chunkVertices[0].position;
+
+			for (UINT64 j = 1; j < chunk.vertexCount; j++)
 			{
-				PointcloudVertex pointcloudVertex;
+				chunk.minPosition = Vector3::Min(chunk.minPosition, chunkVertices[j].position);
+				chunk.maxPosition = Vector3::Max(chunk.maxPosition, chunkVertices[j].position);
+			}
+		}
+	});
 
-				pointcloudVertex.position = plyVertices[i].position;
-				pointcloudVertex.normal[0] = 127 * plyVertices[i].normal.x;
-				pointcloudVertex.normal[1] = 127 * plyVertices[i].normal.y;
-				pointcloudVertex.normal[2] = 127 * plyVertices[i].normal.z;
-				pointcloudVertex.color[0] = plyVertices[i].color[0];
-				pointcloudVertex.color[1] = plyVertices[i].color[1];
-				pointcloudVertex.color[2] = plyVertices[i].color[2];
+	return chunks;
+}
+
+void FinishChunkDirectory(std::vector<PointcloudChunk>& chunks, const BYTE* data, float positionError)
+{
+	// The decoded positions can be outside of the bounding boxes by the quantization error, the checksums cover the final records
+	Vector3 error(positionError, positionError, positionError);
 
-				pointcloudVertices.push_back(pointcloudVertex);
+	ThreadPool::Get().ParallelFor(chunks.size(), 1, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 i = start; i < end; i++)
+		{
+			chunks[i].minPosition -= error;
+			chunks[i].maxPosition += error;
 
-				minPosition = Vector3::Min(minPosition, pointcloudVertex.position);
-				maxPosition = Vector3::Max(maxPosition, pointcloudVertex.position);
+			if (writeChecksums)
+			{
+				chunks[i].checksum = Hash::XXHash64(data + chunks[i].offset, chunks[i].size);
 			}
 		}
+	});
+}
+
+UINT64 FilterPointcloudFile(const std::string& pointcloudfile, PointcloudHeader& header, UINT64 jobMemoryBudget, std::ostream& log)
+{
+	// Merges duplicate and nearby vertices in place and removes the remaining space from the end of the file
+	MappedFile mappedFile;
+
+	if (!mappedFile.Open(pointcloudfile, true))
+	{
+		throw std::exception("Could not map the .pointcloud file for the voxel filter");
+	}
+
+	PointcloudVertex* pointcloudVertices = (PointcloudVertex*)(mappedFile.GetWritableData() + header.dataOffset);
+	UINT64 vertexCount = (mappedFile.GetSize() - header.dataOffset) / sizeof(PointcloudVertex);
+	auto start = std::chrono::steady_clock::now();
+
+	VoxelFilter voxelFilter(voxelSize, jobMemoryBudget);
+	UINT64 filteredCount = voxelFilter.Filter(pointcloudVertices, vertexCount, header.boundingCubePosition, header.boundingCubeSize, pointcloudfile);
+
+	if (!mappedFile.Resize(header.dataOffset + filteredCount * sizeof(PointcloudVertex)))
+	{
+		throw std::exception("Could not resize the .pointcloud file");
+	}
+
+	mappedFile.Close();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	log << "merged " << vertexCount << " vertices into " << filteredCount << " voxels of size " << voxelSize << " (reduction ratio " << vertexCount / (double)max(1ULL, filteredCount);
+	log << ", " << voxelFilter.GetPartitionCount() << " partitions) in " << seconds << " s...";
+
+	return filteredCount;
+}
+
+std::vector<PointcloudChunk> OrderPointcloudFile(const std::string& pointcloudfile, PointcloudHeader& header, bool computeNormals, UINT64 jobMemoryBudget, std::vector<BYTE>& outRadii, std::ostream& log)
+{
+	// The file is reordered in place through a writable mapping instead of reading it into memory
+	MappedFile mappedFile;
+	std::vector<PointcloudChunk> chunks;
+
+	if (!mappedFile.Open(pointcloudfile, true))
+	{
+		throw std::exception("Could not map the .pointcloud file for shuffling");
+	}
+
+	if (mappedFile.GetSize() > header.dataOffset)
+	{
+		PointcloudVertex* pointcloudVertices = (PointcloudVertex*)(mappedFile.GetWritableData() + header.dataOffset);
+		UINT64 vertexCount = (mappedFile.GetSize() - header.dataOffset) / sizeof(PointcloudVertex);
 
-		Vector3 diagonal = maxPosition - minPosition;
-		Vector3 boundingCubePosition = minPosition + 0.5f * diagonal;
-		float boundingCubeSize = max(max(diagonal.x, diagonal.y), diagonal.z);
+		if (computeNormals)
+		{
+			if (NormalEstimation::GetRequiredMemory(vertexCount) > jobMemoryBudget)
+			{
+				throw std::exception("Not enough memory to estimate the normals");
+			}
+
+			NormalEstimation::Timings timings = NormalEstimation::Estimate(pointcloudVertices, vertexCount, header.boundingCubePosition, header.boundingCubeSize, neighborCount, hasViewpoint ? &viewpoint : NULL);
+			log << "estimated normals from " << neighborCount << " neighbors (grid " << timings.grid << " s, neighbors and PCA " << timings.normals << " s)...";
+		}
 
 		// Randomly shuffle the vertices in order to be able to easily select the density by looking at the first k entries (used in GroundTruthRenderer)
-		std::random_shuffle(pointcloudVertices.begin(), pointcloudVertices.end());
+		PointcloudShuffler shuffler(header.seed, jobMemoryBudget);
+		shuffler.Shuffle(pointcloudVertices, vertexCount, pointcloudfile);
 
-		// Write the .pointcloud file
-		std::ofstream pointcloudFile(plyfile.substr(0, plyfile.length() - 3) + "pointcloud", std::ios::out | std::ios::binary);
+		// Optionally make every prefix or every chunk spatially coherent, this requires all the keys in memory
+		if (order != PointcloudOrder::Random && PointcloudStratifier::GetRequiredMemory(vertexCount) > jobMemoryBudget)
+		{
+			log << "not enough memory for the requested order, using random order...";
+		}
+		else if (order == PointcloudOrder::Stratified)
+		{
+			PointcloudStratifier::Stratify(pointcloudVertices, vertexCount, header.boundingCubePosition, header.boundingCubeSize);
+			header.order = order;
+		}
+		else if (order == PointcloudOrder::Spatial || order == PointcloudOrder::Morton)
+		{
+			PointcloudStratifier::SortSpatially(pointcloudVertices, vertexCount, header.boundingCubePosition, header.boundingCubeSize, header.seed, order == PointcloudOrder::Spatial);
+			header.order = order;
+		}
 
-		// Write the bounding cube position
-		pointcloudFile.write((char*)&boundingCubePosition, sizeof(Vector3));
+		// The radii are stored in the final vertex order and computed before the positions are quantized
+		if (radiusNeighborCount > 0 && SplatRadiusEstimation::GetRequiredMemory(vertexCount) > jobMemoryBudget)
+		{
+			log << "not enough memory for the splat radii, skipping them...";
+		}
+		else if (radiusNeighborCount > 0)
+		{
+			SplatRadiusEstimation::Timings timings = SplatRadiusEstimation::Estimate(pointcloudVertices, vertexCount, header.boundingCubePosition, header.boundingCubeSize, radiusNeighborCount, outRadii);
+			log << "estimated splat radii from " << radiusNeighborCount << " neighbors (grid " << timings.grid << " s, neighbors " << timings.radii << " s)...";
+		}
 
-		// Write the bounding cube size
-		pointcloudFile.write((char*)&boundingCubeSize, sizeof(float));
+		chunks = CreateChunkDirectory(pointcloudVertices, vertexCount, header.dataOffset, PointcloudFile::GetRecordSize(encoding));
 
-		// Write the size of the vector
-		UINT vertexCount = pointcloudVertices.size();
-		pointcloudFile.write((char*)&vertexCount, sizeof(UINT));
+		// Quantize the positions and remove the space that is not needed anymore from the end of the file
+		header.encoding = encoding;
+		header.positionError = PointcloudQuantizer::Quantize((BYTE*)pointcloudVertices, vertexCount, encoding, header.boundingCubePosition, header.boundingCubeSize);
 
-		// Write the vertices data in binary format
-		pointcloudFile.write((char*)pointcloudVertices.data(), vertexCount * sizeof(PointcloudVertex));
+		if (!mappedFile.Resize(header.dataOffset + vertexCount * PointcloudFile::GetRecordSize(encoding)))
+		{
+			throw std::exception("Could not resize the .pointcloud file");
+		}
 
-		pointcloudFile.flush();
-		pointcloudFile.close();
+		FinishChunkDirectory(chunks, mappedFile.GetData(), header.positionError);
+	}
+
+	mappedFile.Close();
+
+	return chunks;
+}
+
+void CompressPointcloudFile(const std::string& pointcloudfile, PointcloudHeader& header, std::vector<PointcloudChunk>& chunks, std::ostream& log)
+{
+	// The compressed file is written next to the uncompressed one and replaces it at the end
+	std::string compressedfile = pointcloudfile + ".compressed";
+	MappedFile mappedFile;
+
+	if (!mappedFile.Open(pointcloudfile))
+	{
+		throw std::exception("Could not map the .pointcloud file for compression");
+	}
+
+	std::ofstream compressedFile(compressedfile, std::ios::out | std::ios::binary);
+	compressedFile.write((char*)&header, sizeof(PointcloudHeader));
+
+	PointcloudCompression::RecordLayout layout = PointcloudFile::GetRecordLayout(header.encoding);
+	UINT positionBits = PointcloudFile::GetPositionBits(header.encoding);
+	const BYTE* records = mappedFile.GetData() + header.dataOffset;
+	UINT64 offset = header.dataOffset;
+	UINT64 rawBytes = 0;
+	double encodeSeconds = 0, decodeSeconds = 0;
+	std::atomic<bool> lossless(true);
+
+	// Each batch compresses one chunk per thread, then decompresses the chunks again to verify them and measure the throughput
+	UINT64 batchSize = ThreadPool::Get().GetThreadCount();
+
+	for (UINT64 batchStart = 0; batchStart < chunks.size(); batchStart += batchSize)
+	{
+		UINT64 batchCount = min(batchSize, chunks.size() - batchStart);
+		std::vector<std::vector<BYTE>> blocks(batchCount);
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		ThreadPool::Get().ParallelFor(batchCount, 1, [&](UINT64 begin, UINT64 end)
+		{
+			for (UINT64 i = begin; i < end; i++)
+			{
+				const PointcloudChunk& chunk = chunks[batchStart + i];
+				PointcloudCompression::Compress(mappedFile.GetData() + chunk.offset, chunk.vertexCount, layout, positionBits, blocks[i]);
+			}
+		});
+
+		auto encoded = std::chrono::high_resolution_clock::now();
+
+		ThreadPool::Get().ParallelFor(batchCount, 1, [&](UINT64 begin, UINT64 end)
+		{
+			for (UINT64 i = begin; i < end; i++)
+			{
+				const PointcloudChunk& chunk = chunks[batchStart + i];
+				std::vector<BYTE> decompressed(chunk.size);
+
+				if (!PointcloudCompression::Decompress(blocks[i].data(), blocks[i].size(), chunk.vertexCount, layout, positionBits, decompressed.data()) || memcmp(decompressed.data(), mappedFile.GetData() + chunk.offset, chunk.size) != 0)
+				{
+					lossless = false;
+				}
+			}
+		});
+
+		auto decoded = std::chrono::high_resolution_clock::now();
+		encodeSeconds += std::chrono::duration<double>(encoded - start).count();
+		decodeSeconds += std::chrono::duration<double>(decoded - encoded).count();
+
+		for (UINT64 i = 0; i < batchCount; i++)
+		{
+			PointcloudChunk& chunk = chunks[batchStart + i];
+			rawBytes += chunk.size;
+			chunk.offset = offset;
+			chunk.size = blocks[i].size();
+			chunk.checksum = writeChecksums ? Hash::XXHash64(blocks[i].data(), blocks[i].size()) : 0;
+			offset += chunk.size;
+
+			compressedFile.write((char*)blocks[i].data(), blocks[i].size());
+		}
+	}
+
+	mappedFile.Close();
+
+	if (!lossless)
+	{
+		compressedFile.close();
+		DeleteFileA(compressedfile.c_str());
+		throw std::exception("The compressed chunks do not match the original vertices");
+	}
+
+	header.flags |= pointcloudFlagCompressed;
+	header.chunkCount = chunks.size();
+	header.chunkDirectoryOffset = offset;
+
+	compressedFile.write((char*)chunks.data(), chunks.size() * sizeof(PointcloudChunk));
+	compressedFile.seekp(0);
+	compressedFile.write((char*)&header, sizeof(PointcloudHeader));
+	compressedFile.flush();
+	compressedFile.close();
+
+	if (!MoveFileExA(compressedfile.c_str(), pointcloudfile.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		throw std::exception("Could not replace the .pointcloud file with the compressed file");
+	}
+
+	double megabytes = rawBytes / (1024.0 * 1024.0);
+	log << "compression ratio " << rawBytes / (double)max(1ULL, offset - header.dataOffset) << ", encoding " << megabytes / encodeSeconds << " MB/s, decoding " << megabytes / decodeSeconds << " MB/s...";
+}
+
+void AppendRadii(const std::string& pointcloudfile, PointcloudHeader& header, const std::vector<BYTE>& radii)
+{
+	// The radii follow the chunk directory, therefore the offsets of the vertices and chunks stay the same
+	std::fstream pointcloudFile(pointcloudfile, std::ios::in | std::ios::out | std::ios::binary);
+	pointcloudFile.seekp(0, std::ios::end);
+
+	header.flags |= pointcloudFlagRadii;
+	header.radiiOffset = pointcloudFile.tellp();
+
+	pointcloudFile.write((char*)radii.data(), radii.size());
+	pointcloudFile.seekp(0);
+	pointcloudFile.write((char*)&header, sizeof(PointcloudHeader));
+	pointcloudFile.flush();
+
+	if (!pointcloudFile)
+	{
+		throw std::exception("Could not write the splat radii");
+	}
+}
+
+// Reads, converts and writes one chunk of records at a time, works for every reader with the record interface of the PlyReader
+// readVertex(record, plyVertex) converts one record, by default with the ReadVertex function of the reader
+template<typename Reader, typename ReadVertex> void WriteRecords(Reader& reader, const ReadVertex& readVertex, std::ofstream& pointcloudFile, bool keepNormals, ConversionBuffers& buffers, Vector3& minPosition, Vector3& maxPosition, UINT64& vertexCount)
+{
+	UINT64 chunkSize = max(1ULL, chunkBytes / max(1U, reader.GetVertexSize()));
+	UINT64 readCount;
+
+	while ((readCount = reader.ReadRecords(chunkSize)) > 0)
+	{
+		WritePointcloudVertices(pointcloudFile, readCount, [&](UINT64 i, PlyVertex& outPlyVertex)
+		{
+			readVertex(reader.GetRecord(i), outPlyVertex);
+		}, keepNormals, buffers, minPosition, maxPosition, vertexCount);
+	}
+}
+
+template<typename Reader> void WriteRecords(Reader& reader, std::ofstream& pointcloudFile, bool keepNormals, ConversionBuffers& buffers, Vector3& minPosition, Vector3& maxPosition, UINT64& vertexCount)
+{
+	WriteRecords(reader, [&](const BYTE* record, PlyVertex& outPlyVertex) { reader.ReadVertex(record, outPlyVertex); }, pointcloudFile, keepNormals, buffers, minPosition, maxPosition, vertexCount);
+}
+
+// Binary .ply files with one of the common vertex layouts are converted with a kernel that is specialized for the layout
+void WritePlyRecords(PlyReader& plyReader, std::ofstream& pointcloudFile, bool keepNormals, ConversionBuffers& buffers, Vector3& minPosition, Vector3& maxPosition, UINT64& vertexCount)
+{
+	switch (plyReader.GetVertexLayout())
+	{
+		case PlyReader::VertexLayout::PositionNormalColor:
+			WriteRecords(plyReader, [](const BYTE* record, PlyVertex& outPlyVertex) { PlyReader::ReadVertex<PlyReader::VertexLayout::PositionNormalColor>(record, outPlyVertex); }, pointcloudFile, keepNormals, buffers, minPosition, maxPosition, vertexCount);
+			break;
+		case PlyReader::VertexLayout::PositionColor:
+			WriteRecords(plyReader, [](const BYTE* record, PlyVertex& outPlyVertex) { PlyReader::ReadVertex<PlyReader::VertexLayout::PositionColor>(record, outPlyVertex); }, pointcloudFile, keepNormals, buffers, minPosition, maxPosition, vertexCount);
+			break;
+		default:
+			WriteRecords(plyReader, pointcloudFile, keepNormals, buffers, minPosition, maxPosition, vertexCount);
+			break;
+	}
+}
+
+// Ascii .ply files are parsed in parallel unless the vertex element has lists
+bool IsTextReadable(const PlyReader& plyReader)
+{
+	int vertexElement = plyReader.GetVertexElementIndex();
+
+	return plyReader.IsAscii() && (vertexElement >= 0) && !plyReader.GetElements()[vertexElement].hasList;
+}
+
+// Times the tinyply parser against the readers of the conversion, each parser converts the vertices into a temporary file
+// Ascii files are compared with the parallel text parser, binary files with the generic and the layout specific kernels of the PlyReader
+// The fastest of a few runs is reported and the converted vertices of all the parsers are compared
+void BenchmarkParsing(const std::string& plyfile)
+{
+	enum class Parser { Tinyply, TextReader, PlyReader, PlyReaderLayout };
+
+	const int runs = 3;
+	const char* names[4] = { "tinyply", "text reader", "ply reader", "ply reader with layout kernel" };
+	std::vector<Parser> parsers = { Parser::Tinyply };
+	std::vector<double> seconds;
+	std::vector<UINT64> counts;
+	std::vector<std::string> tempfiles;
+
+	std::cout << "Benchmarking the parsing of \"" << plyfile << "\"..." << std::endl;
+
+	try
+	{
+		PlyReader plyReader(plyfile);
+
+		if (IsTextReadable(plyReader))
+		{
+			parsers.push_back(Parser::TextReader);
+		}
+		else if (plyReader.IsStreamable())
+		{
+			parsers.push_back(Parser::PlyReader);
+
+			if (plyReader.GetVertexLayout() != PlyReader::VertexLayout::Generic)
+			{
+				parsers.push_back(Parser::PlyReaderLayout);
+			}
+		}
+		else
+		{
+			throw std::exception("Only files without lists in the vertex element and before the vertices can be compared");
+		}
+
+		seconds.assign(parsers.size(), DBL_MAX);
+		counts.assign(parsers.size(), 0);
+
+		for (UINT i = 0; i < parsers.size(); i++)
+		{
+			tempfiles.push_back(plyfile + "." + std::to_string(i) + ".tmp");
+		}
+
+		for (int run = 0; run < runs; run++)
+		{
+			for (UINT i = 0; i < parsers.size(); i++)
+			{
+				std::ofstream tempFile(tempfiles[i], std::ios::out | std::ios::binary);
+				Vector3 minPosition(FLT_MAX, FLT_MAX, FLT_MAX);
+				Vector3 maxPosition(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+				ConversionBuffers buffers;
+				UINT64 vertexCount = 0;
+				auto start = std::chrono::steady_clock::now();
+
+				if (parsers[i] == Parser::Tinyply)
+				{
+					ConvertPlyVerticesInMemory(plyfile, tempFile, buffers, minPosition, maxPosition, vertexCount);
+				}
+				else if (parsers[i] == Parser::TextReader)
+				{
+					TextReader textReader(plyfile);
+					WriteRecords(textReader, tempFile, textReader.HasNormals() && !estimateNormals, buffers, minPosition, maxPosition, vertexCount);
+				}
+				else
+				{
+					PlyReader streamReader(plyfile);
+					bool keepNormals = streamReader.HasNormals() && !estimateNormals;
+
+					if (parsers[i] == Parser::PlyReader)
+					{
+						WriteRecords(streamReader, tempFile, keepNormals, buffers, minPosition, maxPosition, vertexCount);
+					}
+					else
+					{
+						WritePlyRecords(streamReader, tempFile, keepNormals, buffers, minPosition, maxPosition, vertexCount);
+					}
+				}
+
+				tempFile.close();
+				seconds[i] = min(seconds[i], std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+				counts[i] = vertexCount;
+			}
+		}
+
+		double megabytes = std::filesystem::file_size(plyfile) / (1024.0 * 1024.0);
+		bool identical = true;
+
+		for (UINT i = 0; i < parsers.size(); i++)
+		{
+			std::cout << "\t" << names[(int)parsers[i]] << ": " << counts[i] << " vertices in " << seconds[i] << " s (" << megabytes / seconds[i] << " MB/s, " << counts[i] / seconds[i] / 1e6 << " million vertices/s, speedup " << seconds[0] / seconds[i] << ")" << std::endl;
+
+			std::ifstream files[2] = { std::ifstream(tempfiles[0], std::ios::in | std::ios::binary), std::ifstream(tempfiles[i], std::ios::in | std::ios::binary) };
+			identical &= std::equal(std::istreambuf_iterator<char>(files[0]), std::istreambuf_iterator<char>(), std::istreambuf_iterator<char>(files[1]), std::istreambuf_iterator<char>());
+		}
+
+		std::cout << "\tthe converted vertices are " << (identical ? "identical" : "DIFFERENT") << std::endl;
 	}
 	catch (const std::exception& e)
 	{
-		std::cout << "ERROR" << std::endl;
+		std::cout << "ERROR: " << e.what() << std::endl;
 	}
 
-	std::cout << "DONE" << std::endl;
+	for (const std::string& tempfile : tempfiles)
+	{
+		std::error_code error;
+		std::filesystem::remove(tempfile, error);
+	}
 }
 
-void PointcloudToPly(std::string pointcloudfile)
+// Converts .ply and .las files, uses at most the given amount of memory for the in memory shuffle and ordering, returns false if the conversion failed
+bool PlyToPointcloud(const std::string& plyfile, UINT64 jobMemoryBudget, std::ostream& log, UINT64& outVertexCount)
 {
-	std::cout << "Converting \"" << pointcloudfile << "\" to .ply file format...";
+	log << "Converting \"" << plyfile << "\" to .pointcloud file format...";
+	outVertexCount = 0;
+	bool success = true;
+
+	// The file is converted under a temporary name and renamed when it is complete, an interrupted conversion never leaves a truncated .pointcloud file
+	// The batch converter gives every job its own .pointcloud file, the process id keeps the name unique across processes
+	std::string finalfile = BatchConverter::GetPointcloudFilename(plyfile);
+	std::string pointcloudfile = finalfile + "." + std::to_string(GetCurrentProcessId()) + ".tmp";
 
 	try
 	{
-		// Try to load the point cloud from the file
-		std::ifstream file(pointcloudfile, std::ios::in | std::ios::binary);
+		std::ofstream pointcloudFile(pointcloudfile, std::ios::out | std::ios::binary);
+
+		// The header is written again once the bounding cube and the number of vertices are known
+		PointcloudHeader header;
+		header.boundingCubePosition = Vector3::Zero;
+		header.seed = hasSeed ? seed : (((UINT64)std::random_device()() << 32) | std::random_device()());
+		pointcloudFile.write((char*)&header, sizeof(PointcloudHeader));
+
+		UINT64 vertexCount = 0;
+
+		Vector3 minPosition(FLT_MAX, FLT_MAX, FLT_MAX);
+		Vector3 maxPosition(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		ConversionBuffers buffers;
+		bool computeNormals = estimateNormals;
+		auto readStart = std::chrono::steady_clock::now();
+
+		if (LasReader::IsLasFile(plyfile))
+		{
+			LasReader lasReader(plyfile, lasColorBits);
+			computeNormals = true;
+
+			const double* origin = lasReader.GetOrigin();
+			log << "point format " << lasReader.GetPointFormat() << " has no normals, estimating them...positions relative to (" << std::to_string(origin[0]) << ", " << std::to_string(origin[1]) << ", " << std::to_string(origin[2]) << ")...";
+			WriteRecords(lasReader, pointcloudFile, false, buffers, minPosition, maxPosition, vertexCount);
+		}
+		else if (TextReader::IsTextFile(plyfile))
+		{
+			TextReader textReader(plyfile);
+			computeNormals |= !textReader.HasNormals();
+			WriteRecords(textReader, pointcloudFile, !computeNormals, buffers, minPosition, maxPosition, vertexCount);
+		}
+		else
+		{
+			PlyReader plyReader(plyfile);
+
+			if (plyReader.IsStreamable())
+			{
+				computeNormals |= !plyReader.HasNormals();
+				WritePlyRecords(plyReader, pointcloudFile, !computeNormals, buffers, minPosition, maxPosition, vertexCount);
+			}
+			else if (IsTextReadable(plyReader))
+			{
+				TextReader textReader(plyfile);
+				computeNormals |= !textReader.HasNormals();
+				WriteRecords(textReader, pointcloudFile, !computeNormals, buffers, minPosition, maxPosition, vertexCount);
+			}
+			else
+			{
+				computeNormals |= !ConvertPlyVerticesInMemory(plyfile, pointcloudFile, buffers, minPosition, maxPosition, vertexCount);
+			}
+		}
 
-		// Ignore the bounding cube position and size
-		file.ignore(sizeof(Vector3) + sizeof(float));
+		log << "read " << vertexCount << " vertices in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - readStart).count() << " s...";
 
-		// Load the size of the vertices vector
-		UINT vertexCount;
-		file.read((char*)&vertexCount, sizeof(UINT));
+		// Only builds with 32 bit indices (POINTCLOUD_32BIT_INDICES) have a limit below the 64 bit vertex count of the header
+		if (vertexCount > maxPointcloudVertexCount)
+		{
+			throw std::exception("Too many vertices for 32 bit indices, build without POINTCLOUD_32BIT_INDICES to convert this file");
+		}
+
+		if (vertexCount > 0)
+		{
+			Vector3 diagonal = maxPosition - minPosition;
+			header.boundingCubePosition = minPosition + 0.5f * diagonal;
+			header.boundingCubeSize = max(max(diagonal.x, diagonal.y), diagonal.z);
+		}
+
+		// Write the bounding cube position, size and the number of vertices
+		header.vertexCount = vertexCount;
+		pointcloudFile.seekp(0);
+		pointcloudFile.write((char*)&header, sizeof(PointcloudHeader));
+
+		pointcloudFile.flush();
+		pointcloudFile.close();
+
+		// The merged vertices stay inside the bounding cube of the original vertices
+		if (voxelSize > 0)
+		{
+			vertexCount = FilterPointcloudFile(pointcloudfile, header, jobMemoryBudget, log);
+			header.vertexCount = vertexCount;
+		}
 
-		// Read the binary data directly into the vertices vector
-		std::vector<PointcloudVertex> pointcloudVertices(vertexCount);
-		file.read((char*)pointcloudVertices.data(), vertexCount * sizeof(PointcloudVertex));
+		std::vector<BYTE> radii;
+		std::vector<PointcloudChunk> chunks = OrderPointcloudFile(pointcloudfile, header, computeNormals, jobMemoryBudget, radii, log);
 
-		// Convert to .ply vertices
-		std::vector<PlyVertex> plyVertices(vertexCount);
+		header.flags = writeChecksums ? pointcloudFlagChecksums : 0;
 
-		for (UINT i = 0; i < vertexCount; i++)
+		if (compress)
 		{
-			plyVertices[i].position = pointcloudVertices[i].position;
-			plyVertices[i].normal.x = pointcloudVertices[i].normal[0] / 127.0f;
-			plyVertices[i].normal.y = pointcloudVertices[i].normal[1] / 127.0f;
-			plyVertices[i].normal.z = pointcloudVertices[i].normal[2] / 127.0f;
-			plyVertices[i].color[0] = pointcloudVertices[i].color[0];
-			plyVertices[i].color[1] = pointcloudVertices[i].color[1];
-			plyVertices[i].color[2] = pointcloudVertices[i].color[2];
+			CompressPointcloudFile(pointcloudfile, header, chunks, log);
 		}
+		else
+		{
+			// Append the chunk directory after the vertices and update the header
+			header.chunkCount = chunks.size();
+			header.chunkDirectoryOffset = header.dataOffset + vertexCount * PointcloudFile::GetRecordSize(header.encoding);
 
-		// Write the .ply file
-		std::ofstream plyfile(pointcloudfile.substr(0, pointcloudfile.length() - 10) + "ply", std::ios::out | std::ios::binary);
+			pointcloudFile.open(pointcloudfile, std::ios::in | std::ios::out | std::ios::binary);
+			pointcloudFile.seekp(header.chunkDirectoryOffset);
+			pointcloudFile.write((char*)chunks.data(), chunks.size() * sizeof(PointcloudChunk));
+			pointcloudFile.seekp(0);
+			pointcloudFile.write((char*)&header, sizeof(PointcloudHeader));
+			pointcloudFile.flush();
+			pointcloudFile.close();
+		}
 
-		// Write the header
-		plyfile << "ply" << std::endl;
-		plyfile << "format binary_little_endian 1.0" << std::endl;
-		plyfile << "element vertex " << vertexCount << std::endl;
-		plyfile << "property float x" << std::endl;
-		plyfile << "property float y" << std::endl;
-		plyfile << "property float z" << std::endl;
-		plyfile << "property float nx" << std::endl;
-		plyfile << "property float ny" << std::endl;
-		plyfile << "property float nz" << std::endl;
-		plyfile << "property uchar red" << std::endl;
-		plyfile << "property uchar green" << std::endl;
-		plyfile << "property uchar blue" << std::endl;
-		plyfile << "element face 0" << std::endl;
-		plyfile << "end_header" << std::endl;
+		if (!radii.empty())
+		{
+			AppendRadii(pointcloudfile, header, radii);
+		}
 
-		// Write the vertices data in binary format
-		for (int i = 0; i < vertexCount; i++)
+		if (!MoveFileExA(pointcloudfile.c_str(), finalfile.c_str(), MOVEFILE_REPLACE_EXISTING))
 		{
-			plyfile.write((char*)&plyVertices[i].position, sizeof(Vector3));
-			plyfile.write((char*)&plyVertices[i].normal, sizeof(Vector3));
-			plyfile.write((char*)&plyVertices[i].color, 3 * sizeof(char));
+			throw std::exception("Could not replace the .pointcloud file with the converted file");
 		}
 
-		plyfile.flush();
-		plyfile.close();
+		outVertexCount = vertexCount;
+
+		if (header.encoding != PointcloudEncoding::Float)
+		{
+			log << "maximum position error " << header.positionError << " (bound " << PointcloudFile::GetPositionErrorBound(header.encoding, header.boundingCubePosition, header.boundingCubeSize) << ")...";
+		}
+	}
+	catch (const std::exception& e)
+	{
+		log << "ERROR" << std::endl;
+		DeleteFileA(pointcloudfile.c_str());
+		success = false;
+	}
+
+	log << "DONE" << std::endl;
+
+	return success;
+}
+
+void PointcloudToPly(std::string pointcloudfile)
+{
+	std::cout << "Converting \"" << pointcloudfile << "\" to .ply file format...";
+
+	try
+	{
+		// Map the point cloud file, this supports all versions of the header
+		PointcloudFile file;
+
+		if (!file.Open(pointcloudfile))
+		{
+			throw std::exception("Could not open the .pointcloud file");
+		}
+
+		// Export only the selected chunks, the checksums of these chunks are compared if the file has them
+		std::vector<UINT64> selectedChunks = file.SelectChunks(selection);
+		auto start = std::chrono::steady_clock::now();
+
+		PlyWriter plyWriter(pointcloudfile.substr(0, pointcloudfile.length() - 10) + "ply", exportAscii);
+		plyWriter.Write(file, selectedChunks, selection.verifyChecksums);
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		double megabytes = plyWriter.GetBytesWritten() / (1024.0 * 1024.0);
+
+		std::cout << "wrote " << file.GetVertexCount(selectedChunks) << " vertices (" << megabytes << " MB) in " << seconds << " s (" << megabytes / seconds << " MB/s)...";
 	}
 	catch (const std::exception& e)
 	{
@@ -206,32 +859,255 @@ void PointcloudToPly(std::string pointcloudfile)
 int main(int argc, char* argv[])
 {
 	std::cout << "This program converts between .ply and .pointcloud file format!" << std::endl;
-	std::cout << "Only ply files with (x,y,z,nx,ny,nz,red,green,blue) format are supported!" << std::endl;
-	std::cout << "You can generate this ply format by exporting files with e.g. MeshLab." << std::endl << std::endl;
+	std::cout << "Supports ply files with (x,y,z,red,green,blue) and optional (nx,ny,nz) properties as well as las, xyz and pts files." << std::endl;
+	std::cout << "The normals are estimated from the nearest neighbors of each vertex if the file has no (nx,ny,nz) properties." << std::endl;
+	std::cout << "You can export other ply formats to this format with e.g. MeshLab." << std::endl;
+	std::cout << "Binary ply files are converted in chunks, ascii ply files are parsed in parallel in blocks of lines." << std::endl;
+	std::cout << "Text files with one point per line (.xyz with x y z [r g b] [nx ny nz], .pts with x y z [intensity] [r g b]) are parsed the same way." << std::endl;
+	std::cout << "Uncompressed las files (point formats 0 to 10) are converted in chunks, formats without rgb use the intensity as color." << std::endl << std::endl;
 	
 	std::cout << "The .pointcloud file format stores the following binary data:" << std::endl;
+	std::cout << "\tuint - magic number 0xFFFF5043 (a NaN when read as float, version 1 files start with the bounding cube position instead)" << std::endl;
+	std::cout << "\tuint - version" << std::endl;
 	std::cout << "\tVector3 - position of the bounding cube" << std::endl;
 	std::cout << "\tfloat - size of the bounding cube" << std::endl;
-	std::cout << "\tuint - length of the vertex array" << std::endl;
+	std::cout << "\tuint64 - length of the vertex array" << std::endl;
+	std::cout << "\tuint64 - seed of the random vertex order" << std::endl;
+	std::cout << "\tuint64 - offset of the vertex array in bytes" << std::endl;
+	std::cout << "\tuint64 - number of chunks" << std::endl;
+	std::cout << "\tuint64 - offset of the chunk directory in bytes" << std::endl;
+	std::cout << "\tuint - vertex order (0 random, 1 stratified, 2 spatial, 3 morton)" << std::endl;
+	std::cout << "\tuint - flags (1 chunks have checksums, 2 chunks are compressed, 4 vertices have splat radii)" << std::endl;
+	std::cout << "\tuint - position encoding (0 float, 1 fixed16, 2 fixed21)" << std::endl;
+	std::cout << "\tfloat - largest position error along an axis" << std::endl;
+	std::cout << "\tuint64 - offset of the splat radii in bytes" << std::endl;
 	std::cout << "\tvector - list of vertices" << std::endl;
+	std::cout << "\tvector - chunk directory" << std::endl;
+	std::cout << "\tvector - optional splat radii, one byte r per vertex that encodes the radius cube size * 2^(-(r - 1) / 12), zero is unknown" << std::endl;
 	std::cout << "Each vertex consists of:" << std::endl;
-	std::cout << "\tVector3 - position" << std::endl;
+	std::cout << "\tVector3 - position (float encoding, padded to 20 bytes)" << std::endl;
+	std::cout << "\tushort[3] - position inside the bounding cube with 65535 steps per axis (fixed16 encoding, 12 bytes)" << std::endl;
+	std::cout << "\tuint64 - position inside the bounding cube with 21 bits per axis, x in the lowest bits (fixed21 encoding, 14 bytes)" << std::endl;
 	std::cout << "\tchar[3] - normalized normal" << std::endl;
-	std::cout << "\tuchar[3] - rgb color" << std::endl << std::endl;
+	std::cout << "\tuchar[3] - rgb color" << std::endl;
+	std::cout << "Each chunk consists of:" << std::endl;
+	std::cout << "\tuint64 - offset of the first vertex in bytes" << std::endl;
+	std::cout << "\tuint64 - size in bytes" << std::endl;
+	std::cout << "\tuint64 - number of vertices" << std::endl;
+	std::cout << "\tVector3[2] - minimum and maximum of the bounding box" << std::endl;
+	std::cout << "\tuint64 - xxHash64 checksum of the vertices (of the compressed block in compressed files)" << std::endl;
+	std::cout << "Compressed chunks store three streams (positions, normals, colors) that each consist of:" << std::endl;
+	std::cout << "\tuint64 - mode (0 raw, 1 rANS with a table of 256 ushort symbol frequencies)" << std::endl;
+	std::cout << "\tuint64 - size of the raw stream" << std::endl;
+	std::cout << "\tuint64 - size of the stored stream" << std::endl;
+	std::cout << "\tvector - stored stream, the raw stream stores all x, y and z values (varint zigzag deltas for positions, byte deltas otherwise)" << std::endl << std::endl;
 	
-	std::cout << "Drag and drop .ply files to generate the corresponding .pointcloud files." << std::endl;
-	std::cout << "Drag and drop .pointcloud files to generate the original .ply file." << std::endl << std::endl;
+	std::cout << "Drag and drop .ply, .las, .xyz or .pts files to generate the corresponding .pointcloud files." << std::endl;
+	std::cout << "Drag and drop .pointcloud files to generate the original .ply file." << std::endl;
+	std::cout << "Directories and glob patterns (e.g. scans/**/*.ply) convert all the .ply, .las, .xyz and .pts files they contain concurrently." << std::endl << std::endl;
+
+	std::cout << "Options (before the files):" << std::endl;
+	std::cout << "\t-seed=<number> - seed of the random vertex order, the same seed always produces the same file" << std::endl;
+	std::cout << "\t-memory=<MB> - larger point clouds are shuffled through a temporary file (default half of the physical memory)" << std::endl;
+	std::cout << "\t-order=random - random vertex order, any prefix is a random subset (default)" << std::endl;
+	std::cout << "\t-order=stratified - progressive vertex order, any prefix covers the point cloud evenly without clumps and holes" << std::endl;
+	std::cout << "\t-order=spatial - each chunk covers a compact region and is shuffled internally, regions can be exported without reading the whole file" << std::endl;
+	std::cout << "\t-order=morton - like the spatial order but without shuffling the chunks, best order for compression" << std::endl;
+	std::cout << "\t-checksums=0 - do not store checksums of the chunks" << std::endl;
+	std::cout << "\t-encoding=fixed16 or -encoding=fixed21 - quantize the positions inside the bounding cube, the error is about half of the cube size divided by 2^bits - 1" << std::endl;
+	std::cout << "\t-compress - compress each chunk losslessly, works best together with -order=morton" << std::endl;
+	std::cout << "\t-chunks=<a,b,c> - only export these chunks of .pointcloud files" << std::endl;
+	std::cout << "\t-region=<minx,miny,minz,maxx,maxy,maxz> - only export the chunks that intersect this box" << std::endl;
+	std::cout << "\t-ascii - export .pointcloud files as ascii .ply files instead of binary" << std::endl;
+	std::cout << "\t-normals=estimate - estimate the normals even if the .ply file has normals" << std::endl;
+	std::cout << "\t-neighbors=<number> - number of nearest neighbors for the normal estimation (default 16)" << std::endl;
+	std::cout << "\t-viewpoint=<x,y,z> - orient the estimated normals towards this point, e.g. the scanner origin (default away from the center of the bounding cube)" << std::endl;
+	std::cout << "\t-voxel=<size> - merge the vertices inside each voxel of this size into one vertex with the mean position, normal and color, removes duplicates of merged scans" << std::endl;
+	std::cout << "\t-lascolors=8 - read the colors of .las files as 8 bit values for writers that do not scale them to 16 bits as specified" << std::endl;
+	std::cout << "\t-radii or -radii=<number> - store the distance to this nearest neighbor (default 4) as splat radius of each vertex, the renderer sizes the splats with it" << std::endl;
+	std::cout << "\t-benchmark - compare the parsing speed of tinyply and the readers of the conversion on the following .ply files instead of converting them" << std::endl;
+	std::cout << "\t-batch - also convert the .ply files that are given directly concurrently, files with an up to date .pointcloud file are skipped" << std::endl;
+	std::cout << "\t-jobs=<number> - maximum number of concurrent conversions in batch mode (default number of threads), they share the memory budget" << std::endl;
+	std::cout << "\t-summary=<file> - JSON file with the timings, point counts and throughput of each file in batch mode (default PlyToPointcloudSummary.json)" << std::endl << std::endl;
+
+	// Exported chunks are always compared against their checksums
+	selection.verifyChecksums = true;
+
+	std::vector<std::string> batchPaths;
 
 	for (int i = 1; i < argc; i++)
 	{
 		std::string filename(argv[i]);
 
+		if (filename.compare(0, 6, "-seed=") == 0)
+		{
+			hasSeed = true;
+			seed = std::stoull(filename.substr(6));
+			continue;
+		}
+		else if (filename.compare(0, 8, "-memory=") == 0)
+		{
+			memoryBudget = std::stoull(filename.substr(8)) * 1024 * 1024;
+			continue;
+		}
+		else if (filename.compare(0, 7, "-order=") == 0)
+		{
+			std::string value = filename.substr(7);
+			order = PointcloudOrder::Random;
+
+			if (value.compare("stratified") == 0)
+			{
+				order = PointcloudOrder::Stratified;
+			}
+			else if (value.compare("spatial") == 0)
+			{
+				order = PointcloudOrder::Spatial;
+			}
+			else if (value.compare("morton") == 0)
+			{
+				order = PointcloudOrder::Morton;
+			}
+
+			continue;
+		}
+		else if (filename.compare(0, 11, "-checksums=") == 0)
+		{
+			writeChecksums = std::stoi(filename.substr(11)) != 0;
+			continue;
+		}
+		else if (filename.compare(0, 10, "-encoding=") == 0)
+		{
+			std::string value = filename.substr(10);
+			encoding = (value.compare("fixed16") == 0) ? PointcloudEncoding::Fixed16 : ((value.compare("fixed21") == 0) ? PointcloudEncoding::Fixed21 : PointcloudEncoding::Float);
+			continue;
+		}
+		else if (filename.compare("-compress") == 0)
+		{
+			compress = true;
+			continue;
+		}
+		else if (filename.compare(0, 8, "-chunks=") == 0)
+		{
+			std::stringstream values(filename.substr(8));
+			std::string value;
+
+			while (std::getline(values, value, ','))
+			{
+				selection.chunks.push_back(std::stoull(value));
+			}
+
+			continue;
+		}
+		else if (filename.compare(0, 8, "-region=") == 0)
+		{
+			std::stringstream values(filename.substr(8));
+			std::string value;
+			float region[6] = { -FLT_MAX, -FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+
+			for (int j = 0; j < 6 && std::getline(values, value, ','); j++)
+			{
+				region[j] = std::stof(value);
+			}
+
+			selection.useRegion = true;
+			selection.regionMin = Vector3(region[0], region[1], region[2]);
+			selection.regionMax = Vector3(region[3], region[4], region[5]);
+			continue;
+		}
+		else if (filename.compare(0, 11, "-lascolors=") == 0)
+		{
+			lasColorBits = std::stoi(filename.substr(11));
+			continue;
+		}
+		else if (filename.compare("-ascii") == 0)
+		{
+			exportAscii = true;
+			continue;
+		}
+		else if (filename.compare("-normals=estimate") == 0)
+		{
+			estimateNormals = true;
+			continue;
+		}
+		else if (filename.compare(0, 11, "-neighbors=") == 0)
+		{
+			neighborCount = max(3UL, std::stoul(filename.substr(11)));
+			continue;
+		}
+		else if (filename.compare(0, 11, "-viewpoint=") == 0)
+		{
+			std::stringstream values(filename.substr(11));
+			std::string value;
+			float coordinates[3] = { 0, 0, 0 };
+
+			for (int j = 0; j < 3 && std::getline(values, value, ','); j++)
+			{
+				coordinates[j] = std::stof(value);
+			}
+
+			hasViewpoint = true;
+			viewpoint = Vector3(coordinates[0], coordinates[1], coordinates[2]);
+			continue;
+		}
+		else if (filename.compare(0, 7, "-voxel=") == 0)
+		{
+			voxelSize = std::stof(filename.substr(7));
+			continue;
+		}
+		else if (filename.compare("-radii") == 0)
+		{
+			radiusNeighborCount = 4;
+			continue;
+		}
+		else if (filename.compare(0, 7, "-radii=") == 0)
+		{
+			radiusNeighborCount = max(1UL, std::stoul(filename.substr(7)));
+			continue;
+		}
+		else if (filename.compare("-benchmark") == 0)
+		{
+			benchmark = true;
+			continue;
+		}
+		else if (filename.compare("-batch") == 0)
+		{
+			batch = true;
+			continue;
+		}
+		else if (filename.compare(0, 6, "-jobs=") == 0)
+		{
+			jobCount = std::stoul(filename.substr(6));
+			continue;
+		}
+		else if (filename.compare(0, 9, "-summary=") == 0)
+		{
+			summaryFilename = filename.substr(9);
+			continue;
+		}
+
 		// Check if it is a .ply or .pointcloud file
 		std::string filetype = filename.substr(filename.find_last_of(".") + 1, filename.length());
+		std::error_code error;
 
-		if (filetype.compare("ply") == 0 || filetype.compare("PLY") == 0)
+		if (filename.find_first_of("*?") != std::string::npos || std::filesystem::is_directory(filename, error))
+		{
+			batchPaths.push_back(filename);
+		}
+		else if (benchmark && (filetype.compare("ply") == 0 || filetype.compare("PLY") == 0))
 		{
-			PlyToPointcloud(filename);
+			BenchmarkParsing(filename);
+		}
+		else if (filetype.compare("ply") == 0 || filetype.compare("PLY") == 0 || LasReader::IsLasFile(filename) || TextReader::IsTextFile(filename))
+		{
+			if (batch)
+			{
+				batchPaths.push_back(filename);
+			}
+			else
+			{
+				UINT64 vertexCount;
+				PlyToPointcloud(filename, memoryBudget, std::cout, vertexCount);
+			}
 		}
 		else if (filetype.compare("pointcloud") == 0 || filetype.compare("POINTCLOUD") == 0)
 		{
@@ -244,5 +1120,23 @@ int main(int argc, char* argv[])
 		}
 	}
 
+	if (!batchPaths.empty())
+	{
+		BatchConverter batchConverter(jobCount, memoryBudget);
+
+		for (auto it = batchPaths.begin(); it != batchPaths.end(); it++)
+		{
+			if (!batchConverter.Add(*it))
+			{
+				std::cout << "No .ply, .las, .xyz or .pts files found for " << *it << std::endl;
+			}
+		}
+
+		if (batchConverter.Convert(PlyToPointcloud, summaryFilename) > 0)
+		{
+			return S_FALSE;
+		}
+	}
+
 	return S_OK;
 }
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "PlyWriter.h"
+#include <charconv>
+#include <cstring>
+#include <thread>
+
+PlyWriter::PlyWriter(const std::string& filename, bool ascii) : ascii(ascii)
+{
+	file.open(filename, std::ios::out | std::ios::binary);
+
+	if (!file.is_open())
+	{
+		throw std::exception("Could not create the .ply file");
+	}
+
+	blockVertexCount = blockBytes / (ascii ? maxAsciiVertexBytes : binaryVertexBytes);
+}
+
+void PlyWriter::Write(const PointcloudFile& pointcloudFile, const std::vector<UINT64>& selectedChunks, bool verifyChecksums)
+{
+	WriteHeader(pointcloudFile.GetVertexCount(selectedChunks));
+
+	// The writer thread owns one buffer while the other one is filled
+	std::thread writer;
+	UINT current = 0;
+
+	auto waitForWriter = [&]()
+	{
+		if (writer.joinable())
+		{
+			writer.join();
+		}
+	};
+
+	try
+	{
+		for (UINT64 chunk : selectedChunks)
+		{
+			if (verifyChecksums && !pointcloudFile.VerifyChunk(chunk))
+			{
+				throw std::exception("The checksum of a chunk does not match, the .pointcloud file is corrupted");
+			}
+
+			UINT64 chunkStart = pointcloudFile.GetChunkStart(chunk);
+			UINT64 chunkVertexCount = pointcloudFile.chunks[chunk].vertexCount;
+
+			for (UINT64 start = 0; start < chunkVertexCount; start += blockVertexCount)
+			{
+				UINT64 count = min(blockVertexCount, chunkVertexCount - start);
+				vertices.resize(max((UINT64)vertices.size(), count));
+				pointcloudFile.DecodeVertices(chunkStart + start, count, vertices.data());
+
+				std::vector<char>& buffer = buffers[current];
+				UINT64 size = ascii ? FormatAscii(count, buffer) : FormatBinary(count, buffer);
+
+				waitForWriter();
+
+				if (!file)
+				{
+					throw std::exception("Could not write the .ply file");
+				}
+
+				writer = std::thread([this, &buffer, size]()
+				{
+					file.write(buffer.data(), size);
+				});
+
+				bytesWritten += size;
+				current = 1 - current;
+			}
+		}
+	}
+	catch (...)
+	{
+		waitForWriter();
+		throw;
+	}
+
+	waitForWriter();
+	file.flush();
+
+	if (!file)
+	{
+		throw std::exception("Could not write the .ply file");
+	}
+}
+
+UINT64 PlyWriter::GetBytesWritten() const
+{
+	return bytesWritten;
+}
+
+void PlyWriter::WriteHeader(UINT64 vertexCount)
+{
+	std::string header = "ply\n";
+	header += ascii ? "format ascii 1.0\n" : "format binary_little_endian 1.0\n";
+	header += "element vertex " + std::to_string(vertexCount) + "\n";
+	header += "property float x\nproperty float y\nproperty float z\n";
+	header += "property float nx\nproperty float ny\nproperty float nz\n";
+	header += "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+	header += "element face 0\n";
+	header += "end_header\n";
+
+	file.write(header.data(), header.size());
+	bytesWritten += header.size();
+}
+
+UINT64 PlyWriter::FormatBinary(UINT64 count, std::vector<char>& outBuffer) const
+{
+	outBuffer.resize(max((UINT64)outBuffer.size(), count * binaryVertexBytes));
+
+	ThreadPool::Get().ParallelFor(count, 64 * 1024, [&](UINT64 start, UINT64 end)
+	{
+		char* output = outBuffer.data() + start * binaryVertexBytes;
+
+		for (UINT64 i = start; i < end; i++)
+		{
+			memcpy(output, &vertices[i].position, sizeof(Vector3));
+			memcpy(output + sizeof(Vector3), &vertices[i].normal, sizeof(Vector3));
+			memcpy(output + 2 * sizeof(Vector3), vertices[i].color, 3);
+			output += binaryVertexBytes;
+		}
+	});
+
+	return count * binaryVertexBytes;
+}
+
+UINT64 PlyWriter::FormatAscii(UINT64 count, std::vector<char>& outBuffer)
+{
+	// Each block of lines is formatted at the start of its own region of the buffer
+	UINT64 lineBlockCount = (count + lineBlockSize - 1) / lineBlockSize;
+	outBuffer.resize(max((UINT64)outBuffer.size(), count * maxAsciiVertexBytes));
+	lineBlockSizes.resize(lineBlockCount);
+
+	ThreadPool::Get().ParallelFor(lineBlockCount, 1, [&](UINT64 startBlock, UINT64 endBlock)
+	{
+		for (UINT64 block = startBlock; block < endBlock; block++)
+		{
+			UINT64 start = block * lineBlockSize;
+			UINT64 end = min(start + lineBlockSize, count);
+			char* blockStart = outBuffer.data() + start * maxAsciiVertexBytes;
+			char* output = blockStart;
+
+			for (UINT64 i = start; i < end; i++)
+			{
+				output = FormatLine(vertices[i], output);
+			}
+
+			lineBlockSizes[block] = output - blockStart;
+		}
+	});
+
+	// The regions only move towards the front, therefore they can be compacted in order
+	UINT64 size = 0;
+
+	for (UINT64 block = 0; block < lineBlockCount; block++)
+	{
+		memmove(outBuffer.data() + size, outBuffer.data() + block * lineBlockSize * maxAsciiVertexBytes, lineBlockSizes[block]);
+		size += lineBlockSizes[block];
+	}
+
+	return size;
+}
+
+char* PlyWriter::FormatLine(const Vertex& vertex, char* output)
+{
+	// The shortest representation that reads back as the same float has at most 15 characters
+	const float values[6] = { vertex.position.x, vertex.position.y, vertex.position.z, vertex.normal.x, vertex.normal.y, vertex.normal.z };
+
+	for (int i = 0; i < 6; i++)
+	{
+		output = std::to_chars(output, output + 16, values[i]).ptr;
+		*output++ = ' ';
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		output = std::to_chars(output, output + 3, (UINT)vertex.color[i]).ptr;
+		*output++ = (i < 2) ? ' ' : '\n';
+	}
+
+	return output;
+}
@@ -0,0 +1,52 @@
+#ifndef PLYWRITER_H
+#define PLYWRITER_H
+
+#pragma once
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../PointCloudEngine/PointcloudFile.h"
+
+using namespace PointCloudEngine;
+
+// Exports the selected chunks of a .pointcloud file as binary or ascii .ply file with x,y,z,nx,ny,nz,red,green,blue vertices
+// The chunks are split into blocks that are decoded and formatted in parallel into one of two output buffers
+// Each buffer is written with a single call while the next block is decoded, the memory usage does not depend on the file size
+class PlyWriter
+{
+public:
+	// Size of each output buffer, ascii blocks have fewer vertices since their lines are longer
+	static const UINT64 blockBytes = 64 * 1024 * 1024;
+
+	// Binary records are tightly packed, ascii lines are at most this long
+	static const UINT binaryVertexBytes = 2 * sizeof(Vector3) + 3;
+	static const UINT maxAsciiVertexBytes = 128;
+
+	PlyWriter(const std::string& filename, bool ascii);
+
+	// Writes the header and the vertices, throws if the checksum of a chunk does not match or the file cannot be written
+	void Write(const PointcloudFile& pointcloudFile, const std::vector<UINT64>& selectedChunks, bool verifyChecksums);
+
+	UINT64 GetBytesWritten() const;
+
+private:
+	// Number of vertices that are formatted by one task in ascii format, their lines are compacted afterwards
+	const UINT64 lineBlockSize = 16 * 1024;
+
+	std::ofstream file;
+	bool ascii;
+	UINT64 blockVertexCount;
+	UINT64 bytesWritten = 0;
+	std::vector<Vertex> vertices;
+	std::vector<char> buffers[2];
+	std::vector<UINT64> lineBlockSizes;
+
+	void WriteHeader(UINT64 vertexCount);
+
+	// Formats the decoded vertices into the buffer and returns the number of bytes
+	UINT64 FormatBinary(UINT64 count, std::vector<char>& outBuffer) const;
+	UINT64 FormatAscii(UINT64 count, std::vector<char>& outBuffer);
+	static char* FormatLine(const Vertex& vertex, char* output);
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "PointcloudQuantizer.h"
+
+float PointcloudQuantizer::Quantize(BYTE* records, UINT64 count, PointcloudEncoding encoding, const Vector3& boundingCubePosition, float boundingCubeSize)
+{
+	UINT recordSize = PointcloudFile::GetRecordSize(encoding);
+	float positionStep = PointcloudFile::GetPositionStep(encoding, boundingCubeSize);
+	Vector3 positionMin = boundingCubePosition - 0.5f * Vector3(boundingCubeSize, boundingCubeSize, boundingCubeSize);
+
+	if (encoding == PointcloudEncoding::Float || count == 0)
+	{
+		return 0;
+	}
+
+	// The quantized records are smaller, each batch is encoded in parallel into a buffer and then copied in front of the unread records
+	UINT64 batchSize = pointcloudChunkSize * ThreadPool::Get().GetThreadCount();
+	std::vector<BYTE> buffer(min(batchSize, count) * recordSize);
+	std::mutex errorMutex;
+	float maxError = 0;
+
+	for (UINT64 batchStart = 0; batchStart < count; batchStart += batchSize)
+	{
+		UINT64 batchCount = min(batchSize, count - batchStart);
+		const PointcloudVertex* vertices = (const PointcloudVertex*)records + batchStart;
+
+		ThreadPool::Get().ParallelFor(batchCount, 64 * 1024, [&](UINT64 start, UINT64 end)
+		{
+			float error;
+
+			if (encoding == PointcloudEncoding::Fixed16)
+			{
+				error = EncodeVertices(vertices + start, end - start, positionMin, positionStep, (PointcloudVertexFixed16*)buffer.data() + start);
+			}
+			else
+			{
+				error = EncodeVertices(vertices + start, end - start, positionMin, positionStep, (PointcloudVertexFixed21*)buffer.data() + start);
+			}
+
+			std::lock_guard<std::mutex> lock(errorMutex);
+			maxError = max(maxError, error);
+		});
+
+		memcpy(records + batchStart * recordSize, buffer.data(), batchCount * recordSize);
+	}
+
+	return maxError;
+}
+
+UINT PointcloudQuantizer::QuantizeCoordinate(float value, float minValue, float step, UINT maxCell)
+{
+	if (step <= 0)
+	{
+		return 0;
+	}
+
+	double cell = ((double)value - minValue) / step + 0.5;
+
+	return (UINT)min(max(cell, 0.0), (double)maxCell);
+}
+
+void PointcloudQuantizer::EncodeVertex(const PointcloudVertex& vertex, const Vector3& positionMin, float positionStep, PointcloudVertexFixed16& outVertex)
+{
+	outVertex.position[0] = QuantizeCoordinate(vertex.position.x, positionMin.x, positionStep, 0xFFFF);
+	outVertex.position[1] = QuantizeCoordinate(vertex.position.y, positionMin.y, positionStep, 0xFFFF);
+	outVertex.position[2] = QuantizeCoordinate(vertex.position.z, positionMin.z, positionStep, 0xFFFF);
+	memcpy(outVertex.normal, vertex.normal, sizeof(outVertex.normal));
+	memcpy(outVertex.color, vertex.color, sizeof(outVertex.color));
+}
+
+void PointcloudQuantizer::EncodeVertex(const PointcloudVertex& vertex, const Vector3& positionMin, float positionStep, PointcloudVertexFixed21& outVertex)
+{
+	UINT64 x = QuantizeCoordinate(vertex.position.x, positionMin.x, positionStep, 0x1FFFFF);
+	UINT64 y = QuantizeCoordinate(vertex.position.y, positionMin.y, positionStep, 0x1FFFFF);
+	UINT64 z = QuantizeCoordinate(vertex.position.z, positionMin.z, positionStep, 0x1FFFFF);
+	UINT64 position = x | (y << 21) | (z << 42);
+
+	memcpy(outVertex.position, &position, sizeof(UINT64));
+	memcpy(outVertex.normal, vertex.normal, sizeof(outVertex.normal));
+	memcpy(outVertex.color, vertex.color, sizeof(outVertex.color));
+}
+
+template<typename T> float PointcloudQuantizer::EncodeVertices(const PointcloudVertex* vertices, UINT64 count, const Vector3& positionMin, float positionStep, T* output)
+{
+	float maxError = 0;
+	Vertex decoded;
+
+	for (UINT64 i = 0; i < count; i++)
+	{
+		EncodeVertex(vertices[i], positionMin, positionStep, output[i]);
+
+		// Measure the error with the same decoding as the loader
+		PointcloudFile::DecodeVertex(output[i], positionMin, positionStep, decoded);
+		Vector3 error = decoded.position - vertices[i].position;
+		maxError = max(maxError, max(max(fabsf(error.x), fabsf(error.y)), fabsf(error.z)));
+	}
+
+	return maxError;
+}
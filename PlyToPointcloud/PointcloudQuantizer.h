@@ -0,0 +1,27 @@
+#ifndef POINTCLOUDQUANTIZER_H
+#define POINTCLOUDQUANTIZER_H
+
+#pragma once
+#include <vector>
+#include <mutex>
+#include "../PointCloudEngine/PointcloudFile.h"
+
+using namespace PointCloudEngine;
+
+// Converts float records into records with fixed point positions inside the bounding cube
+// Each coordinate is rounded to the nearest point of a grid with 2^bits points per axis that includes both sides of the cube
+class PointcloudQuantizer
+{
+public:
+	// Encodes the records in place, afterwards the first count * GetRecordSize(encoding) bytes hold the quantized records
+	// Returns the largest difference along an axis between a decoded and the original position
+	static float Quantize(BYTE* records, UINT64 count, PointcloudEncoding encoding, const Vector3& boundingCubePosition, float boundingCubeSize);
+
+private:
+	static UINT QuantizeCoordinate(float value, float minValue, float step, UINT maxCell);
+	static void EncodeVertex(const PointcloudVertex& vertex, const Vector3& positionMin, float positionStep, PointcloudVertexFixed16& outVertex);
+	static void EncodeVertex(const PointcloudVertex& vertex, const Vector3& positionMin, float positionStep, PointcloudVertexFixed21& outVertex);
+	template<typename T> static float EncodeVertices(const PointcloudVertex* vertices, UINT64 count, const Vector3& positionMin, float positionStep, T* output);
+};
+
+#endif
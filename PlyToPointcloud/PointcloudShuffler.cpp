@@ -0,0 +1,245 @@
+#include "PointcloudShuffler.h"
+#include <fstream>
+#include <algorithm>
+
+PointcloudShuffler::PointcloudShuffler(UINT64 seed, UINT64 memoryBudget) : seed(seed), memoryBudget(memoryBudget)
+{
+}
+
+void PointcloudShuffler::Shuffle(PointcloudVertex* vertices, UINT64 count, const std::string& temporaryFilename)
+{
+	if (count < 2)
+	{
+		return;
+	}
+
+	blockCount = (count + blockSize - 1) / blockSize;
+	bucketCount = (UINT)((count + bucketSize - 1) / bucketSize);
+	blockBucketCounts.assign(blockCount * bucketCount, 0);
+
+	// Count how many vertices of each block are assigned to each bucket
+	ThreadPool::Get().ParallelFor(blockCount, 1, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 block = start; block < end; block++)
+		{
+			CountBlock(min(blockSize, count - block * blockSize), block);
+		}
+	});
+
+	if (count * sizeof(PointcloudVertex) <= memoryBudget)
+	{
+		ShuffleInMemory(vertices, count);
+	}
+	else
+	{
+		ShuffleExternal(vertices, count, temporaryFilename);
+	}
+
+	blockBucketCounts.clear();
+}
+
+UINT64 PointcloudShuffler::GetDefaultMemoryBudget()
+{
+	MEMORYSTATUSEX memoryStatus;
+	memoryStatus.dwLength = sizeof(MEMORYSTATUSEX);
+
+	if (!GlobalMemoryStatusEx(&memoryStatus))
+	{
+		return 1024ULL * 1024 * 1024;
+	}
+
+	return memoryStatus.ullTotalPhys / 2;
+}
+
+void PointcloudShuffler::ShuffleInMemory(PointcloudVertex* vertices, UINT64 count)
+{
+	// The buckets are stored one after the other, inside each bucket the vertices of the blocks are in order
+	std::vector<UINT64> blockBucketOffsets(blockCount * bucketCount);
+	std::vector<UINT64> bucketStarts(bucketCount + 1);
+	UINT64 offset = 0;
+
+	for (UINT bucket = 0; bucket < bucketCount; bucket++)
+	{
+		bucketStarts[bucket] = offset;
+
+		for (UINT64 block = 0; block < blockCount; block++)
+		{
+			blockBucketOffsets[block * bucketCount + bucket] = offset;
+			offset += blockBucketCounts[block * bucketCount + bucket];
+		}
+	}
+
+	bucketStarts[bucketCount] = offset;
+
+	std::vector<PointcloudVertex> buckets(count);
+
+	ThreadPool::Get().ParallelFor(blockCount, 1, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 block = start; block < end; block++)
+		{
+			ScatterBlock(vertices + block * blockSize, min(blockSize, count - block * blockSize), block, buckets.data(), blockBucketOffsets.data() + block * bucketCount);
+		}
+	});
+
+	ThreadPool::Get().ParallelFor(bucketCount, 1, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 bucket = start; bucket < end; bucket++)
+		{
+			ShuffleBucket(buckets.data() + bucketStarts[bucket], bucketStarts[bucket + 1] - bucketStarts[bucket], (UINT)bucket);
+		}
+	});
+
+	ThreadPool::Get().ParallelFor(count, blockSize, [&](UINT64 start, UINT64 end)
+	{
+		memcpy(vertices + start, buckets.data() + start, (end - start) * sizeof(PointcloudVertex));
+	});
+}
+
+void PointcloudShuffler::ShuffleExternal(PointcloudVertex* vertices, UINT64 count, const std::string& temporaryFilename)
+{
+	// The temporary file has the same layout as the buckets in memory, each bucket occupies a consecutive region
+	// This is also the final position of the bucket in the output, therefore no additional offsets are required
+	std::vector<UINT64> bucketStarts(bucketCount + 1);
+	std::vector<UINT64> bucketWriteOffsets(bucketCount);
+	UINT64 offset = 0;
+
+	for (UINT bucket = 0; bucket < bucketCount; bucket++)
+	{
+		bucketStarts[bucket] = offset;
+		bucketWriteOffsets[bucket] = offset;
+
+		for (UINT64 block = 0; block < blockCount; block++)
+		{
+			offset += blockBucketCounts[block * bucketCount + bucket];
+		}
+	}
+
+	bucketStarts[bucketCount] = offset;
+
+	std::string bucketFilename = temporaryFilename + ".buckets";
+	std::fstream bucketFile(bucketFilename, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+
+	if (!bucketFile.is_open())
+	{
+		throw std::exception("Could not create the temporary bucket file");
+	}
+
+	// Scatter a batch of blocks in parallel into local bucket order, then append each bucket slice to its region in the file
+	UINT64 batchSize = ThreadPool::Get().GetThreadCount();
+	std::vector<PointcloudVertex> staging(batchSize * blockSize);
+	std::vector<UINT64> localOffsets(batchSize * bucketCount);
+
+	for (UINT64 batchStart = 0; batchStart < blockCount; batchStart += batchSize)
+	{
+		UINT64 batchEnd = min(batchStart + batchSize, blockCount);
+
+		ThreadPool::Get().ParallelFor(batchEnd - batchStart, 1, [&](UINT64 start, UINT64 end)
+		{
+			for (UINT64 i = start; i < end; i++)
+			{
+				UINT64 block = batchStart + i;
+				UINT64* offsets = localOffsets.data() + i * bucketCount;
+				UINT64 localOffset = i * blockSize;
+
+				for (UINT bucket = 0; bucket < bucketCount; bucket++)
+				{
+					offsets[bucket] = localOffset;
+					localOffset += blockBucketCounts[block * bucketCount + bucket];
+				}
+
+				ScatterBlock(vertices + block * blockSize, min(blockSize, count - block * blockSize), block, staging.data(), offsets);
+			}
+		});
+
+		// After the scatter the local offsets point to the end of each bucket slice
+		for (UINT64 block = batchStart; block < batchEnd; block++)
+		{
+			for (UINT bucket = 0; bucket < bucketCount; bucket++)
+			{
+				UINT64 sliceCount = blockBucketCounts[block * bucketCount + bucket];
+
+				if (sliceCount > 0)
+				{
+					UINT64 sliceStart = localOffsets[(block - batchStart) * bucketCount + bucket] - sliceCount;
+
+					bucketFile.seekp(bucketWriteOffsets[bucket] * sizeof(PointcloudVertex));
+					bucketFile.write((char*)(staging.data() + sliceStart), sliceCount * sizeof(PointcloudVertex));
+					bucketWriteOffsets[bucket] += sliceCount;
+				}
+			}
+		}
+	}
+
+	staging = std::vector<PointcloudVertex>();
+
+	// Read as many consecutive buckets as fit into the memory budget, shuffle them in parallel and write them into the output
+	UINT64 budgetVertices = max(bucketSize, memoryBudget / sizeof(PointcloudVertex));
+	std::vector<PointcloudVertex> buckets;
+
+	for (UINT groupStart = 0; groupStart < bucketCount;)
+	{
+		UINT groupEnd = groupStart + 1;
+
+		while (groupEnd < bucketCount && bucketStarts[groupEnd + 1] - bucketStarts[groupStart] <= budgetVertices)
+		{
+			groupEnd++;
+		}
+
+		UINT64 groupCount = bucketStarts[groupEnd] - bucketStarts[groupStart];
+		buckets.resize(groupCount);
+
+		bucketFile.seekg(bucketStarts[groupStart] * sizeof(PointcloudVertex));
+		bucketFile.read((char*)buckets.data(), groupCount * sizeof(PointcloudVertex));
+
+		if ((UINT64)bucketFile.gcount() != groupCount * sizeof(PointcloudVertex))
+		{
+			throw std::exception("Could not read the temporary bucket file");
+		}
+
+		ThreadPool::Get().ParallelFor(groupEnd - groupStart, 1, [&](UINT64 start, UINT64 end)
+		{
+			for (UINT64 bucket = groupStart + start; bucket < groupStart + end; bucket++)
+			{
+				ShuffleBucket(buckets.data() + bucketStarts[bucket] - bucketStarts[groupStart], bucketStarts[bucket + 1] - bucketStarts[bucket], (UINT)bucket);
+			}
+		});
+
+		memcpy(vertices + bucketStarts[groupStart], buckets.data(), groupCount * sizeof(PointcloudVertex));
+		groupStart = groupEnd;
+	}
+
+	bucketFile.close();
+	DeleteFileA(bucketFilename.c_str());
+}
+
+void PointcloudShuffler::CountBlock(UINT64 count, UINT64 block)
+{
+	Random random(seed, 2 * block);
+	UINT64* counts = blockBucketCounts.data() + block * bucketCount;
+
+	for (UINT64 i = 0; i < count; i++)
+	{
+		counts[random.NextBelow(bucketCount)]++;
+	}
+}
+
+void PointcloudShuffler::ScatterBlock(const PointcloudVertex* vertices, UINT64 count, UINT64 block, PointcloudVertex* output, UINT64* bucketOffsets)
+{
+	// Generates exactly the same bucket assignment as CountBlock
+	Random random(seed, 2 * block);
+
+	for (UINT64 i = 0; i < count; i++)
+	{
+		output[bucketOffsets[random.NextBelow(bucketCount)]++] = vertices[i];
+	}
+}
+
+void PointcloudShuffler::ShuffleBucket(PointcloudVertex* vertices, UINT64 count, UINT bucket)
+{
+	Random random(seed, 2 * (UINT64)bucket + 1);
+
+	for (UINT64 i = count; i > 1; i--)
+	{
+		std::swap(vertices[i - 1], vertices[random.NextBelow64(i)]);
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef POINTCLOUDSHUFFLER_H
+#define POINTCLOUDSHUFFLER_H
+
+#pragma once
+#include <string>
+#include <vector>
+#include "Random.h"
+#include "../PointCloudEngine/PointcloudFile.h"
+
+using namespace PointCloudEngine;
+
+// Computes a uniform random permutation of the vertices in parallel that only depends on the seed
+// Each vertex is assigned to a random bucket and each bucket is then shuffled with Fisher-Yates
+// The buckets are kept in memory if the vertices fit into the memory budget, otherwise they are written to temporary files
+class PointcloudShuffler
+{
+public:
+	PointcloudShuffler(UINT64 seed, UINT64 memoryBudget);
+
+	// Shuffles the vertices in place, the temporary bucket files are created next to the given filename
+	void Shuffle(PointcloudVertex* vertices, UINT64 count, const std::string& temporaryFilename);
+
+	// Half of the physical memory
+	static UINT64 GetDefaultMemoryBudget();
+
+private:
+	// The number of vertices per block and bucket is fixed so that the result does not depend on the memory budget
+	const UINT64 blockSize = 1024 * 1024;
+	const UINT64 bucketSize = 4 * 1024 * 1024;
+
+	UINT64 seed;
+	UINT64 memoryBudget;
+	UINT64 blockCount = 0;
+	UINT bucketCount = 0;
+
+	// Number of vertices of each block that are assigned to each bucket, indexed with block * bucketCount + bucket
+	std::vector<UINT64> blockBucketCounts;
+
+	void ShuffleInMemory(PointcloudVertex* vertices, UINT64 count);
+	void ShuffleExternal(PointcloudVertex* vertices, UINT64 count, const std::string& temporaryFilename);
+	void CountBlock(UINT64 count, UINT64 block);
+	void ScatterBlock(const PointcloudVertex* vertices, UINT64 count, UINT64 block, PointcloudVertex* output, UINT64* bucketOffsets);
+	void ShuffleBucket(PointcloudVertex* vertices, UINT64 count, UINT bucket);
+};
+
+#endif
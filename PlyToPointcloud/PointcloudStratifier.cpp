@@ -0,0 +1,139 @@
+#include "PointcloudStratifier.h"
+
+UINT64 PointcloudStratifier::GetRequiredMemory(UINT64 count)
+{
+	// Keys or levels and indices with their radix sort scratch buffers, then the indices and the reordered vertices
+	return count * (2 * sizeof(UINT64) + 2 * sizeof(PointcloudIndex) + sizeof(PointcloudVertex));
+}
+
+void PointcloudStratifier::Stratify(PointcloudVertex* vertices, UINT64 count, const Vector3& boundingCubePosition, float boundingCubeSize)
+{
+	if (count < 2)
+	{
+		return;
+	}
+
+	std::vector<UINT64> keys;
+	std::vector<PointcloudIndex> indices;
+	ComputeMortonCodes(vertices, count, boundingCubePosition, boundingCubeSize, keys, indices);
+
+	// Vertices in the same voxel are next to each other on every level after sorting by the morton code
+	RadixSort(keys, indices, 3 * levelCount);
+
+	std::vector<UINT64> levels(count, levelCount + 1);
+
+	// Merge the sorted vertices into one entry per voxel (morton code and smallest index) from the finest to the coarsest level
+	// The entries are compacted in place, on each level the vertex with the smallest index of a voxel gets assigned that level
+	UINT64 entryCount = count;
+
+	for (int level = levelCount; level >= 0; level--)
+	{
+		UINT shift = (level == levelCount) ? 0 : 3;
+		UINT64 merged = 0;
+
+		for (UINT64 i = 0; i < entryCount; i++)
+		{
+			UINT64 key = keys[i] >> shift;
+
+			if (merged > 0 && keys[merged - 1] == key)
+			{
+				indices[merged - 1] = min(indices[merged - 1], indices[i]);
+			}
+			else
+			{
+				keys[merged] = key;
+				indices[merged] = indices[i];
+				merged++;
+			}
+		}
+
+		entryCount = merged;
+
+		for (UINT64 i = 0; i < entryCount; i++)
+		{
+			levels[indices[i]] = level;
+		}
+	}
+
+	// Stable sort by level keeps the shuffled order inside each level
+	for (UINT64 i = 0; i < count; i++)
+	{
+		indices[i] = (PointcloudIndex)i;
+	}
+
+	keys = std::vector<UINT64>();
+	RadixSort(levels, indices, 8);
+	levels = std::vector<UINT64>();
+
+	Reorder(vertices, count, indices);
+}
+
+void PointcloudStratifier::SortSpatially(PointcloudVertex* vertices, UINT64 count, const Vector3& boundingCubePosition, float boundingCubeSize, UINT64 seed, bool shuffleChunks)
+{
+	if (count < 2)
+	{
+		return;
+	}
+
+	std::vector<UINT64> keys;
+	std::vector<PointcloudIndex> indices;
+	ComputeMortonCodes(vertices, count, boundingCubePosition, boundingCubeSize, keys, indices);
+	RadixSort(keys, indices, 3 * levelCount);
+	keys = std::vector<UINT64>();
+
+	Reorder(vertices, count, indices);
+
+	if (!shuffleChunks)
+	{
+		return;
+	}
+
+	// The random streams of the shuffler are far below 2^40, the streams of the chunks do not overlap with them
+	UINT64 chunkCount = (count + pointcloudChunkSize - 1) / pointcloudChunkSize;
+
+	ThreadPool::Get().ParallelFor(chunkCount, 1, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 chunk = start; chunk < end; chunk++)
+		{
+			Random random(seed, (1ULL << 40) + 2 * chunk + 1);
+			PointcloudVertex* chunkVertices = vertices + chunk * pointcloudChunkSize;
+			UINT64 chunkVertexCount = min(pointcloudChunkSize, count - chunk * pointcloudChunkSize);
+
+			for (UINT64 i = chunkVertexCount; i > 1; i--)
+			{
+				std::swap(chunkVertices[i - 1], chunkVertices[random.NextBelow64(i)]);
+			}
+		}
+	});
+}
+
+void PointcloudStratifier::ComputeMortonCodes(const PointcloudVertex* vertices, UINT64 count, const Vector3& boundingCubePosition, float boundingCubeSize, std::vector<UINT64>& outKeys, std::vector<PointcloudIndex>& outIndices)
+{
+	Vector3 cubeMin = boundingCubePosition - 0.5f * Vector3(boundingCubeSize, boundingCubeSize, boundingCubeSize);
+	outKeys.resize(count);
+	outIndices.resize(count);
+
+	ThreadPool::Get().ParallelFor(count, 64 * 1024, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 i = start; i < end; i++)
+		{
+			outKeys[i] = Morton::Encode(vertices[i].position, cubeMin, boundingCubeSize, levelCount);
+			outIndices[i] = (PointcloudIndex)i;
+		}
+	});
+}
+
+void PointcloudStratifier::Reorder(PointcloudVertex* vertices, UINT64 count, const std::vector<PointcloudIndex>& indices)
+{
+	std::vector<PointcloudVertex> ordered(count);
+
+	ThreadPool::Get().ParallelFor(count, 64 * 1024, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 i = start; i < end; i++)
+		{
+			ordered[i] = vertices[indices[i]];
+		}
+	});
+
+	memcpy(vertices, ordered.data(), count * sizeof(PointcloudVertex));
+}
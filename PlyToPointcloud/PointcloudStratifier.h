@@ -0,0 +1,37 @@
+#ifndef POINTCLOUDSTRATIFIER_H
+#define POINTCLOUDSTRATIFIER_H
+
+#pragma once
+#include <vector>
+#include "../PointCloudEngine/PointcloudFile.h"
+#include "../PointCloudEngine/Morton.h"
+#include "../PointCloudEngine/RadixSort.h"
+#include "Random.h"
+
+using namespace PointCloudEngine;
+
+// Reorders randomly shuffled vertices into a progressive order where every prefix covers the point cloud evenly
+// Level L holds one vertex of each occupied voxel of a 2^L grid inside the bounding cube that has no vertex on a coarser level yet
+// The vertex that comes first in the shuffled order represents its voxel, therefore the vertices inside each level stay randomly ordered
+// Any prefix contains all the coarser levels and a random subset of the next one, similar to hierarchical Poisson-disk sampling
+class PointcloudStratifier
+{
+public:
+	// Finest grid has 2^16 voxels per axis, the remaining vertices are stored after the last level
+	static const UINT levelCount = 16;
+
+	// Memory that is required for the keys, the sort and the reordered copy of the vertices
+	static UINT64 GetRequiredMemory(UINT64 count);
+
+	static void Stratify(PointcloudVertex* vertices, UINT64 count, const Vector3& boundingCubePosition, float boundingCubeSize);
+
+	// Sorts the vertices along a morton curve so that each chunk covers a compact region, then optionally shuffles the vertices inside each chunk
+	// A prefix of a shuffled chunk is still a random subset of that chunk
+	static void SortSpatially(PointcloudVertex* vertices, UINT64 count, const Vector3& boundingCubePosition, float boundingCubeSize, UINT64 seed, bool shuffleChunks);
+
+private:
+	static void ComputeMortonCodes(const PointcloudVertex* vertices, UINT64 count, const Vector3& boundingCubePosition, float boundingCubeSize, std::vector<UINT64>& outKeys, std::vector<PointcloudIndex>& outIndices);
+	static void Reorder(PointcloudVertex* vertices, UINT64 count, const std::vector<PointcloudIndex>& indices);
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#pragma once
+#include <windows.h>
+
+// Small and fast pseudo random number generator (SplitMix64) that can be split into independent streams
+// The same seed and stream always produce the same sequence, independent of the number of threads
+struct Random
+{
+	UINT64 state;
+
+	Random(UINT64 seed, UINT64 stream = 0)
+	{
+		state = seed;
+		state = Next() ^ (stream * 0xD1B54A32D192ED03ULL);
+		Next();
+	}
+
+	UINT64 Next()
+	{
+		UINT64 z = (state += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+		return z ^ (z >> 31);
+	}
+
+	// Uniform integer in [0, bound) without a division, bound has to fit into 32 bits
+	UINT NextBelow(UINT bound)
+	{
+		return (UINT)(((Next() >> 32) * bound) >> 32);
+	}
+
+	// Uniform integer in [0, bound) for bounds that do not fit into 32 bits
+	UINT64 NextBelow64(UINT64 bound)
+	{
+		return (bound <= UINT_MAX) ? NextBelow((UINT)bound) : Next() % bound;
+	}
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include "SpatialGrid.h"
+
+UINT64 SpatialGrid::GetRequiredMemory(UINT64 count)
+{
+	// Keys and indices with their radix sort scratch buffers, then the sorted positions and the cell tables
+	return count * (2 * sizeof(UINT64) + 2 * sizeof(PointcloudIndex) + sizeof(Vector3) + 2 * sizeof(Cell));
+}
+
+SpatialGrid::SpatialGrid(const PointcloudVertex* vertices, UINT64 count, const Vector3& boundingCubePosition, float boundingCubeSize, UINT pointsPerCell) : boundingCubeSize(boundingCubeSize)
+{
+	cubeMin = boundingCubePosition - 0.5f * Vector3(boundingCubeSize, boundingCubeSize, boundingCubeSize);
+	keys.resize(count);
+	indices.resize(count);
+
+	ThreadPool::Get().ParallelFor(count, 64 * 1024, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 i = start; i < end; i++)
+		{
+			keys[i] = Morton::Encode(vertices[i].position, cubeMin, boundingCubeSize, maxLevel);
+			indices[i] = (PointcloudIndex)i;
+		}
+	});
+
+	RadixSort(keys, indices, 3 * maxLevel);
+	positions.resize(count);
+
+	ThreadPool::Get().ParallelFor(count, 64 * 1024, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 i = start; i < end; i++)
+		{
+			positions[i] = vertices[indices[i]].position;
+		}
+	});
+
+	// The average number of points in the cell of a point is the sum of the squared cell sizes divided by the number of points
+	// It only grows towards the coarser levels, dense regions therefore decide the level and sparse regions use the fallback levels
+	// Cells with more than maxCellCandidates points are left out since their queries are capped, otherwise a cluster of duplicates would decide the level for all the points
+	UINT level = maxLevel;
+
+	for (; level > 0; level--)
+	{
+		UINT shift = 3 * (maxLevel - level);
+		double squaredSum = 0;
+		UINT64 countedPoints = 0;
+		UINT64 cellStart = 0;
+
+		for (UINT64 i = 1; i <= count; i++)
+		{
+			if (i == count || (keys[i] >> shift) != (keys[cellStart] >> shift))
+			{
+				if (i - cellStart <= maxCellCandidates)
+				{
+					squaredSum += (double)(i - cellStart) * (i - cellStart);
+					countedPoints += i - cellStart;
+				}
+
+				cellStart = i;
+			}
+		}
+
+		if (squaredSum >= (double)pointsPerCell * countedPoints)
+		{
+			break;
+		}
+	}
+
+	tables.resize(min(fallbackLevels + 1, level + 1));
+
+	ThreadPool::Get().ParallelFor(tables.size(), 1, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 i = start; i < end; i++)
+		{
+			BuildTable(level - (UINT)i, tables[i]);
+		}
+	});
+}
+
+UINT64 SpatialGrid::GetCount() const
+{
+	return positions.size();
+}
+
+UINT SpatialGrid::GetLevel() const
+{
+	return tables.empty() ? 0 : tables.front().level;
+}
+
+const Vector3& SpatialGrid::GetPosition(UINT64 sortedIndex) const
+{
+	return positions[sortedIndex];
+}
+
+UINT64 SpatialGrid::GetVertexIndex(UINT64 sortedIndex) const
+{
+	return indices[sortedIndex];
+}
+
+void SpatialGrid::FindNeighbors(UINT64 sortedIndex, UINT k, bool exact, std::vector<std::pair<float, UINT64>>& candidates, std::vector<UINT64>& outNeighbors) const
+{
+	const Vector3& position = positions[sortedIndex];
+	UINT64 cellCandidates = max(maxCellCandidates, 4 * (UINT64)k);
+	UINT x, y, z;
+	Morton::Decode(keys[sortedIndex], x, y, z);
+
+	for (const CellTable& table : tables)
+	{
+		UINT shift = maxLevel - table.level;
+		int cellX = x >> shift, cellY = y >> shift, cellZ = z >> shift;
+		int cellsPerAxis = 1 << table.level;
+		candidates.clear();
+
+		for (int neighborZ = max(0, cellZ - 1); neighborZ <= min(cellsPerAxis - 1, cellZ + 1); neighborZ++)
+		{
+			for (int neighborY = max(0, cellY - 1); neighborY <= min(cellsPerAxis - 1, cellY + 1); neighborY++)
+			{
+				for (int neighborX = max(0, cellX - 1); neighborX <= min(cellsPerAxis - 1, cellX + 1); neighborX++)
+				{
+					const Cell* cell = FindCell(table, Morton::Encode(neighborX, neighborY, neighborZ));
+
+					if (cell == NULL)
+					{
+						continue;
+					}
+
+					UINT64 cellStart = cell->start;
+					UINT64 cellEnd = cell->start + cell->count;
+
+					// Only take a window of the sorted points around the query position, the points closest along the morton curve
+					if (cell->count > cellCandidates)
+					{
+						UINT64 center = (sortedIndex >= cellStart && sortedIndex < cellEnd) ? sortedIndex : (UINT64)(std::lower_bound(keys.begin() + cellStart, keys.begin() + cellEnd, keys[sortedIndex]) - keys.begin());
+						cellStart = min(max(center, cellStart + cellCandidates / 2) - cellCandidates / 2, cellEnd - cellCandidates);
+						cellEnd = cellStart + cellCandidates;
+					}
+
+					for (UINT64 i = cellStart; i < cellEnd; i++)
+					{
+						candidates.push_back(std::make_pair(Vector3::DistanceSquared(position, positions[i]), i));
+					}
+				}
+			}
+		}
+
+		// Coarser levels cover a larger region, the last level takes whatever it finds
+		if (&table == &tables.back() || (!exact && candidates.size() >= k))
+		{
+			break;
+		}
+		else if (candidates.size() >= k)
+		{
+			// Every point that is closer than the distance to the border of the 3x3x3 cells is a candidate
+			float cellSize = boundingCubeSize / cellsPerAxis;
+			Vector3 offset = (position - cubeMin) / cellSize - Vector3((float)cellX, (float)cellY, (float)cellZ);
+			float border = cellSize * (1 + min(min(min(offset.x, 1 - offset.x), min(offset.y, 1 - offset.y)), min(offset.z, 1 - offset.z)));
+			std::nth_element(candidates.begin(), candidates.begin() + (k - 1), candidates.end());
+
+			if (candidates[k - 1].first <= border * border)
+			{
+				break;
+			}
+		}
+	}
+
+	UINT64 neighborCount = min((UINT64)k, (UINT64)candidates.size());
+	std::nth_element(candidates.begin(), candidates.begin() + (neighborCount - 1), candidates.end());
+	outNeighbors.resize(neighborCount);
+
+	for (UINT64 i = 0; i < neighborCount; i++)
+	{
+		outNeighbors[i] = candidates[i].second;
+	}
+}
+
+void SpatialGrid::BuildTable(UINT level, CellTable& outTable) const
+{
+	UINT shift = 3 * (maxLevel - level);
+	UINT64 cellCount = 0;
+
+	for (UINT64 i = 0; i < keys.size(); i++)
+	{
+		cellCount += (i == 0 || (keys[i] >> shift) != (keys[i - 1] >> shift)) ? 1 : 0;
+	}
+
+	// At most half of the entries are occupied
+	UINT64 capacity = 1;
+
+	while (capacity < 2 * cellCount)
+	{
+		capacity *= 2;
+	}
+
+	outTable.level = level;
+	outTable.mask = capacity - 1;
+	outTable.cells.assign(capacity, { emptyKey, 0, 0 });
+
+	for (UINT64 start = 0; start < keys.size();)
+	{
+		UINT64 key = keys[start] >> shift;
+		UINT64 end = start + 1;
+
+		while (end < keys.size() && (keys[end] >> shift) == key)
+		{
+			end++;
+		}
+
+		UINT64 slot = HashKey(key) & outTable.mask;
+
+		while (outTable.cells[slot].key != emptyKey)
+		{
+			slot = (slot + 1) & outTable.mask;
+		}
+
+		outTable.cells[slot] = { key, start, end - start };
+		start = end;
+	}
+}
+
+const SpatialGrid::Cell* SpatialGrid::FindCell(const CellTable& table, UINT64 key) const
+{
+	for (UINT64 slot = HashKey(key) & table.mask; ; slot = (slot + 1) & table.mask)
+	{
+		const Cell& cell = table.cells[slot];
+
+		if (cell.key == key)
+		{
+			return &cell;
+		}
+		else if (cell.key == emptyKey)
+		{
+			return NULL;
+		}
+	}
+}
+
+UINT64 SpatialGrid::HashKey(UINT64 key)
+{
+	// Fibonacci hashing mixes the interleaved bits into the lower bits
+	key *= 0x9E3779B97F4A7C15ULL;
+
+	return key ^ (key >> 29);
+}
@@ -0,0 +1,80 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#pragma once
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include "../PointCloudEngine/PointcloudFile.h"
+#include "../PointCloudEngine/Morton.h"
+#include "../PointCloudEngine/RadixSort.h"
+
+using namespace PointCloudEngine;
+
+// Uniform grid inside the bounding cube for approximate nearest neighbor queries
+// The points are sorted along a morton curve, therefore the points of a cell are consecutive on every level of the grid hierarchy
+// Hash tables map the occupied cells of a few levels to their point ranges, queries move to coarser levels where the points are sparse
+class SpatialGrid
+{
+public:
+	// Finest grid has 2^16 cells per axis
+	static const UINT maxLevel = 16;
+
+	// Number of coarser levels that are searched when the cells around a point do not contain enough points
+	static const UINT fallbackLevels = 3;
+
+	// Dense cells (e.g. duplicates at a scanner position) only contribute the points around the query along the morton curve
+	// At most this many or four times the number of neighbors are taken from one cell, this bounds the cost of a query independent of the largest cell
+	static const UINT64 maxCellCandidates = 64;
+
+	// Memory that is required for the keys, the sort, the sorted positions and the cells
+	static UINT64 GetRequiredMemory(UINT64 count);
+
+	// Chooses the finest level where a point shares its cell with about pointsPerCell points on average
+	SpatialGrid(const PointcloudVertex* vertices, UINT64 count, const Vector3& boundingCubePosition, float boundingCubeSize, UINT pointsPerCell);
+
+	UINT64 GetCount() const;
+	UINT GetLevel() const;
+
+	// The points are accessed in sorted order, neighboring indices are close to each other
+	const Vector3& GetPosition(UINT64 sortedIndex) const;
+	UINT64 GetVertexIndex(UINT64 sortedIndex) const;
+
+	// Returns the sorted indices of up to k nearest points from the 3x3x3 cells around the point, including the point itself
+	// The neighbors are exact if the distance to the k-th neighbor is less than the cell size, the candidates are scratch memory
+	// Exact queries also move to a coarser level if the k-th candidate can be outside of the searched cells, unless the coarsest level is reached
+	// Cells with more points than that are only searched partially (see maxCellCandidates), the neighbors in these cells are approximate
+	void FindNeighbors(UINT64 sortedIndex, UINT k, bool exact, std::vector<std::pair<float, UINT64>>& candidates, std::vector<UINT64>& outNeighbors) const;
+
+private:
+	struct Cell
+	{
+		UINT64 key;
+		UINT64 start;
+		UINT64 count;
+	};
+
+	// Open addressing hash table with linear probing of the occupied cells of one level
+	struct CellTable
+	{
+		UINT level;
+		UINT64 mask;
+		std::vector<Cell> cells;
+	};
+
+	static const UINT64 emptyKey = ~0ULL;
+
+	std::vector<UINT64> keys;
+	std::vector<PointcloudIndex> indices;
+	std::vector<Vector3> positions;
+	std::vector<CellTable> tables;
+	Vector3 cubeMin;
+	float boundingCubeSize;
+
+	void BuildTable(UINT level, CellTable& outTable) const;
+	const Cell* FindCell(const CellTable& table, UINT64 key) const;
+
+	static UINT64 HashKey(UINT64 key);
+};
+
+#endif
@@ -0,0 +1,48 @@
+#include "SplatRadiusEstimation.h"
+#include <chrono>
+#include <cmath>
+
+UINT64 SplatRadiusEstimation::GetRequiredMemory(UINT64 count)
+{
+	return SpatialGrid::GetRequiredMemory(count) + count;
+}
+
+SplatRadiusEstimation::Timings SplatRadiusEstimation::Estimate(const PointcloudVertex* vertices, UINT64 count, const Vector3& boundingCubePosition, float boundingCubeSize, UINT neighborCount, std::vector<BYTE>& outRadii)
+{
+	Timings timings;
+	auto start = std::chrono::steady_clock::now();
+
+	// The point itself is the first neighbor
+	SpatialGrid grid(vertices, count, boundingCubePosition, boundingCubeSize, max(2U, (neighborCount + 1) / 2));
+
+	auto gridEnd = std::chrono::steady_clock::now();
+	timings.grid = std::chrono::duration<double>(gridEnd - start).count();
+	outRadii.resize(count);
+
+	ThreadPool::Get().ParallelFor(count, 4096, [&](UINT64 blockStart, UINT64 blockEnd)
+	{
+		std::vector<std::pair<float, UINT64>> candidates;
+		std::vector<UINT64> neighbors;
+
+		for (UINT64 i = blockStart; i < blockEnd; i++)
+		{
+			const Vector3& position = grid.GetPosition(i);
+			float distanceSquared = 0;
+
+			grid.FindNeighbors(i, neighborCount + 1, true, candidates, neighbors);
+
+			for (UINT64 neighbor : neighbors)
+			{
+				distanceSquared = max(distanceSquared, Vector3::DistanceSquared(position, grid.GetPosition(neighbor)));
+			}
+
+			// Isolated points without neighbors get the size of a cell of the grid
+			float radius = (neighbors.size() > 1) ? sqrtf(distanceSquared) : boundingCubeSize / (1U << grid.GetLevel());
+			outRadii[grid.GetVertexIndex(i)] = PointcloudFile::EncodeRadius(radius, boundingCubeSize);
+		}
+	});
+
+	timings.radii = std::chrono::duration<double>(std::chrono::steady_clock::now() - gridEnd).count();
+
+	return timings;
+}
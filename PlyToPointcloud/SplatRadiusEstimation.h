@@ -0,0 +1,28 @@
+#ifndef SPLATRADIUSESTIMATION_H
+#define SPLATRADIUSESTIMATION_H
+
+#pragma once
+#include <vector>
+#include "SpatialGrid.h"
+
+using namespace PointCloudEngine;
+
+// Estimates the local point spacing as the distance to the k-th nearest neighbor of each point
+// Splats with this radius cover the surface without holes in sparse regions and without excessive overdraw in dense regions
+class SplatRadiusEstimation
+{
+public:
+	// Seconds spent in each stage
+	struct Timings
+	{
+		double grid = 0;
+		double radii = 0;
+	};
+
+	static UINT64 GetRequiredMemory(UINT64 count);
+
+	// Stores the quantized radius of each vertex in vertex order (see PointcloudFile::EncodeRadius)
+	static Timings Estimate(const PointcloudVertex* vertices, UINT64 count, const Vector3& boundingCubePosition, float boundingCubeSize, UINT neighborCount, std::vector<BYTE>& outRadii);
+};
+
+#endif
@@ -0,0 +1,412 @@
+#include "TextReader.h"
+#include <charconv>
+#include <cstring>
+#include <algorithm>
+
+// Smaller blocks are not split into pieces, the scheduling would cost more than the parsing
+const UINT64 minPieceBytes = 64 * 1024;
+
+// Number of lines at the start of the data that are used to estimate the line size
+const UINT lineSizeSamples = 64;
+
+TextReader::TextReader(const std::string& filename)
+{
+	if (!file.Open(filename))
+	{
+		throw std::exception("Could not open the text file");
+	}
+
+	if (IsTextFile(filename))
+	{
+		std::string filetype = filename.substr(filename.find_last_of(".") + 1, filename.length());
+		DetectColumns(filetype.compare("pts") == 0 || filetype.compare("PTS") == 0);
+	}
+	else
+	{
+		ply = true;
+		ReadPlyColumns(filename);
+	}
+
+	UINT64 sampleEnd = position;
+	UINT lineCount = 0;
+
+	while (sampleEnd < file.GetSize() && lineCount < lineSizeSamples)
+	{
+		sampleEnd = FindNextLine(sampleEnd);
+		lineCount++;
+	}
+
+	lineSize = (lineCount > 0) ? (UINT)max(1ULL, (sampleEnd - position) / lineCount) : 32;
+}
+
+bool TextReader::HasNormals() const
+{
+	return columns.normal[0] >= 0 && columns.normal[1] >= 0 && columns.normal[2] >= 0;
+}
+
+UINT64 TextReader::GetVertexCount() const
+{
+	return vertexCount;
+}
+
+UINT TextReader::GetVertexSize() const
+{
+	return lineSize;
+}
+
+UINT64 TextReader::ReadRecords(UINT64 maxCount)
+{
+	UINT64 size = file.GetSize();
+
+	// Blocks without any vertex (e.g. only comments) are skipped
+	while (position < size && (!ply || verticesRead < vertexCount))
+	{
+		UINT64 blockBytes = max(1ULL, maxCount * lineSize);
+		UINT64 blockEnd = (blockBytes >= size - position) ? size : FindNextLine(position + blockBytes);
+		UINT64 pieceCount = min((UINT64)ThreadPool::Get().GetThreadCount() * 4, max(1ULL, (blockEnd - position) / minPieceBytes));
+
+		// The pieces keep their vertex buffers between the blocks
+		if (pieces.size() < pieceCount)
+		{
+			pieces.resize(pieceCount);
+		}
+
+		UINT64 pieceStart = position;
+
+		for (UINT64 i = 0; i < pieceCount; i++)
+		{
+			UINT64 pieceEnd = (i + 1 == pieceCount) ? blockEnd : max(pieceStart, min(blockEnd, FindNextLine(position + (blockEnd - position) * (i + 1) / pieceCount)));
+			pieces[i].begin = GetText(pieceStart);
+			pieces[i].end = GetText(pieceEnd);
+			pieceStart = pieceEnd;
+		}
+
+		ThreadPool::Get().ParallelFor(pieceCount, 1, [&](UINT64 start, UINT64 end)
+		{
+			for (UINT64 i = start; i < end; i++)
+			{
+				ParsePiece(pieces[i]);
+			}
+		});
+
+		UINT64 count = 0;
+
+		for (UINT64 i = 0; i < pieceCount; i++)
+		{
+			count += pieces[i].vertices.size();
+		}
+
+		// The lines after the vertex element of a .ply file belong to other elements
+		if (ply)
+		{
+			count = min(count, vertexCount - verticesRead);
+		}
+
+		UINT64 offset = 0;
+
+		for (UINT64 i = 0; i < pieceCount; i++)
+		{
+			if (offset < count && pieces[i].firstInvalid < count - offset)
+			{
+				throw std::exception("The .ply file has a vertex that does not match the properties of the header");
+			}
+
+			offset += pieces[i].vertices.size();
+		}
+
+		vertices.resize(count);
+
+		ThreadPool::Get().ParallelFor(pieceCount, 1, [&](UINT64 start, UINT64 end)
+		{
+			UINT64 pieceOffset = 0;
+
+			for (UINT64 i = 0; i < start; i++)
+			{
+				pieceOffset += pieces[i].vertices.size();
+			}
+
+			for (UINT64 i = start; i < end && pieceOffset < count; i++)
+			{
+				UINT64 copyCount = min((UINT64)pieces[i].vertices.size(), count - pieceOffset);
+				std::copy(pieces[i].vertices.begin(), pieces[i].vertices.begin() + copyCount, vertices.begin() + pieceOffset);
+				pieceOffset += copyCount;
+			}
+		});
+
+		position = blockEnd;
+		verticesRead += count;
+
+		if (count > 0)
+		{
+			return count;
+		}
+	}
+
+	if (ply && verticesRead < vertexCount)
+	{
+		throw std::exception("The .ply file is truncated");
+	}
+
+	vertexCount = verticesRead;
+
+	return 0;
+}
+
+const BYTE* TextReader::GetRecord(UINT64 index) const
+{
+	return (const BYTE*)(vertices.data() + index);
+}
+
+void TextReader::ReadVertex(const BYTE* record, PlyVertex& outVertex) const
+{
+	outVertex = *(const PlyVertex*)record;
+}
+
+bool TextReader::IsTextFile(const std::string& filename)
+{
+	std::string filetype = filename.substr(filename.find_last_of(".") + 1, filename.length());
+
+	return filetype.compare("xyz") == 0 || filetype.compare("XYZ") == 0 || filetype.compare("pts") == 0 || filetype.compare("PTS") == 0;
+}
+
+void TextReader::ReadPlyColumns(const std::string& filename)
+{
+	PlyReader plyReader(filename);
+	const std::vector<PlyReader::Element>& elements = plyReader.GetElements();
+	int vertexElement = plyReader.GetVertexElementIndex();
+
+	if (!plyReader.IsAscii())
+	{
+		throw std::exception("The .ply file is not in ascii format");
+	}
+	else if (vertexElement < 0 || elements[vertexElement].hasList)
+	{
+		throw std::exception("The .ply file has no vertex element or the vertex element has lists");
+	}
+
+	// Each element is written in its own line, also the elements with lists
+	position = plyReader.GetHeaderSize();
+
+	for (int i = 0; i < vertexElement; i++)
+	{
+		for (UINT64 j = 0; j < elements[i].count && position < file.GetSize(); j++)
+		{
+			position = FindNextLine(position);
+		}
+	}
+
+	const char* names[] = { "x", "y", "z", "nx", "ny", "nz", "red", "green", "blue" };
+	int* targets[] = { &columns.position[0], &columns.position[1], &columns.position[2], &columns.normal[0], &columns.normal[1], &columns.normal[2], &columns.color[0], &columns.color[1], &columns.color[2] };
+	const std::vector<PlyReader::Property>& properties = elements[vertexElement].properties;
+
+	for (int i = 0; i < (int)properties.size(); i++)
+	{
+		for (int j = 0; j < 9; j++)
+		{
+			if (properties[i].name.compare(names[j]) == 0)
+			{
+				*targets[j] = i;
+				columns.count = max(columns.count, (UINT)i + 1);
+
+				if (j >= 6)
+				{
+					columns.colorScale = PlyReader::GetColorScale(properties[i].type);
+				}
+			}
+		}
+	}
+
+	if (columns.position[0] < 0 || columns.position[1] < 0 || columns.position[2] < 0)
+	{
+		throw std::exception("The .ply file does not have the x,y,z vertex properties");
+	}
+
+	// Colors are only used if all three exist
+	if (columns.color[0] < 0 || columns.color[1] < 0 || columns.color[2] < 0)
+	{
+		columns.color[0] = columns.color[1] = columns.color[2] = -1;
+	}
+
+	vertexCount = elements[vertexElement].count;
+}
+
+void TextReader::DetectColumns(bool pts)
+{
+	const UINT maxValues = 16;
+	float values[maxValues];
+	UINT integerMask = 0;
+	UINT count = 0;
+
+	for (UINT64 offset = 0; offset < file.GetSize() && count < 3; offset = FindNextLine(offset))
+	{
+		count = ParseLine(GetText(offset), GetText(FindNextLine(offset)), values, maxValues, &integerMask);
+	}
+
+	columns.position[0] = 0;
+	columns.position[1] = 1;
+	columns.position[2] = 2;
+	columns.count = 3;
+
+	// Integer values after the position are colors, otherwise they are normals
+	bool integerColors = ((integerMask >> 3) & 7) == 7;
+
+	if (pts)
+	{
+		// The .pts columns are x y z intensity r g b, some files leave out the intensity or the colors
+		if (count >= 7)
+		{
+			columns.intensity = 3;
+			columns.color[0] = 4;
+			columns.color[1] = 5;
+			columns.color[2] = 6;
+			columns.count = 7;
+		}
+		else if (count == 6)
+		{
+			columns.color[0] = 3;
+			columns.color[1] = 4;
+			columns.color[2] = 5;
+			columns.count = 6;
+		}
+		else if (count >= 4)
+		{
+			columns.intensity = 3;
+			columns.count = 4;
+		}
+	}
+	else if (count >= 9)
+	{
+		int colorColumn = integerColors ? 3 : 6;
+		int normalColumn = integerColors ? 6 : 3;
+
+		for (int i = 0; i < 3; i++)
+		{
+			columns.color[i] = colorColumn + i;
+			columns.normal[i] = normalColumn + i;
+		}
+
+		columns.count = 9;
+	}
+	else if (count >= 6)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			(integerColors ? columns.color : columns.normal)[i] = 3 + i;
+		}
+
+		columns.count = 6;
+	}
+}
+
+void TextReader::ParsePiece(Piece& piece) const
+{
+	piece.vertices.clear();
+	piece.values.resize(columns.count);
+	piece.firstInvalid = ~0ULL;
+
+	for (const char* line = piece.begin; line < piece.end;)
+	{
+		const char* lineEnd = (const char*)memchr(line, '\n', piece.end - line);
+		lineEnd = (lineEnd != NULL) ? lineEnd : piece.end;
+
+		PlyVertex vertex = {};
+
+		if (ParseLine(line, lineEnd, piece.values.data(), columns.count) == columns.count)
+		{
+			ConvertValues(piece.values.data(), vertex);
+			piece.vertices.push_back(vertex);
+		}
+		else if (ply && !IsBlank(line, lineEnd))
+		{
+			// The vertex count of the header decides later if this line is a vertex or belongs to the next element
+			piece.firstInvalid = min(piece.firstInvalid, (UINT64)piece.vertices.size());
+			piece.vertices.push_back(vertex);
+		}
+
+		line = lineEnd + 1;
+	}
+}
+
+void TextReader::ConvertValues(const float* values, PlyVertex& outVertex) const
+{
+	outVertex.position = Vector3(values[columns.position[0]], values[columns.position[1]], values[columns.position[2]]);
+	outVertex.normal = HasNormals() ? Vector3(values[columns.normal[0]], values[columns.normal[1]], values[columns.normal[2]]) : Vector3::Zero;
+
+	for (int i = 0; i < 3; i++)
+	{
+		float color = 255.0f;
+
+		if (columns.color[i] >= 0)
+		{
+			color = values[columns.color[i]] * columns.colorScale;
+		}
+		else if (columns.intensity >= 0)
+		{
+			// The intensity of .pts files is in the range [-2048, 2047]
+			color = (values[columns.intensity] + 2048.0f) / 16.0f;
+		}
+
+		outVertex.color[i] = (unsigned char)max(0.0f, min(color, 255.0f));
+	}
+}
+
+const char* TextReader::GetText(UINT64 offset) const
+{
+	return (const char*)file.GetData() + offset;
+}
+
+UINT64 TextReader::FindNextLine(UINT64 offset) const
+{
+	if (offset >= file.GetSize())
+	{
+		return file.GetSize();
+	}
+
+	const char* lineEnd = (const char*)memchr(GetText(offset), '\n', file.GetSize() - offset);
+
+	return (lineEnd != NULL) ? (lineEnd - GetText(0)) + 1 : file.GetSize();
+}
+
+UINT TextReader::ParseLine(const char* begin, const char* end, float* outValues, UINT maxValues, UINT* outIntegerMask)
+{
+	auto isSeparator = [](char c) { return c == ' ' || c == '\t' || c == ',' || c == ';' || c == '\r' || c == '\n'; };
+	const char* text = begin;
+	UINT count = 0;
+
+	if (outIntegerMask != NULL)
+	{
+		*outIntegerMask = 0;
+	}
+
+	while (count < maxValues)
+	{
+		while (text < end && isSeparator(*text))
+		{
+			text++;
+		}
+
+		// The parser does not accept a plus sign, it is skipped unless it is the whole token
+		const char* token = (text + 1 < end && *text == '+') ? text + 1 : text;
+		std::from_chars_result result = std::from_chars(token, end, outValues[count]);
+
+		if (result.ec != std::errc() || (result.ptr < end && !isSeparator(*result.ptr)))
+		{
+			break;
+		}
+
+		if (outIntegerMask != NULL && std::find_if(token, result.ptr, [](char c) { return c == '.' || c == 'e' || c == 'E'; }) == result.ptr)
+		{
+			*outIntegerMask |= 1U << count;
+		}
+
+		text = result.ptr;
+		count++;
+	}
+
+	return count;
+}
+
+bool TextReader::IsBlank(const char* begin, const char* end)
+{
+	return std::all_of(begin, end, [](char c) { return c == ' ' || c == '\t' || c == '\r'; });
+}
@@ -0,0 +1,91 @@
+#ifndef TEXTREADER_H
+#define TEXTREADER_H
+
+#pragma once
+#include <string>
+#include <vector>
+#include "PlyReader.h"
+#include "../PointCloudEngine/MappedFile.h"
+#include "../PointCloudEngine/ThreadPool.h"
+
+using namespace PointCloudEngine;
+
+// Reads the vertices of ascii .ply files and of .xyz and .pts text files in blocks of lines
+// The file is mapped into memory, each block is split at line boundaries into pieces that are parsed in parallel
+// The vertices of the pieces are then copied to their position in the block, therefore the order of the file is kept
+// Columns of .xyz and .pts files are detected from the number of values in the first line with at least three values
+// Lines with fewer values (comments, the point count of .pts files) are skipped, missing colors are white
+class TextReader
+{
+public:
+	TextReader(const std::string& filename);
+
+	bool HasNormals() const;
+
+	// The number of vertices of .xyz and .pts files is only known after reading them, it is zero until then
+	UINT64 GetVertexCount() const;
+
+	// Average number of bytes per line at the start of the data, used to choose the size of the blocks
+	UINT GetVertexSize() const;
+
+	// Parses the lines of about maxCount vertices into the internal buffer and returns how many vertices were read, zero at the end of the file
+	UINT64 ReadRecords(UINT64 maxCount);
+	const BYTE* GetRecord(UINT64 index) const;
+
+	// Copies one of the vertices that were read, can be called from multiple threads
+	void ReadVertex(const BYTE* record, PlyVertex& outVertex) const;
+
+	static bool IsTextFile(const std::string& filename);
+
+private:
+	// Column of each value in a line, -1 if the value does not exist
+	struct Columns
+	{
+		int position[3] = { -1, -1, -1 };
+		int normal[3] = { -1, -1, -1 };
+		int color[3] = { -1, -1, -1 };
+		int intensity = -1;
+		float colorScale = 1.0f;
+
+		// Lines with fewer values are skipped, or are an error in .ply files
+		UINT count = 0;
+	};
+
+	struct Piece
+	{
+		const char* begin;
+		const char* end;
+		std::vector<PlyVertex> vertices;
+		std::vector<float> values;
+
+		// Index of the first line in the piece that could not be parsed, only used for .ply files
+		UINT64 firstInvalid;
+	};
+
+	MappedFile file;
+	Columns columns;
+	bool ply = false;
+	UINT lineSize = 0;
+	UINT64 position = 0;
+	UINT64 vertexCount = 0;
+	UINT64 verticesRead = 0;
+	std::vector<Piece> pieces;
+	std::vector<PlyVertex> vertices;
+
+	void ReadPlyColumns(const std::string& filename);
+	void DetectColumns(bool pts);
+	void ParsePiece(Piece& piece) const;
+	void ConvertValues(const float* values, PlyVertex& outVertex) const;
+
+	const char* GetText(UINT64 offset) const;
+
+	// Offset of the first byte after the end of the line, or the file size
+	UINT64 FindNextLine(UINT64 offset) const;
+
+	// Parses up to maxValues numbers separated by spaces, tabs, commas or semicolons, stops at the first token that is not a number
+	// The bits of the integer mask are set for the tokens without a fraction or exponent
+	static UINT ParseLine(const char* begin, const char* end, float* outValues, UINT maxValues, UINT* outIntegerMask = NULL);
+	static bool IsBlank(const char* begin, const char* end);
+};
+
+#endif
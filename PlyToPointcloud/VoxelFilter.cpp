@@ -0,0 +1,364 @@
+#include "VoxelFilter.h"
+#include <fstream>
+#include <cmath>
+
+UINT64 VoxelFilter::GetRequiredMemory(UINT64 count)
+{
+	// Keys and indices with their radix sort scratch buffers, the first vertex of each voxel, the partition and the merged vertices
+	return count * (3 * sizeof(UINT64) + 2 * sizeof(PointcloudIndex) + 2 * sizeof(PointcloudVertex));
+}
+
+VoxelFilter::VoxelFilter(float voxelSize, UINT64 memoryBudget) : voxelSize(voxelSize), memoryBudget(memoryBudget)
+{
+}
+
+UINT64 VoxelFilter::Filter(PointcloudVertex* vertices, UINT64 count, const Vector3& boundingCubePosition, float boundingCubeSize, const std::string& temporaryFilename)
+{
+	binPartitions.clear();
+	partitionCount = 0;
+
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	// The last voxel also contains the positions on the far side of the bounding cube
+	double voxels = std::floor(boundingCubeSize / (double)voxelSize) + 1;
+
+	if (!(voxelSize > 0) || voxels > (double)(1U << maxBits))
+	{
+		throw std::exception("The voxel size is too small for the bounding cube");
+	}
+
+	cubeMin = boundingCubePosition - 0.5f * Vector3(boundingCubeSize, boundingCubeSize, boundingCubeSize);
+	voxelsPerAxis = (UINT)voxels;
+	keyBits = 3;
+
+	while ((1ULL << (keyBits / 3)) < voxelsPerAxis)
+	{
+		keyBits += 3;
+	}
+
+	binShift = keyBits - min(keyBits, binBits);
+	CreatePartitions(vertices, count);
+
+	if (partitionCount > 1)
+	{
+		return FilterExternal(vertices, count, temporaryFilename);
+	}
+
+	std::vector<PointcloudVertex> merged;
+	MergeVoxels(vertices, count, merged);
+
+	ThreadPool::Get().ParallelFor(merged.size(), blockSize, [&](UINT64 start, UINT64 end)
+	{
+		memcpy(vertices + start, merged.data() + start, (end - start) * sizeof(PointcloudVertex));
+	});
+
+	return merged.size();
+}
+
+UINT64 VoxelFilter::GetPartitionCount() const
+{
+	return partitionCount;
+}
+
+UINT64 VoxelFilter::GetKey(const PointcloudVertex& vertex) const
+{
+	Vector3 voxel = (vertex.position - cubeMin) / voxelSize;
+	float maxVoxel = (float)(voxelsPerAxis - 1);
+
+	UINT x = (UINT)min(max(voxel.x, 0.0f), maxVoxel);
+	UINT y = (UINT)min(max(voxel.y, 0.0f), maxVoxel);
+	UINT z = (UINT)min(max(voxel.z, 0.0f), maxVoxel);
+
+	return Morton::Encode(x, y, z);
+}
+
+UINT VoxelFilter::GetPartition(UINT64 key) const
+{
+	return binPartitions[key >> binShift];
+}
+
+void VoxelFilter::CreatePartitions(const PointcloudVertex* vertices, UINT64 count)
+{
+	// Each thread counts a range of the vertices into its own histogram of the morton bins
+	UINT64 binCount = 1ULL << (keyBits - binShift);
+	UINT64 threadCount = ThreadPool::Get().GetThreadCount();
+	UINT64 rangeSize = max(blockSize, (count + threadCount - 1) / threadCount);
+	UINT64 rangeCount = (count + rangeSize - 1) / rangeSize;
+	std::vector<std::vector<UINT64>> rangeBinCounts(rangeCount);
+
+	ThreadPool::Get().ParallelFor(rangeCount, 1, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 range = start; range < end; range++)
+		{
+			std::vector<UINT64>& binCounts = rangeBinCounts[range];
+			binCounts.assign(binCount, 0);
+
+			for (UINT64 i = range * rangeSize; i < min(count, (range + 1) * rangeSize); i++)
+			{
+				binCounts[GetKey(vertices[i]) >> binShift]++;
+			}
+		}
+	});
+
+	// Consecutive bins are grouped into a partition until it does not fit into the memory budget anymore
+	UINT64 budgetVertices = max(1ULL, memoryBudget / GetRequiredMemory(1));
+	UINT64 partitionVertices = 0;
+	binPartitions.resize(binCount);
+	partitionCount = 1;
+
+	for (UINT64 bin = 0; bin < binCount; bin++)
+	{
+		UINT64 binVertices = 0;
+
+		for (UINT64 range = 0; range < rangeCount; range++)
+		{
+			binVertices += rangeBinCounts[range][bin];
+		}
+
+		if (partitionVertices > 0 && partitionVertices + binVertices > budgetVertices)
+		{
+			partitionCount++;
+			partitionVertices = 0;
+		}
+
+		binPartitions[bin] = (UINT)(partitionCount - 1);
+		partitionVertices += binVertices;
+	}
+}
+
+UINT64 VoxelFilter::FilterExternal(PointcloudVertex* vertices, UINT64 count, const std::string& temporaryFilename)
+{
+	// Count the vertices of each block in each partition, the partitions occupy consecutive regions of the temporary file
+	UINT64 blockCount = (count + blockSize - 1) / blockSize;
+	std::vector<UINT64> blockPartitionCounts(blockCount * partitionCount, 0);
+	std::vector<UINT64> partitionStarts(partitionCount + 1);
+	std::vector<UINT64> partitionWriteOffsets(partitionCount);
+
+	ThreadPool::Get().ParallelFor(blockCount, 1, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 block = start; block < end; block++)
+		{
+			UINT64* counts = blockPartitionCounts.data() + block * partitionCount;
+
+			for (UINT64 i = block * blockSize; i < min(count, (block + 1) * blockSize); i++)
+			{
+				counts[GetPartition(GetKey(vertices[i]))]++;
+			}
+		}
+	});
+
+	UINT64 offset = 0;
+
+	for (UINT64 partition = 0; partition < partitionCount; partition++)
+	{
+		partitionStarts[partition] = offset;
+		partitionWriteOffsets[partition] = offset;
+
+		for (UINT64 block = 0; block < blockCount; block++)
+		{
+			offset += blockPartitionCounts[block * partitionCount + partition];
+		}
+	}
+
+	partitionStarts[partitionCount] = offset;
+
+	std::string partitionFilename = temporaryFilename + ".voxels";
+	std::fstream partitionFile(partitionFilename, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+
+	if (!partitionFile.is_open())
+	{
+		throw std::exception("Could not create the temporary partition file");
+	}
+
+	// Scatter a batch of blocks in parallel into local partition order, then append each partition slice to its region in the file
+	UINT64 batchSize = ThreadPool::Get().GetThreadCount();
+	std::vector<PointcloudVertex> staging(batchSize * blockSize);
+	std::vector<UINT64> localOffsets(batchSize * partitionCount);
+
+	for (UINT64 batchStart = 0; batchStart < blockCount; batchStart += batchSize)
+	{
+		UINT64 batchEnd = min(batchStart + batchSize, blockCount);
+
+		ThreadPool::Get().ParallelFor(batchEnd - batchStart, 1, [&](UINT64 start, UINT64 end)
+		{
+			for (UINT64 i = start; i < end; i++)
+			{
+				UINT64 block = batchStart + i;
+				UINT64* offsets = localOffsets.data() + i * partitionCount;
+				UINT64 localOffset = i * blockSize;
+
+				for (UINT64 partition = 0; partition < partitionCount; partition++)
+				{
+					offsets[partition] = localOffset;
+					localOffset += blockPartitionCounts[block * partitionCount + partition];
+				}
+
+				for (UINT64 j = block * blockSize; j < min(count, (block + 1) * blockSize); j++)
+				{
+					staging[offsets[GetPartition(GetKey(vertices[j]))]++] = vertices[j];
+				}
+			}
+		});
+
+		// After the scatter the local offsets point to the end of each partition slice
+		for (UINT64 block = batchStart; block < batchEnd; block++)
+		{
+			for (UINT64 partition = 0; partition < partitionCount; partition++)
+			{
+				UINT64 sliceCount = blockPartitionCounts[block * partitionCount + partition];
+
+				if (sliceCount > 0)
+				{
+					UINT64 sliceStart = localOffsets[(block - batchStart) * partitionCount + partition] - sliceCount;
+
+					partitionFile.seekp(partitionWriteOffsets[partition] * sizeof(PointcloudVertex));
+					partitionFile.write((char*)(staging.data() + sliceStart), sliceCount * sizeof(PointcloudVertex));
+					partitionWriteOffsets[partition] += sliceCount;
+				}
+			}
+		}
+	}
+
+	staging = std::vector<PointcloudVertex>();
+
+	// All the vertices are in the temporary file now, the merged vertices of each partition are appended to the front of the array
+	std::vector<PointcloudVertex> partitionVertices;
+	std::vector<PointcloudVertex> merged;
+	UINT64 mergedCount = 0;
+
+	for (UINT64 partition = 0; partition < partitionCount; partition++)
+	{
+		UINT64 partitionSize = partitionStarts[partition + 1] - partitionStarts[partition];
+		partitionVertices.resize(partitionSize);
+
+		partitionFile.seekg(partitionStarts[partition] * sizeof(PointcloudVertex));
+		partitionFile.read((char*)partitionVertices.data(), partitionSize * sizeof(PointcloudVertex));
+
+		if ((UINT64)partitionFile.gcount() != partitionSize * sizeof(PointcloudVertex))
+		{
+			throw std::exception("Could not read the temporary partition file");
+		}
+
+		MergeVoxels(partitionVertices.data(), partitionSize, merged);
+		memcpy(vertices + mergedCount, merged.data(), merged.size() * sizeof(PointcloudVertex));
+		mergedCount += merged.size();
+	}
+
+	partitionFile.close();
+	DeleteFileA(partitionFilename.c_str());
+
+	return mergedCount;
+}
+
+void VoxelFilter::MergeVoxels(const PointcloudVertex* vertices, UINT64 count, std::vector<PointcloudVertex>& outVertices) const
+{
+	std::vector<UINT64> keys(count);
+	std::vector<PointcloudIndex> indices(count);
+
+	ThreadPool::Get().ParallelFor(count, 64 * 1024, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 i = start; i < end; i++)
+		{
+			keys[i] = GetKey(vertices[i]);
+			indices[i] = (PointcloudIndex)i;
+		}
+	});
+
+	// The sort is stable, therefore the vertices of a voxel are merged in their original order and the result does not depend on the threads
+	RadixSort(keys, indices, keyBits);
+
+	// Find the first vertex of each voxel with a parallel count and prefix sum over blocks
+	UINT64 blockCount = (count + blockSize - 1) / blockSize;
+	std::vector<UINT64> blockVoxelOffsets(blockCount + 1, 0);
+
+	ThreadPool::Get().ParallelFor(blockCount, 1, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 block = start; block < end; block++)
+		{
+			for (UINT64 i = block * blockSize; i < min(count, (block + 1) * blockSize); i++)
+			{
+				blockVoxelOffsets[block + 1] += (i == 0 || keys[i] != keys[i - 1]) ? 1 : 0;
+			}
+		}
+	});
+
+	for (UINT64 block = 0; block < blockCount; block++)
+	{
+		blockVoxelOffsets[block + 1] += blockVoxelOffsets[block];
+	}
+
+	UINT64 voxelCount = blockVoxelOffsets[blockCount];
+	std::vector<UINT64> voxelStarts(voxelCount + 1);
+	voxelStarts[voxelCount] = count;
+
+	ThreadPool::Get().ParallelFor(blockCount, 1, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 block = start; block < end; block++)
+		{
+			UINT64 voxel = blockVoxelOffsets[block];
+
+			for (UINT64 i = block * blockSize; i < min(count, (block + 1) * blockSize); i++)
+			{
+				if (i == 0 || keys[i] != keys[i - 1])
+				{
+					voxelStarts[voxel++] = i;
+				}
+			}
+		}
+	});
+
+	outVertices.resize(voxelCount);
+
+	ThreadPool::Get().ParallelFor(voxelCount, 4096, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 voxel = start; voxel < end; voxel++)
+		{
+			UINT64 voxelStart = voxelStarts[voxel];
+			UINT64 voxelEnd = voxelStarts[voxel + 1];
+			PointcloudVertex& output = outVertices[voxel];
+
+			// Voxels with a single vertex keep it unchanged, this also keeps the zeroed padding bytes
+			output = vertices[indices[voxelStart]];
+
+			if (voxelEnd - voxelStart < 2)
+			{
+				continue;
+			}
+
+			double position[3] = { 0, 0, 0 };
+			Vector3 normal = Vector3::Zero;
+			UINT64 color[3] = { 0, 0, 0 };
+			UINT64 n = voxelEnd - voxelStart;
+
+			for (UINT64 i = voxelStart; i < voxelEnd; i++)
+			{
+				const PointcloudVertex& vertex = vertices[indices[i]];
+				position[0] += vertex.position.x;
+				position[1] += vertex.position.y;
+				position[2] += vertex.position.z;
+				normal += Vector3(vertex.normal[0], vertex.normal[1], vertex.normal[2]);
+				color[0] += vertex.color[0];
+				color[1] += vertex.color[1];
+				color[2] += vertex.color[2];
+			}
+
+			output.position = Vector3((float)(position[0] / n), (float)(position[1] / n), (float)(position[2] / n));
+
+			// Opposing normals cancel out, the normal of the first vertex is kept in that case
+			if (normal.LengthSquared() > 0)
+			{
+				normal.Normalize();
+				output.normal[0] = 127 * normal.x;
+				output.normal[1] = 127 * normal.y;
+				output.normal[2] = 127 * normal.z;
+			}
+
+			output.color[0] = (unsigned char)((color[0] + n / 2) / n);
+			output.color[1] = (unsigned char)((color[1] + n / 2) / n);
+			output.color[2] = (unsigned char)((color[2] + n / 2) / n);
+		}
+	});
+}
@@ -0,0 +1,58 @@
+#ifndef VOXELFILTER_H
+#define VOXELFILTER_H
+
+#pragma once
+#include <string>
+#include <vector>
+#include "../PointCloudEngine/PointcloudFile.h"
+#include "../PointCloudEngine/Morton.h"
+#include "../PointCloudEngine/RadixSort.h"
+
+using namespace PointCloudEngine;
+
+// Merges the vertices that fall into the same voxel of a uniform grid inside the bounding cube into one vertex
+// The representative has the mean position, the normalized mean normal and the mean color of the merged vertices
+// The voxels are sorted by their morton code, the high bits of the code split the point cloud into partitions that fit into the memory budget
+// Partitions never share a voxel, if there is more than one they are written to a temporary file and merged one after the other
+class VoxelFilter
+{
+public:
+	// Voxel grids with more than 2^21 voxels per axis do not fit into a 64 bit morton code
+	static const UINT maxBits = Morton::maxBits;
+
+	// Memory per vertex for the keys, the sort, the partition copy and the merged vertices
+	static UINT64 GetRequiredMemory(UINT64 count);
+
+	VoxelFilter(float voxelSize, UINT64 memoryBudget);
+
+	// Stores the merged vertices in morton order at the front of the array and returns their count
+	// The temporary partition file is created next to the given filename
+	UINT64 Filter(PointcloudVertex* vertices, UINT64 count, const Vector3& boundingCubePosition, float boundingCubeSize, const std::string& temporaryFilename);
+
+	// Number of partitions of the last filter, one if the vertices fit into the memory budget
+	UINT64 GetPartitionCount() const;
+
+private:
+	// The partitions are formed from consecutive ranges of 2^18 morton bins
+	const UINT binBits = 18;
+	const UINT64 blockSize = 1024 * 1024;
+
+	float voxelSize;
+	UINT64 memoryBudget;
+	Vector3 cubeMin;
+	UINT voxelsPerAxis = 0;
+	UINT keyBits = 0;
+	UINT binShift = 0;
+
+	// Partition of each morton bin
+	std::vector<UINT> binPartitions;
+	UINT64 partitionCount = 0;
+
+	UINT64 GetKey(const PointcloudVertex& vertex) const;
+	UINT GetPartition(UINT64 key) const;
+	void CreatePartitions(const PointcloudVertex* vertices, UINT64 count);
+	UINT64 FilterExternal(PointcloudVertex* vertices, UINT64 count, const std::string& temporaryFilename);
+	void MergeVoxels(const PointcloudVertex* vertices, UINT64 count, std::vector<PointcloudVertex>& outVertices) const;
+};
+
+#endif
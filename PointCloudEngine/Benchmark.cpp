@@ -0,0 +1,795 @@
+#include "Benchmark.h"
+
+std::wstringstream Benchmark::results;
+
+void Benchmark::Run(const std::wstring& pointcloudFile)
+{
+	// The engine is a windows application, print to the console that started it
+	FILE* fileStdout = NULL;
+
+	if (AttachConsole(ATTACH_PARENT_PROCESS))
+	{
+		freopen_s(&fileStdout, "CONOUT$", "w", stdout);
+	}
+
+	results << std::fixed << std::setprecision(3);
+	results << L"Benchmark of " << pointcloudFile << std::endl;
+	results << L"Hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+	results << L"SSE4.1: " << (SIMD::SupportsSSE41() ? L"yes" : L"no") << L", AVX2: " << (SIMD::SupportsAVX2() ? L"yes" : L"no") << std::endl << std::endl;
+
+	BenchmarkPointcloudLoading(pointcloudFile);
+	BenchmarkVertexDecoding(pointcloudFile);
+	BenchmarkPrefixCoverage(pointcloudFile);
+	BenchmarkNormalClustering(pointcloudFile);
+	BenchmarkOctreeConstruction(pointcloudFile);
+	BenchmarkOutOfCoreConstruction(pointcloudFile);
+
+	std::wcout << results.str();
+
+	// Save the results next to the executable
+	CreateDirectory((executableDirectory + L"/Benchmarks").c_str(), NULL);
+	std::wofstream resultsFile(executableDirectory + L"/Benchmarks/" + std::to_wstring(time(0)) + L".txt");
+	resultsFile << results.str();
+	resultsFile.flush();
+	resultsFile.close();
+
+	if (fileStdout != NULL)
+	{
+		fclose(fileStdout);
+		FreeConsole();
+	}
+}
+
+void Benchmark::BenchmarkPointcloudLoading(const std::wstring& pointcloudFile)
+{
+	const int runs = 3;
+
+	PointcloudFile pointcloud;
+
+	if (!pointcloud.Open(pointcloudFile))
+	{
+		results << L"Could not open " << pointcloudFile << std::endl;
+		return;
+	}
+
+	double points = pointcloud.vertexCount;
+	double bytes = points * pointcloud.recordSize;
+	double storedBytes = 0;
+	bool floatPositions = (pointcloud.encoding == PointcloudEncoding::Float);
+	bool compressed = (pointcloud.flags & pointcloudFlagCompressed) != 0;
+
+	for (auto it = pointcloud.chunks.begin(); it != pointcloud.chunks.end(); it++)
+	{
+		storedBytes += it->size;
+	}
+
+	pointcloud.Close();
+
+	results << L"Pointcloud loading of " << points << L" points (" << runs << L" runs, the first run can include reading from the disk)" << std::endl;
+
+	if (compressed)
+	{
+		results << L"	Compressed chunks with " << storedBytes / (1024 * 1024) << L" MB, compression ratio " << bytes / max(1.0, storedBytes) << L", the throughput is measured for the decompressed records" << std::endl;
+	}
+
+	std::vector<double> streamSeconds, mappedSeconds, startupSeconds;
+
+	// The previous loader only supports uncompressed float positions
+	for (int run = 0; floatPositions && !compressed && run < runs; run++)
+	{
+		std::vector<Vertex> vertices;
+		Vector3 boundingCubePosition;
+		float boundingCubeSize;
+
+		streamSeconds.push_back(MeasureSeconds([&]() { LoadPointcloudFileStream(vertices, boundingCubePosition, boundingCubeSize, pointcloudFile); }));
+	}
+
+	for (int run = 0; run < runs; run++)
+	{
+		std::vector<Vertex> vertices;
+		Vector3 boundingCubePosition;
+		float boundingCubeSize;
+
+		mappedSeconds.push_back(MeasureSeconds([&]() { LoadPointcloudFile(vertices, boundingCubePosition, boundingCubeSize, pointcloudFile); }));
+	}
+
+	for (int run = 0; run < runs; run++)
+	{
+		// Time until the first vertex is available with the lazily decoded view
+		startupSeconds.push_back(MeasureSeconds([&]()
+		{
+			PointcloudFile startupPointcloud;
+
+			if (startupPointcloud.Open(pointcloudFile) && startupPointcloud.vertexCount > 0)
+			{
+				volatile float x = startupPointcloud.GetVertex(0).position.x;
+			}
+		}));
+	}
+
+	if (floatPositions && !compressed)
+	{
+		WriteResult(L"ifstream into temporary array (previous loader)", streamSeconds, bytes, points);
+	}
+
+	WriteResult(L"Memory mapped, decoded into vertex array", mappedSeconds, bytes, points);
+	WriteResult(L"Memory mapped, first vertex available", startupSeconds, 0, 0);
+
+	results << L"\tPeak heap memory for the vertices: previous loader " << (points * (sizeof(PointcloudVertex) + sizeof(Vertex))) / (1024 * 1024) << L" MB";
+	results << L", memory mapped " << (points * sizeof(Vertex)) / (1024 * 1024) << L" MB" << std::endl << std::endl;
+}
+
+void Benchmark::BenchmarkVertexDecoding(const std::wstring& pointcloudFile)
+{
+	const int runs = 5;
+
+	PointcloudFile pointcloud;
+
+	if (!pointcloud.Open(pointcloudFile))
+	{
+		results << L"Could not open " << pointcloudFile << std::endl;
+		return;
+	}
+
+	// The single threaded kernels decode the whole vertex array with one call, their count is 32 bit
+	UINT count = (UINT)min(pointcloud.vertexCount, (UINT64)UINT_MAX);
+	double points = count;
+	UINT threadCount = ThreadPool::Get().GetThreadCount();
+	double bytes = points * pointcloud.recordSize;
+	const BYTE* input = pointcloud.GetRecords();
+	std::vector<Vertex> output(count);
+
+	// Touch all the pages once so that the measurements do not include reading the file from the disk
+	pointcloud.DecodeVertices(0, count, output.data());
+
+	results << L"Vertex decoding of " << points << L" points with " << pointcloud.recordSize << L" byte records (" << runs << L" runs, single threaded kernels and the parallel decoder)" << std::endl;
+
+	auto measureKernel = [&](const std::wstring& name, const std::function<void()>& kernel)
+	{
+		std::vector<double> seconds;
+
+		for (int run = 0; run < runs; run++)
+		{
+			seconds.push_back(MeasureSeconds(kernel));
+		}
+
+		WriteResult(name + L", 1 thread", seconds, bytes, points);
+	};
+
+	Vector3 positionMin = pointcloud.boundingCubePosition - 0.5f * Vector3(pointcloud.boundingCubeSize, pointcloud.boundingCubeSize, pointcloud.boundingCubeSize);
+	float positionStep = PointcloudFile::GetPositionStep(pointcloud.encoding, pointcloud.boundingCubeSize);
+	const PointcloudVertexFixed16* inputFixed16 = (const PointcloudVertexFixed16*)input;
+	const PointcloudVertexFixed21* inputFixed21 = (const PointcloudVertexFixed21*)input;
+
+	if (pointcloud.encoding == PointcloudEncoding::Fixed16)
+	{
+		measureKernel(L"Fixed16 scalar", [&]() { PointcloudFile::DecodeFixed16Scalar(inputFixed16, count, positionMin, positionStep, output.data()); });
+
+		if (SIMD::SupportsSSE41())
+		{
+			measureKernel(L"Fixed16 SSE4.1", [&]() { PointcloudFile::DecodeFixed16SSE41(inputFixed16, count, positionMin, positionStep, output.data()); });
+		}
+	}
+	else if (pointcloud.encoding == PointcloudEncoding::Fixed21)
+	{
+		measureKernel(L"Fixed21 scalar", [&]() { PointcloudFile::DecodeFixed21Scalar(inputFixed21, count, positionMin, positionStep, output.data()); });
+
+		if (SIMD::SupportsSSE41())
+		{
+			measureKernel(L"Fixed21 SSE4.1", [&]() { PointcloudFile::DecodeFixed21SSE41(inputFixed21, count, positionMin, positionStep, output.data()); });
+		}
+	}
+	else
+	{
+		const PointcloudVertex* inputFloat = (const PointcloudVertex*)input;
+
+		measureKernel(L"Scalar", [&]() { PointcloudFile::DecodeVerticesScalar(inputFloat, count, output.data()); });
+
+		if (SIMD::SupportsSSE41())
+		{
+			measureKernel(L"SSE4.1", [&]() { PointcloudFile::DecodeVerticesSSE41(inputFloat, count, output.data()); });
+		}
+
+		if (SIMD::SupportsAVX2())
+		{
+			measureKernel(L"AVX2", [&]() { PointcloudFile::DecodeVerticesAVX2(inputFloat, count, output.data()); });
+		}
+	}
+
+	std::vector<double> parallelSeconds, copySeconds;
+
+	for (int run = 0; run < runs; run++)
+	{
+		parallelSeconds.push_back(MeasureSeconds([&]() { pointcloud.DecodeVertices(0, count, output.data()); }));
+	}
+
+	// Copying the input records into the output array gives an upper bound that is only limited by the memory bandwidth
+	for (int run = 0; run < runs; run++)
+	{
+		copySeconds.push_back(MeasureSeconds([&]()
+		{
+			ThreadPool::Get().ParallelFor(count, 64 * 1024, [&](UINT64 start, UINT64 end)
+			{
+				memcpy(output.data() + start, input + start * pointcloud.recordSize, (end - start) * pointcloud.recordSize);
+			});
+		}));
+	}
+
+	double parallelBest = *std::min_element(parallelSeconds.begin(), parallelSeconds.end());
+
+	WriteResult(L"Best kernel, " + std::to_wstring(threadCount) + L" threads", parallelSeconds, bytes, points);
+	results << L"\t\t(" << (points / 1000000) / parallelBest / threadCount << L" M points/s per core)" << std::endl;
+	WriteResult(L"Parallel memcpy of the records (memory bandwidth reference)", copySeconds, bytes, 0);
+	results << std::endl;
+}
+
+void Benchmark::BenchmarkPrefixCoverage(const std::wstring& pointcloudFile)
+{
+	const UINT levelCount = 16;
+	const double fractions[] = { 0.01, 0.02, 0.05, 0.1, 0.25, 0.5 };
+
+	PointcloudFile pointcloud;
+
+	if (!pointcloud.Open(pointcloudFile))
+	{
+		results << L"Could not open " << pointcloudFile << std::endl;
+		return;
+	}
+
+	UINT64 count = pointcloud.vertexCount;
+	Vector3 cubeMin = pointcloud.boundingCubePosition - 0.5f * Vector3(pointcloud.boundingCubeSize, pointcloud.boundingCubeSize, pointcloud.boundingCubeSize);
+	std::vector<UINT64> keys(count), sortedKeys, values(count, 0);
+
+	ThreadPool::Get().ParallelFor(count, 64 * 1024, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 i = start; i < end; i++)
+		{
+			keys[i] = Morton::Encode(pointcloud.GetVertex(i).position, cubeMin, pointcloud.boundingCubeSize, levelCount);
+		}
+	});
+
+	// Occupied voxels of the whole point cloud on each grid level
+	std::vector<UINT64> occupiedVoxels(levelCount + 1);
+	sortedKeys = keys;
+	RadixSort(sortedKeys, values, 3 * levelCount);
+
+	for (UINT level = 0; level <= levelCount; level++)
+	{
+		occupiedVoxels[level] = CountOccupiedVoxels(sortedKeys, level, levelCount);
+	}
+
+	results << L"Prefix coverage (occupied voxels of the whole point cloud that contain a point of the prefix)" << std::endl;
+	results << L"\tEach prefix is evaluated on the finest grid where the whole point cloud occupies at most as many voxels as the prefix has points" << std::endl;
+	results << L"\tA random order covers about 63%, a stratified order close to 100%" << std::endl;
+
+	for (double fraction : fractions)
+	{
+		UINT64 prefixCount = count * fraction;
+		UINT level = 0;
+
+		while (level < levelCount && occupiedVoxels[level + 1] <= prefixCount)
+		{
+			level++;
+		}
+
+		if (prefixCount == 0)
+		{
+			continue;
+		}
+
+		sortedKeys.assign(keys.begin(), keys.begin() + prefixCount);
+		values.resize(prefixCount);
+		RadixSort(sortedKeys, values, 3 * levelCount);
+
+		double coverage = (double)CountOccupiedVoxels(sortedKeys, level, levelCount) / occupiedVoxels[level];
+
+		results << L"\t" << 100 * fraction << L"% prefix (" << prefixCount << L" points): grid level " << level << L" with " << occupiedVoxels[level] << L" occupied voxels, coverage " << 100 * coverage << L"%" << std::endl;
+	}
+
+	results << std::endl;
+}
+
+void Benchmark::BenchmarkOctreeConstruction(const std::wstring& pointcloudFile)
+{
+	const int runs = 3;
+
+	PointcloudFile pointcloud;
+
+	if (!pointcloud.Open(pointcloudFile) || pointcloud.vertexCount == 0)
+	{
+		results << L"Could not open " << pointcloudFile << std::endl;
+		return;
+	}
+
+	Vector3 rootPosition = pointcloud.boundingCubePosition;
+	float rootSize = pointcloud.boundingCubeSize;
+	std::vector<Vertex> vertices(pointcloud.vertexCount);
+	pointcloud.DecodeVertices(0, pointcloud.vertexCount, vertices.data());
+	pointcloud.Close();
+
+	double points = vertices.size();
+	UINT hardwareThreads = ThreadPool::Get().GetThreadCount();
+	std::vector<OctreeNode> queueNodes;
+
+	results << L"Octree construction of " << points << L" points with " << NAMEOF(maxOctreeDepth) << L"=" << settings->maxOctreeDepth << L" (the builders consume a copy of the vertices that is made before the measurement)" << std::endl;
+
+	auto measureBuild = [&](OctreeBuildMode mode, std::vector<OctreeNode>& outNodes)
+	{
+		std::vector<Vertex> copy = vertices;
+
+		return MeasureSeconds([&]() { OctreeBuilder::Build(mode, std::move(copy), rootPosition, rootSize, outNodes); });
+	};
+
+	// The queue builder is single threaded and only measured once
+	std::vector<double> queueSeconds(1, measureBuild(OctreeBuildMode::Queue, queueNodes));
+	WriteResult(L"Queue, 1 thread", queueSeconds, 0, points);
+
+	// The parallel builders are measured with an increasing number of threads and compared with the nodes of the queue builder
+	auto measureScaling = [&](OctreeBuildMode mode, const std::wstring& name, std::vector<OctreeNode>& nodes)
+	{
+		double singleThreadBest = 0;
+
+		for (UINT threadCount = 1; ; threadCount = min(2 * threadCount, hardwareThreads))
+		{
+			std::vector<double> seconds;
+			ThreadPool::Get().SetThreadLimit(threadCount);
+
+			for (int run = 0; run < runs; run++)
+			{
+				seconds.push_back(measureBuild(mode, nodes));
+			}
+
+			double best = *std::min_element(seconds.begin(), seconds.end());
+			singleThreadBest = (threadCount == 1) ? best : singleThreadBest;
+
+			WriteResult(name + L", " + std::to_wstring(threadCount) + L" threads", seconds, 0, points);
+			results << L"\t\t(speedup " << singleThreadBest / best << L" over 1 thread, " << queueSeconds[0] / best << L" over the queue builder)" << std::endl;
+
+			if (threadCount == hardwareThreads)
+			{
+				break;
+			}
+		}
+
+		ThreadPool::Get().SetThreadLimit(0);
+	};
+
+	auto compareNodes = [&](const std::wstring& name, const std::vector<OctreeNode>& nodes)
+	{
+		bool identical = (queueNodes.size() == nodes.size()) && (memcmp(queueNodes.data(), nodes.data(), queueNodes.size() * sizeof(OctreeNode)) == 0);
+		results << L"\t\t" << name << L" creates " << (identical ? L"the same" : L"DIFFERENT") << L" nodes as the queue builder" << std::endl;
+	};
+
+	std::vector<OctreeNode> nodes;
+	measureScaling(OctreeBuildMode::Morton, L"Morton", nodes);
+	compareNodes(L"Morton", nodes);
+	measureScaling(OctreeBuildMode::Subtrees, L"Subtrees", nodes);
+	compareNodes(L"Subtrees", nodes);
+
+	// The aggregating builder only matches the queue builder in the leaves
+	measureScaling(OctreeBuildMode::Aggregate, L"Aggregate", nodes);
+	WriteClusterDifference(L"Aggregate", queueNodes, nodes);
+
+	results << L"\t" << queueNodes.size() << L" nodes" << std::endl;
+
+	// Peak heap memory of the vertex data: the queue builder partitions the vertices with one scratch array
+	// The subtree builder uses the same arrays as the queue builder
+	// The morton builder sorts the keys and indices with scratch arrays and then merges the vertices with a scratch array
+	// The previous queue builder with vertex copies held at least the root entry, the eight child vectors and their copies in the queue
+	double vertexBytes = points * sizeof(Vertex);
+	double mortonBytes = points * max(sizeof(Vertex) + 2 * sizeof(UINT64) + 2 * sizeof(PointcloudIndex), 2 * sizeof(Vertex) + sizeof(UINT64) + 2 * sizeof(PointcloudIndex));
+	results << L"\tPeak heap memory for the vertices: queue and subtrees " << 2 * vertexBytes / (1024 * 1024) << L" MB, morton " << mortonBytes / (1024 * 1024) << L" MB";
+	results << L", previous queue builder with vertex copies at least " << 3 * vertexBytes / (1024 * 1024) << L" MB" << std::endl << std::endl;
+}
+
+void Benchmark::BenchmarkOutOfCoreConstruction(const std::wstring& pointcloudFile)
+{
+	PointcloudFile pointcloud;
+
+	if (!pointcloud.Open(pointcloudFile, false) || pointcloud.vertexCount == 0)
+	{
+		results << L"Could not open " << pointcloudFile << std::endl;
+		return;
+	}
+
+	double points = pointcloud.vertexCount;
+	double decompressedBytes = points * pointcloud.recordSize;
+	bool compressed = (pointcloud.flags & pointcloudFlagCompressed) != 0;
+	pointcloud.Close();
+
+	// Without a configured limit the vertices are split into about eight files
+	UINT64 memoryLimit = settings->octreeMemoryLimit * 1024ULL * 1024ULL;
+	memoryLimit = (memoryLimit > 0) ? memoryLimit : (UINT64)(points * OutOfCoreOctreeBuilder::bytesPerVertex / 8);
+
+	// Compressed files are built with a limit below the size of their decompressed records, these are never held in memory at once
+	if (compressed)
+	{
+		memoryLimit = min(memoryLimit, (UINT64)(decompressedBytes / 4));
+	}
+
+	results << L"Out of core octree construction of " << points << L" points with a memory limit of " << memoryLimit / (1024.0 * 1024.0) << L" MB (" << NAMEOF(octreeBuildMode) << L"=" << (int)settings->octreeBuildMode << L")" << std::endl;
+
+	Vector3 rootPosition;
+	float rootSize = 0;
+	std::vector<OctreeNode> memoryNodes, nodes;
+	OutOfCoreOctreeBuilder::Statistics statistics;
+
+	std::vector<double> memorySeconds(1, MeasureSeconds([&]() { OutOfCoreOctreeBuilder::Build(pointcloudFile, L"", ~0ULL, settings->octreeBuildMode, rootPosition, rootSize, memoryNodes); }));
+	WriteResult(L"In memory including decoding", memorySeconds, 0, points);
+
+	CreateDirectory((executableDirectory + L"/Octrees").c_str(), NULL);
+	std::vector<double> seconds(1, MeasureSeconds([&]() { statistics = OutOfCoreOctreeBuilder::Build(pointcloudFile, executableDirectory + L"/Octrees/Benchmark." + std::to_wstring(GetCurrentProcessId()), memoryLimit, settings->octreeBuildMode, rootPosition, rootSize, nodes); }));
+	WriteResult(L"Out of core", seconds, 0, points);
+
+	results << L"\t\t(" << statistics.ioSeconds << L"s I/O, " << statistics.cpuSeconds << L"s CPU, " << statistics.bytesWritten / (1024.0 * 1024.0) << L" MB written, " << statistics.bytesRead / (1024.0 * 1024.0) << L" MB read)" << std::endl;
+	results << L"\t\t(" << statistics.bucketCount << L" buckets up to depth " << statistics.bucketDepth << L" in " << statistics.fileCount << L" files, the largest bucket has " << statistics.largestBucket << L" points)" << std::endl;
+
+	if (compressed)
+	{
+		double blockBytes = statistics.largestBlock * (double)(sizeof(Vertex) + pointcloud.recordSize);
+		results << L"\t\t(the largest block of decompressed and decoded chunks takes " << blockBytes / (1024.0 * 1024.0) << L" MB, all the decompressed records would take " << decompressedBytes / (1024.0 * 1024.0) << L" MB)" << std::endl;
+	}
+
+	WriteClusterDifference(L"Out of core", memoryNodes, nodes);
+	results << std::endl;
+}
+
+void Benchmark::BenchmarkNormalClustering(const std::wstring& pointcloudFile)
+{
+	const int runs = 5;
+
+	PointcloudFile pointcloud;
+
+	if (!pointcloud.Open(pointcloudFile) || pointcloud.vertexCount == 0)
+	{
+		results << L"Could not open " << pointcloudFile << std::endl;
+		return;
+	}
+
+	// Cluster the normals of the root node, it contains all the vertices
+	UINT64 count = pointcloud.vertexCount;
+	double points = count;
+	UINT hardwareThreads = ThreadPool::Get().GetThreadCount();
+	std::vector<Vertex> vertices(count);
+	pointcloud.DecodeVertices(0, count, vertices.data());
+	pointcloud.Close();
+
+	std::vector<float> normals(3 * count);
+	float* x = normals.data();
+	float* y = x + count;
+	float* z = y + count;
+
+	for (UINT64 i = 0; i < count; i++)
+	{
+		x[i] = vertices[i].normal.x;
+		y[i] = vertices[i].normal.y;
+		z[i] = vertices[i].normal.z;
+	}
+
+	std::vector<byte> clusters(count);
+	Vector3 means[4];
+	UINT64 meanCounts[4];
+	UINT meanCount = (UINT)min(count, 4ULL);
+
+	// Average squared distance of the normals to the mean of their cluster, lower is better
+	auto getError = [&]()
+	{
+		double error = 0;
+
+		for (UINT64 i = 0; i < count; i++)
+		{
+			error += Vector3::DistanceSquared(vertices[i].normal, means[clusters[i]]);
+		}
+
+		return error / count;
+	};
+
+	results << L"Normal clustering of the root node with " << points << L" points (" << runs << L" runs, " << NAMEOF(maxClusterIterations) << L"=" << settings->maxClusterIterations << L")" << std::endl;
+
+	// One assignment pass of the kernels with the first normals as means
+	for (UINT j = 0; j < meanCount; j++)
+	{
+		means[j] = vertices[j].normal;
+	}
+
+	auto measureKernel = [&](const std::wstring& name, const std::function<void()>& kernel)
+	{
+		std::vector<double> seconds;
+
+		for (int run = 0; run < runs; run++)
+		{
+			memset(clusters.data(), 0, count);
+			seconds.push_back(MeasureSeconds(kernel));
+		}
+
+		WriteResult(name + L" assignment pass, 1 thread", seconds, 0, points);
+	};
+
+	measureKernel(L"Scalar", [&]() { NormalClustering::AssignClustersScalar(x, y, z, count, means, meanCount, clusters.data()); });
+
+	if (SIMD::SupportsAVX2())
+	{
+		measureKernel(L"AVX2", [&]() { NormalClustering::AssignClustersAVX2(x, y, z, count, means, meanCount, clusters.data()); });
+	}
+
+	// The previous clustering runs until no mean moves anymore, its time is measured once
+	UINT iterations = 0;
+	std::vector<double> referenceSeconds(1, MeasureSeconds([&]() { iterations = ClusterNormalsReference(vertices, means, clusters.data()); }));
+	double referenceError = getError();
+
+	WriteResult(L"Previous k-means with distances, 1 thread", referenceSeconds, 0, points);
+	results << L"\t\t(" << iterations << L" iterations, mean squared error " << referenceError << L")" << std::endl;
+
+	for (int kMeansPlusPlus = 0; kMeansPlusPlus < 2; kMeansPlusPlus++)
+	{
+		for (UINT threadCount = 1; ; threadCount = min(2 * threadCount, hardwareThreads))
+		{
+			std::vector<double> seconds;
+			ThreadPool::Get().SetThreadLimit(threadCount);
+
+			for (int run = 0; run < runs; run++)
+			{
+				seconds.push_back(MeasureSeconds([&]() { iterations = NormalClustering::Cluster(x, y, z, count, settings->maxClusterIterations, kMeansPlusPlus != 0, means, meanCounts, clusters.data()); }));
+			}
+
+			WriteResult(std::wstring(kMeansPlusPlus ? L"k-means++" : L"k-means") + L" kernel, " + std::to_wstring(threadCount) + L" threads", seconds, 0, points);
+
+			if (threadCount == hardwareThreads)
+			{
+				break;
+			}
+		}
+
+		ThreadPool::Get().SetThreadLimit(0);
+
+		double error = getError();
+		results << L"\t\t(" << iterations << L" iterations, mean squared error " << error << L", " << 100 * (error - referenceError) / max(referenceError, 1e-12) << L"% compared to the previous k-means)" << std::endl;
+	}
+
+	results << std::endl;
+}
+
+void Benchmark::WriteClusterDifference(const std::wstring& name, const std::vector<OctreeNode>& referenceNodes, const std::vector<OctreeNode>& nodes)
+{
+	if (referenceNodes.size() != nodes.size())
+	{
+		results << L"\t\t" << name << L" creates a DIFFERENT number of nodes" << std::endl;
+		return;
+	}
+
+	UINT64 differentLeaves = 0;
+	UINT64 innerNodes = 0;
+	double angleSum = 0, referenceConeSum = 0, coneSum = 0, colorSum = 0, weightSum = 0;
+
+	auto getColor = [](const Color16& color)
+	{
+		return Vector3(((color.data >> 10) & 0x3f) / 63.0f, ((color.data >> 4) & 0x3f) / 63.0f, (color.data & 0xf) / 15.0f) * 255.0f;
+	};
+
+	for (UINT64 i = 0; i < nodes.size(); i++)
+	{
+		OctreeNodeProperties reference = referenceNodes[i].properties;
+		OctreeNodeProperties properties = nodes[i].properties;
+
+		if (reference.childrenMask == 0)
+		{
+			differentLeaves += (memcmp(&referenceNodes[i], &nodes[i], sizeof(OctreeNode)) != 0) ? 1 : 0;
+			continue;
+		}
+
+		innerNodes++;
+
+		// Compare each cluster of the reference with the closest cluster by its share of the points
+		float referenceWeights[4] = { (float)reference.weights[0], (float)reference.weights[1], (float)reference.weights[2], 0 };
+		referenceWeights[3] = max(0.0f, 255.0f - referenceWeights[0] - referenceWeights[1] - referenceWeights[2]);
+
+		for (int j = 0; j < 4; j++)
+		{
+			Vector3 referenceNormal = reference.normals[j].GetVector3();
+
+			if (referenceWeights[j] <= 0 || referenceNormal == Vector3::Zero)
+			{
+				continue;
+			}
+
+			float weight = referenceWeights[j] / 255.0f;
+			float smallestAngle = XM_PI;
+			int closest = 0;
+
+			for (int k = 0; k < 4; k++)
+			{
+				Vector3 normal = properties.normals[k].GetVector3();
+
+				if (normal != Vector3::Zero)
+				{
+					float angle = acos(max(-1.0f, min(1.0f, referenceNormal.Dot(normal))));
+
+					if (angle < smallestAngle)
+					{
+						smallestAngle = angle;
+						closest = k;
+					}
+				}
+			}
+
+			angleSum += weight * smallestAngle;
+			referenceConeSum += weight * reference.normals[j].GetCone();
+			coneSum += weight * properties.normals[closest].GetCone();
+			colorSum += weight * Vector3::Distance(getColor(reference.colors[j]), getColor(properties.colors[closest]));
+			weightSum += weight;
+		}
+	}
+
+	weightSum = max(weightSum, 1e-12);
+	results << L"\t\t" << name << L" creates " << differentLeaves << L" different leaves, in the " << innerNodes << L" inner nodes the clusters differ by ";
+	results << XMConvertToDegrees(angleSum / weightSum) << L" degrees and a color distance of " << colorSum / weightSum << L" (0-255) on average";
+	results << L", the cones are " << XMConvertToDegrees(coneSum / weightSum) << L" instead of " << XMConvertToDegrees(referenceConeSum / weightSum) << L" degrees" << std::endl;
+}
+
+UINT Benchmark::ClusterNormalsReference(const std::vector<Vertex>& vertices, Vector3 outMeans[4], byte* outClusters)
+{
+	// This is the k-means clustering of the octree nodes before the clustering kernel was introduced, it is only kept as reference for the benchmark
+	const UINT64 vertexCount = vertices.size();
+	const int k = min(vertexCount, 4);
+	UINT64 verticesPerMean[4] = { 0, 0, 0, 0 };
+	UINT iterations = 0;
+
+	for (int i = 0; i < k; i++)
+	{
+		outMeans[i] = vertices[i].normal;
+	}
+
+	bool meanChanged = true;
+	ZeroMemory(outClusters, sizeof(byte) * vertexCount);
+
+	while (meanChanged)
+	{
+		iterations++;
+
+		for (UINT64 i = 0; i < vertexCount; i++)
+		{
+			float minDistance = Vector3::Distance(vertices[i].normal, outMeans[outClusters[i]]);
+
+			for (int j = 0; j < k; j++)
+			{
+				float distance = Vector3::Distance(vertices[i].normal, outMeans[j]);
+
+				if (distance < minDistance)
+				{
+					outClusters[i] = j;
+					minDistance = distance;
+				}
+			}
+		}
+
+		Vector3 newMeans[4];
+
+		for (int i = 0; i < k; i++)
+		{
+			verticesPerMean[i] = 0;
+		}
+
+		for (UINT64 i = 0; i < vertexCount; i++)
+		{
+			newMeans[outClusters[i]] += vertices[i].normal;
+			verticesPerMean[outClusters[i]] += 1;
+		}
+
+		meanChanged = false;
+
+		for (int i = 0; i < k; i++)
+		{
+			if (verticesPerMean[i] > 0)
+			{
+				newMeans[i] /= verticesPerMean[i];
+
+				if (Vector3::DistanceSquared(outMeans[i], newMeans[i]) > FLT_EPSILON)
+				{
+					meanChanged = true;
+				}
+
+				outMeans[i] = newMeans[i];
+			}
+		}
+	}
+
+	return iterations;
+}
+
+UINT64 Benchmark::CountOccupiedVoxels(const std::vector<UINT64>& sortedKeys, UINT level, UINT levelCount)
+{
+	UINT shift = 3 * (levelCount - level);
+	UINT64 occupied = 0;
+
+	for (UINT64 i = 0; i < sortedKeys.size(); i++)
+	{
+		if (i == 0 || (sortedKeys[i] >> shift) != (sortedKeys[i - 1] >> shift))
+		{
+			occupied++;
+		}
+	}
+
+	return occupied;
+}
+
+bool Benchmark::LoadPointcloudFileStream(std::vector<Vertex>& outVertices, Vector3& outBoundingCubePosition, float& outBoundingCubeSize, const std::wstring& pointcloudFile)
+{
+	try
+	{
+		// This is the loader before memory mapping was introduced, it is only kept as reference for the benchmark
+		std::ifstream file(pointcloudFile, std::ios::in | std::ios::binary);
+
+		// Load the bounding cube position and size
+		file.read((char*)&outBoundingCubePosition, sizeof(Vector3));
+		file.read((char*)&outBoundingCubeSize, sizeof(float));
+
+		// Load the size of the vertices vector
+		UINT vertexCount;
+		file.read((char*)&vertexCount, sizeof(UINT));
+
+		// Version 2 files have a different header, only read it to be able to compare against the same files
+		UINT magic;
+		memcpy(&magic, &outBoundingCubePosition, sizeof(UINT));
+
+		if (magic == pointcloudMagic)
+		{
+			PointcloudHeader header;
+			file.seekg(0);
+			file.read((char*)&header, sizeof(PointcloudHeader));
+			file.seekg(header.dataOffset);
+
+			outBoundingCubePosition = header.boundingCubePosition;
+			outBoundingCubeSize = header.boundingCubeSize;
+			vertexCount = (UINT)header.vertexCount;
+		}
+
+		// Read the binary data directly into the vertices vector
+		std::vector<PointcloudVertex> pointcloudVertices = std::vector<PointcloudVertex>(vertexCount);
+		file.read((char*)pointcloudVertices.data(), vertexCount * sizeof(PointcloudVertex));
+
+		// Convert to the required vertex format
+		outVertices = std::vector<Vertex>(vertexCount);
+
+		for (UINT i = 0; i < vertexCount; i++)
+		{
+			outVertices[i].position = pointcloudVertices[i].position;
+			outVertices[i].normal.x = pointcloudVertices[i].normal[0] / 127.0f;
+			outVertices[i].normal.y = pointcloudVertices[i].normal[1] / 127.0f;
+			outVertices[i].normal.z = pointcloudVertices[i].normal[2] / 127.0f;
+			outVertices[i].color[0] = pointcloudVertices[i].color[0];
+			outVertices[i].color[1] = pointcloudVertices[i].color[1];
+			outVertices[i].color[2] = pointcloudVertices[i].color[2];
+		}
+	}
+	catch (const std::exception& e)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+void Benchmark::WriteResult(const std::wstring& name, const std::vector<double>& seconds, double bytes, double points)
+{
+	double best = *std::min_element(seconds.begin(), seconds.end());
+	double average = 0;
+
+	for (auto it = seconds.begin(); it != seconds.end(); it++)
+	{
+		average += *it / seconds.size();
+	}
+
+	results << L"\t" << name << L": best " << best << L"s, average " << average << L"s";
+
+	if (bytes > 0)
+	{
+		results << L", " << (bytes / (1024 * 1024)) / best << L" MB/s";
+	}
+
+	if (points > 0)
+	{
+		results << L", " << (points / 1000000) / best << L" M points/s";
+	}
+
+	results << std::endl;
+}
@@ -0,0 +1,42 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#pragma once
+#include "PointCloudEngine.h"
+
+namespace PointCloudEngine
+{
+	// CPU benchmarks that run without creating a window: PointCloudEngine.exe -benchmark file.pointcloud
+	// The results are printed to the console and saved in the Benchmarks folder next to the executable
+	class Benchmark
+	{
+	public:
+		static void Run(const std::wstring& pointcloudFile);
+
+	private:
+		static std::wstringstream results;
+
+		static void BenchmarkPointcloudLoading(const std::wstring& pointcloudFile);
+		static void BenchmarkVertexDecoding(const std::wstring& pointcloudFile);
+		static void BenchmarkPrefixCoverage(const std::wstring& pointcloudFile);
+		static void BenchmarkOctreeConstruction(const std::wstring& pointcloudFile);
+		static void BenchmarkNormalClustering(const std::wstring& pointcloudFile);
+		static void BenchmarkOutOfCoreConstruction(const std::wstring& pointcloudFile);
+		static void WriteClusterDifference(const std::wstring& name, const std::vector<OctreeNode>& referenceNodes, const std::vector<OctreeNode>& nodes);
+		static UINT ClusterNormalsReference(const std::vector<Vertex>& vertices, Vector3 outMeans[4], byte* outClusters);
+		static UINT64 CountOccupiedVoxels(const std::vector<UINT64>& sortedKeys, UINT level, UINT levelCount);
+		static bool LoadPointcloudFileStream(std::vector<Vertex>& outVertices, Vector3& outBoundingCubePosition, float& outBoundingCubeSize, const std::wstring& pointcloudFile);
+		static void WriteResult(const std::wstring& name, const std::vector<double>& seconds, double bytes, double points);
+
+		template<typename T> static double MeasureSeconds(T function)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			function();
+			auto end = std::chrono::high_resolution_clock::now();
+
+			return std::chrono::duration<double>(end - start).count();
+		}
+	};
+}
+
+#endif
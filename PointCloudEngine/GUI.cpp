@@ -2,7 +2,7 @@
 #include "GUI.h"
 
 UINT GUI::fps = 0;
-UINT GUI::vertexCount = 0;
+UINT64 GUI::vertexCount = 0;
 UINT GUI::triangleCount = 0;
 UINT GUI::uvCount = 0;
 UINT GUI::normalCount = 0;
@@ -202,7 +202,7 @@ void PointCloudEngine::GUI::CreateRendererElements()
 	rendererElements.push_back(new GUIText(hwndGUI, GS(10), GS(70), GS(100), GS(20), L"Shading Mode "));
 	rendererElements.push_back(new GUIDropdown(hwndGUI, GS(160), GS(65), GS(180), GS(200), { L"Color", L"Depth", L"Normal", L"NormalScreen", L"OpticalFlowForward", L"OpticalFlowBackward" }, OnSelectShadingMode, &shadingModeSelection));
 	rendererElements.push_back(new GUIText(hwndGUI, GS(10), GS(100), GS(150), GS(20), L"Vertex Count "));
-	rendererElements.push_back(new GUIValue<UINT>(hwndGUI, GS(160), GS(100), GS(200), GS(20), &GUI::vertexCount));
+	rendererElements.push_back(new GUIValue<UINT64>(hwndGUI, GS(160), GS(100), GS(200), GS(20), &GUI::vertexCount));
 	rendererElements.push_back(new GUIText(hwndGUI, GS(10), GS(130), GS(150), GS(20), L"Frames per second "));
 	rendererElements.push_back(new GUIValue<UINT>(hwndGUI, GS(160), GS(130), GS(50), GS(20), &GUI::fps));
 	rendererElements.push_back(new GUIText(hwndGUI, GS(10), GS(160), GS(150), GS(20), L"Lighting "));
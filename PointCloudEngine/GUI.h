@@ -17,7 +17,7 @@ namespace PointCloudEngine
 	{
 	public:
 		static UINT fps;
-		static UINT vertexCount;
+		static UINT64 vertexCount;
 		static UINT triangleCount, uvCount, normalCount, submeshCount, textureCount;
 		static UINT waypointCount;
 
@@ -6,7 +6,7 @@ struct VS_INPUT
 {
     float3 position : POSITION;
     float3 normal : NORMAL;
-    uint3 color : COLOR;
+    uint4 color : COLOR;
 };
 
 struct VS_OUTPUT
@@ -15,6 +15,7 @@ struct VS_OUTPUT
     float3 positionPrevious : POSITION1;
     float3 normal : NORMAL;
     float3 color : COLOR;
+    float radius : RADIUS;
 };
 
 VS_OUTPUT VS(VS_INPUT input)
@@ -23,7 +24,10 @@ VS_OUTPUT VS(VS_INPUT input)
 	output.position = mul(float4(input.position, 1), World).xyz;
     output.positionPrevious = mul(float4(input.position, 1), PreviousWorld).xyz;
 	output.normal = normalize(mul(float4(input.normal, 0), WorldInverseTranspose)).xyz;
-	output.color = input.color / 255.0f;
+	output.color = input.color.rgb / 255.0f;
+
+	// The fourth color byte stores the quantized splat radius relative to the bounding cube size, zero if it is unknown
+	output.radius = (input.color.a > 0) ? radiusScale * exp2(-(input.color.a - 1.0f) / 12.0f) : 0;
 
 	return output;
 }
\ No newline at end of file
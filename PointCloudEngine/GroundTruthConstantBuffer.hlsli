@@ -31,4 +31,8 @@ cbuffer GroundTruthConstantBuffer : register(b0)
 	int resolutionX;
 	int resolutionY;
 	//------------------------------------------------------------------------------ (16 byte boundary)
-};  // Total: 372 bytes with constant buffer packing rules
\ No newline at end of file
+	float radiusScale;
+	bool useRadii;
+	// 8 byte auto padding
+	//------------------------------------------------------------------------------ (16 byte boundary)
+};  // Total: 388 bytes with constant buffer packing rules
\ No newline at end of file
@@ -11,35 +11,64 @@
 
 GroundTruthRenderer::GroundTruthRenderer(const std::wstring &pointcloudFile)
 {
-    // Try to load the file
-    if (!LoadPointcloudFile(vertices, boundingCubePosition, boundingCubeSize, pointcloudFile))
+    // Try to map the file, the vertices are only decoded when they are uploaded to the GPU
+    if (!pointcloud.Open(pointcloudFile))
     {
         throw std::exception("Could not load .pointcloud file!");
     }
 
+	boundingCubePosition = pointcloud.boundingCubePosition;
+	boundingCubeSize = pointcloud.boundingCubeSize;
+
     // Set the default values
     constantBufferData.fovAngleY = settings->fovAngleY;
 }
 
 void GroundTruthRenderer::Initialize()
 {
-    // Create a vertex buffer description
-    D3D11_BUFFER_DESC vertexBufferDesc;
-    ZeroMemory(&vertexBufferDesc, sizeof(vertexBufferDesc));
-    vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-    vertexBufferDesc.ByteWidth = sizeof(Vertex) * vertices.size();
-    vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    vertexBufferDesc.CPUAccessFlags = 0;
-    vertexBufferDesc.MiscFlags = 0;
-
-    // Fill a D3D11_SUBRESOURCE_DATA struct with the data we want in the buffer
-    D3D11_SUBRESOURCE_DATA vertexBufferData;
-    ZeroMemory(&vertexBufferData, sizeof(vertexBufferData));
-    vertexBufferData.pSysMem = &vertices[0];
-
-    // Create the buffer
-    hr = d3d11Device->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &vertexBuffer);
-	ERROR_MESSAGE_ON_HR(hr, NAMEOF(d3d11Device->CreateBuffer) + L" failed for the " + NAMEOF(vertexBuffer));
+	// Decode the mapped records in chunks and upload each chunk, this avoids holding a full copy of the decoded vertices in memory
+	const UINT64 chunkSize = 1 << 20;
+	std::vector<Vertex> chunkVertices(std::min(chunkSize, pointcloud.vertexCount));
+
+	for (UINT64 bufferStart = 0; bufferStart < pointcloud.vertexCount; bufferStart += vertexBufferSize)
+	{
+		UINT64 bufferCount = std::min(vertexBufferSize, pointcloud.vertexCount - bufferStart);
+
+		// Create a vertex buffer description
+		D3D11_BUFFER_DESC vertexBufferDesc;
+		ZeroMemory(&vertexBufferDesc, sizeof(vertexBufferDesc));
+		vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+		vertexBufferDesc.ByteWidth = (UINT)(sizeof(Vertex) * bufferCount);
+		vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		vertexBufferDesc.CPUAccessFlags = 0;
+		vertexBufferDesc.MiscFlags = 0;
+
+		// Create the buffer without initial data
+		ID3D11Buffer* vertexBuffer = NULL;
+		hr = d3d11Device->CreateBuffer(&vertexBufferDesc, NULL, &vertexBuffer);
+		ERROR_MESSAGE_ON_HR(hr, NAMEOF(d3d11Device->CreateBuffer) + L" failed for the " + NAMEOF(vertexBuffer));
+
+		vertexBuffers.push_back(vertexBuffer);
+
+		for (UINT64 chunkStart = 0; chunkStart < bufferCount; chunkStart += chunkSize)
+		{
+			UINT64 chunkCount = std::min(chunkSize, bufferCount - chunkStart);
+			pointcloud.DecodeVertices(bufferStart + chunkStart, chunkCount, chunkVertices.data());
+
+			D3D11_BOX chunkBox;
+			chunkBox.left = (UINT)(chunkStart * sizeof(Vertex));
+			chunkBox.right = (UINT)((chunkStart + chunkCount) * sizeof(Vertex));
+			chunkBox.top = 0;
+			chunkBox.bottom = 1;
+			chunkBox.front = 0;
+			chunkBox.back = 1;
+
+			d3d11DevCon->UpdateSubresource(vertexBuffer, 0, &chunkBox, chunkVertices.data(), 0, 0);
+		}
+	}
+
+	// The vertex count stays valid after the mapping is released
+	pointcloud.Close();
 
     // Create the constant buffer (also used by MeshRenderer and PullPush)
     D3D11_BUFFER_DESC constantBufferDesc;
@@ -108,16 +137,15 @@ void GroundTruthRenderer::Draw()
     // Set the Input (Vertex) Layout
     d3d11DevCon->IASetInputLayout(splatShader->inputLayout);
 
-    // Bind the vertex buffer and index buffer to the input assembler (IA)
-    UINT offset = 0;
-    UINT stride = sizeof(Vertex);
-    d3d11DevCon->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
-
     // Set primitive topology
     d3d11DevCon->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_POINTLIST);
 
 	// The amount of points that will be drawn
-	UINT vertexCount = vertices.size();
+	UINT64 vertexCount = pointcloud.vertexCount;
+
+	// The splat radii of the file replace the sampling rate, they are relative to the bounding cube size
+	constantBufferData.useRadii = settings->useSplatRadii && (pointcloud.flags & pointcloudFlagRadii);
+	constantBufferData.radiusScale = boundingCubeSize;
 
 	// Set different sampling rates based on the view mode
 	if (settings->viewMode == ViewMode::Splats)
@@ -128,6 +156,9 @@ void GroundTruthRenderer::Draw()
 	{
 		constantBufferData.samplingRate = settings->sparseSamplingRate;
 
+		// The spacing of a random subset on a surface grows with one over the square root of the density
+		constantBufferData.radiusScale /= std::sqrt(std::max(settings->density, 1e-6f));
+
 		// Only draw a portion of the point cloud to simulate the selected density
 		// This requires the vertex indices to be distributed randomly (pointcloud files provide this feature)
 		vertexCount *= settings->density;
@@ -143,11 +174,11 @@ void GroundTruthRenderer::Draw()
 
 	if (settings->useBlending && (settings->viewMode == ViewMode::Splats || settings->viewMode == ViewMode::SparseSplats) && (settings->shadingMode != ShadingMode::Depth))
 	{
-		DrawBlended(vertexCount, constantBuffer, &constantBufferData, constantBufferData.useBlending);
+		DrawBlended([&]() { DrawVertices(vertexCount); }, constantBuffer, &constantBufferData, constantBufferData.useBlending);
 	}
 	else
 	{
-		d3d11DevCon->Draw(vertexCount, 0);
+		DrawVertices(vertexCount);
 
 		if (settings->viewMode == ViewMode::PullPush)
 		{
@@ -163,7 +194,7 @@ void GroundTruthRenderer::Draw()
 			d3d11DevCon->UpdateSubresource(constantBuffer, 0, NULL, &constantBufferData, 0, 0);
 			d3d11DevCon->ClearRenderTargetView(renderTargetView, (float*)&settings->backgroundColor);
 			d3d11DevCon->ClearDepthStencilView(depthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
-			d3d11DevCon->Draw(vertexCount, 0);
+			DrawVertices(vertexCount);
 			constantBufferData.shadingMode = (int)settings->shadingMode;
 
 			pullPush->SetInitialNormalTexture(backBufferTexture);
@@ -177,7 +208,12 @@ void GroundTruthRenderer::Draw()
 
 void GroundTruthRenderer::Release()
 {
-    SAFE_RELEASE(vertexBuffer);
+	for (ID3D11Buffer*& vertexBuffer : vertexBuffers)
+	{
+		SAFE_RELEASE(vertexBuffer);
+	}
+
+	vertexBuffers.clear();
     SAFE_RELEASE(constantBuffer);
 	SAFE_RELEASE(pullPush);
 }
@@ -260,6 +296,19 @@ void PointCloudEngine::GroundTruthRenderer::Redraw(bool present)
 	}
 }
 
+void PointCloudEngine::GroundTruthRenderer::DrawVertices(UINT64 vertexCount)
+{
+	// Draws the first vertices of the point cloud, each buffer is bound to the input assembler (IA) in turn
+	UINT offset = 0;
+	UINT stride = sizeof(Vertex);
+
+	for (UINT64 i = 0; i < vertexBuffers.size() && vertexCount > i * vertexBufferSize; i++)
+	{
+		d3d11DevCon->IASetVertexBuffers(0, 1, &vertexBuffers[i], &stride, &offset);
+		d3d11DevCon->Draw((UINT)std::min(vertexBufferSize, vertexCount - i * vertexBufferSize), 0);
+	}
+}
+
 void PointCloudEngine::GroundTruthRenderer::DrawNeuralNetwork()
 {
 	if (!validSCM || !validSFM || !validSRM)
@@ -25,14 +25,18 @@ namespace PointCloudEngine
 		Component* GetComponent();
 
     private:
+		// Maximum number of vertices in each vertex buffer (~1 GB)
+		const UINT64 vertexBufferSize = 1 << 25;
+
 		Vector3 boundingCubePosition;
 		float boundingCubeSize;
 
-        std::vector<Vertex> vertices;
+		// The file stays mapped until the vertices are uploaded to the GPU
+		PointcloudFile pointcloud;
         GroundTruthConstantBuffer constantBufferData;
 
-        // Vertex buffer
-        ID3D11Buffer* vertexBuffer;		        // Holds vertex data
+        // Vertex buffers, large point clouds are split because the byte width of a single buffer is limited
+        std::vector<ID3D11Buffer*> vertexBuffers;
         ID3D11Buffer* constantBuffer;
 
 		// Pull push algorithm
@@ -52,6 +56,7 @@ namespace PointCloudEngine
 		torch::NoGradGuard noGradGuard;
 
 		void Redraw(bool present);
+		void DrawVertices(UINT64 vertexCount);
 		void DrawNeuralNetwork();
 		torch::Tensor NormalizeDepthTensor(torch::Tensor& depthTensor, torch::Tensor& foregroundMask, torch::Tensor& backgroundMask);
 		std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> ConvertTensorIntoZeroToOneRange(torch::Tensor& tensorFull);
@@ -0,0 +1,121 @@
+#ifndef HASH_H
+#define HASH_H
+
+#pragma once
+
+// This header is shared with PlyToPointcloud and therefore only depends on the Windows API
+#include <windows.h>
+#include <cstring>
+
+namespace PointCloudEngine
+{
+	// xxHash64 by Yann Collet, fast non-cryptographic checksum that detects corrupted or truncated data
+	namespace Hash
+	{
+		const UINT64 prime1 = 0x9E3779B185EBCA87ULL;
+		const UINT64 prime2 = 0xC2B2AE3D27D4EB4FULL;
+		const UINT64 prime3 = 0x165667B19E3779F9ULL;
+		const UINT64 prime4 = 0x85EBCA77C2B2AE63ULL;
+		const UINT64 prime5 = 0x27D4EB2F165667C5ULL;
+
+		inline UINT64 RotateLeft(UINT64 value, int bits)
+		{
+			return (value << bits) | (value >> (64 - bits));
+		}
+
+		inline UINT64 Read64(const BYTE* data)
+		{
+			UINT64 value;
+			memcpy(&value, data, sizeof(UINT64));
+			return value;
+		}
+
+		inline UINT Read32(const BYTE* data)
+		{
+			UINT value;
+			memcpy(&value, data, sizeof(UINT));
+			return value;
+		}
+
+		inline UINT64 Round(UINT64 accumulator, UINT64 input)
+		{
+			accumulator += input * prime2;
+			accumulator = RotateLeft(accumulator, 31);
+			return accumulator * prime1;
+		}
+
+		inline UINT64 MergeRound(UINT64 accumulator, UINT64 value)
+		{
+			accumulator ^= Round(0, value);
+			return accumulator * prime1 + prime4;
+		}
+
+		inline UINT64 XXHash64(const void* input, UINT64 length, UINT64 seed = 0)
+		{
+			const BYTE* data = (const BYTE*)input;
+			const BYTE* end = data + length;
+			UINT64 hash;
+
+			if (length >= 32)
+			{
+				const BYTE* limit = end - 32;
+				UINT64 v1 = seed + prime1 + prime2;
+				UINT64 v2 = seed + prime2;
+				UINT64 v3 = seed;
+				UINT64 v4 = seed - prime1;
+
+				do
+				{
+					v1 = Round(v1, Read64(data));
+					v2 = Round(v2, Read64(data + 8));
+					v3 = Round(v3, Read64(data + 16));
+					v4 = Round(v4, Read64(data + 24));
+					data += 32;
+				} while (data <= limit);
+
+				hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+				hash = MergeRound(hash, v1);
+				hash = MergeRound(hash, v2);
+				hash = MergeRound(hash, v3);
+				hash = MergeRound(hash, v4);
+			}
+			else
+			{
+				hash = seed + prime5;
+			}
+
+			hash += length;
+
+			while (data + 8 <= end)
+			{
+				hash ^= Round(0, Read64(data));
+				hash = RotateLeft(hash, 27) * prime1 + prime4;
+				data += 8;
+			}
+
+			if (data + 4 <= end)
+			{
+				hash ^= (UINT64)Read32(data) * prime1;
+				hash = RotateLeft(hash, 23) * prime2 + prime3;
+				data += 4;
+			}
+
+			while (data < end)
+			{
+				hash ^= (*data) * prime5;
+				hash = RotateLeft(hash, 11) * prime1;
+				data++;
+			}
+
+			hash ^= hash >> 33;
+			hash *= prime2;
+			hash ^= hash >> 29;
+			hash *= prime3;
+			hash ^= hash >> 32;
+
+			return hash;
+		}
+	}
+}
+
+#endif
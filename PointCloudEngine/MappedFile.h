@@ -0,0 +1,156 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#pragma once
+
+// This header is shared with PlyToPointcloud and therefore only depends on the Windows API
+#include <windows.h>
+#include <string>
+
+namespace PointCloudEngine
+{
+	// Maps a whole file into the address space of the process, read-only unless requested otherwise
+	// The operating system pages the data in on demand, nothing is copied into process memory
+	class MappedFile
+	{
+	public:
+		MappedFile() {}
+		~MappedFile() { Close(); }
+
+		bool Open(const std::wstring& filename, bool writable = false)
+		{
+			Close();
+			this->writable = writable;
+			file = CreateFileW(filename.c_str(), writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ, writable ? 0 : FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			return MapWholeFile();
+		}
+
+		bool Open(const std::string& filename, bool writable = false)
+		{
+			Close();
+			this->writable = writable;
+			file = CreateFileA(filename.c_str(), writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ, writable ? 0 : FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			return MapWholeFile();
+		}
+
+		void Close()
+		{
+			UnmapWholeFile();
+
+			if (file != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(file);
+				file = INVALID_HANDLE_VALUE;
+			}
+
+			size = 0;
+		}
+
+		bool IsOpen() const
+		{
+			return file != INVALID_HANDLE_VALUE;
+		}
+
+		const BYTE* GetData() const
+		{
+			return data;
+		}
+
+		// Changes are written back to the file by the operating system, only available when opened as writable
+		BYTE* GetWritableData()
+		{
+			return writable ? data : NULL;
+		}
+
+		UINT64 GetSize() const
+		{
+			return size;
+		}
+
+		// Truncates or extends a writable file and maps it again, the previous data pointer becomes invalid
+		bool Resize(UINT64 newSize)
+		{
+			if (!writable || file == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+
+			UnmapWholeFile();
+
+			LARGE_INTEGER position;
+			position.QuadPart = newSize;
+
+			if (!SetFilePointerEx(file, position, NULL, FILE_BEGIN) || !SetEndOfFile(file))
+			{
+				Close();
+				return false;
+			}
+
+			return MapWholeFile();
+		}
+
+	private:
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = NULL;
+		BYTE* data = NULL;
+		UINT64 size = 0;
+		bool writable = false;
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		void UnmapWholeFile()
+		{
+			if (data != NULL)
+			{
+				UnmapViewOfFile(data);
+				data = NULL;
+			}
+
+			if (mapping != NULL)
+			{
+				CloseHandle(mapping);
+				mapping = NULL;
+			}
+
+			size = 0;
+		}
+
+		bool MapWholeFile()
+		{
+			LARGE_INTEGER fileSize;
+
+			if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize))
+			{
+				Close();
+				return false;
+			}
+
+			size = fileSize.QuadPart;
+
+			// Empty files cannot be mapped, they are valid but have no data
+			if (size == 0)
+			{
+				return true;
+			}
+
+			// The whole file is mapped at once, files larger than a few GB require the x64 build
+			mapping = CreateFileMappingW(file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+
+			if (mapping != NULL)
+			{
+				data = (BYTE*)MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+			}
+
+			if (data == NULL)
+			{
+				Close();
+				return false;
+			}
+
+			return true;
+		}
+	};
+}
+
+#endif
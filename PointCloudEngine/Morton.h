@@ -0,0 +1,74 @@
+#ifndef MORTON_H
+#define MORTON_H
+
+#pragma once
+
+// This header is shared with PlyToPointcloud and therefore only depends on the Windows API and SimpleMath
+#include <windows.h>
+#include <SimpleMath.h>
+
+using namespace DirectX::SimpleMath;
+
+namespace PointCloudEngine
+{
+	// Morton codes interleave the bits of the x, y and z grid coordinates (x in the lowest bit)
+	// Sorting by the code keeps points of the same voxel together on every level of the hierarchy
+	namespace Morton
+	{
+		const UINT maxBits = 21;
+
+		// Inserts two zero bits between each of the lowest 21 bits
+		inline UINT64 SpreadBits(UINT value)
+		{
+			UINT64 x = value & 0x1FFFFF;
+			x = (x | (x << 32)) & 0x1F00000000FFFFULL;
+			x = (x | (x << 16)) & 0x1F0000FF0000FFULL;
+			x = (x | (x << 8)) & 0x100F00F00F00F00FULL;
+			x = (x | (x << 4)) & 0x10C30C30C30C30C3ULL;
+			x = (x | (x << 2)) & 0x1249249249249249ULL;
+
+			return x;
+		}
+
+		// Inverse of SpreadBits, collects every third bit
+		inline UINT CompactBits(UINT64 value)
+		{
+			UINT64 x = value & 0x1249249249249249ULL;
+			x = (x | (x >> 2)) & 0x10C30C30C30C30C3ULL;
+			x = (x | (x >> 4)) & 0x100F00F00F00F00FULL;
+			x = (x | (x >> 8)) & 0x1F0000FF0000FFULL;
+			x = (x | (x >> 16)) & 0x1F00000000FFFFULL;
+			x = (x | (x >> 32)) & 0x1FFFFF;
+
+			return (UINT)x;
+		}
+
+		inline UINT64 Encode(UINT x, UINT y, UINT z)
+		{
+			return SpreadBits(x) | (SpreadBits(y) << 1) | (SpreadBits(z) << 2);
+		}
+
+		inline void Decode(UINT64 code, UINT& outX, UINT& outY, UINT& outZ)
+		{
+			outX = CompactBits(code);
+			outY = CompactBits(code >> 1);
+			outZ = CompactBits(code >> 2);
+		}
+
+		// Quantizes the position to a grid with 2^bits cells per axis inside the cube and returns the code of its cell
+		inline UINT64 Encode(const Vector3& position, const Vector3& cubeMin, float cubeSize, UINT bits)
+		{
+			float scale = (cubeSize > 0) ? (1 << bits) / cubeSize : 0;
+			UINT maxCell = (1 << bits) - 1;
+			Vector3 cell = (position - cubeMin) * scale;
+
+			UINT x = (UINT)min(max(cell.x, 0.0f), (float)maxCell);
+			UINT y = (UINT)min(max(cell.y, 0.0f), (float)maxCell);
+			UINT z = (UINT)min(max(cell.z, 0.0f), (float)maxCell);
+
+			return Encode(x, y, z);
+		}
+	}
+}
+
+#endif
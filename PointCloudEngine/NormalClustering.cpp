@@ -0,0 +1,364 @@
+#include "NormalClustering.h"
+
+UINT PointCloudEngine::NormalClustering::Cluster(const float* x, const float* y, const float* z, UINT64 count, UINT maxIterations, bool kMeansPlusPlus, Vector3 outMeans[maxClusters], UINT64 outCounts[maxClusters], byte* outClusters)
+{
+	const UINT meanCount = (UINT)min(count, (UINT64)maxClusters);
+
+	for (UINT i = 0; i < maxClusters; i++)
+	{
+		outMeans[i] = Vector3::Zero;
+		outCounts[i] = 0;
+	}
+
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	if (kMeansPlusPlus)
+	{
+		ChooseMeansPlusPlus(x, y, z, count, meanCount, outMeans);
+	}
+	else
+	{
+		for (UINT i = 0; i < meanCount; i++)
+		{
+			outMeans[i] = Vector3(x[i], y[i], z[i]);
+		}
+	}
+
+	// Sums of the x, y, z components and the number of normals of each cluster in each block
+	UINT64 blockCount = (count + blockSize - 1) / blockSize;
+	std::vector<double> blockSums(blockCount * maxClusters * 4);
+	memset(outClusters, 0, count);
+
+	UINT iteration = 0;
+	bool meanChanged = true;
+
+	while (meanChanged && iteration < max(maxIterations, 1U))
+	{
+		iteration++;
+
+		ThreadPool::Get().ParallelFor(blockCount, 1, [&](UINT64 start, UINT64 end)
+		{
+			for (UINT64 block = start; block < end; block++)
+			{
+				UINT64 blockStart = block * blockSize;
+				UINT64 blockEnd = min(blockStart + blockSize, count);
+				double* sums = blockSums.data() + block * maxClusters * 4;
+
+				AssignClustersBest(x + blockStart, y + blockStart, z + blockStart, blockEnd - blockStart, outMeans, meanCount, outClusters + blockStart);
+				memset(sums, 0, maxClusters * 4 * sizeof(double));
+
+				for (UINT64 i = blockStart; i < blockEnd; i++)
+				{
+					double* sum = sums + outClusters[i] * 4;
+					sum[0] += x[i];
+					sum[1] += y[i];
+					sum[2] += z[i];
+					sum[3] += 1;
+				}
+			}
+		});
+
+		// Calculate the new means from the normals in each cluster
+		double sums[maxClusters * 4] = {};
+
+		for (UINT64 block = 0; block < blockCount; block++)
+		{
+			for (UINT i = 0; i < maxClusters * 4; i++)
+			{
+				sums[i] += blockSums[block * maxClusters * 4 + i];
+			}
+		}
+
+		meanChanged = false;
+
+		for (UINT i = 0; i < meanCount; i++)
+		{
+			outCounts[i] = (UINT64)sums[i * 4 + 3];
+
+			// Empty clusters keep their mean
+			if (outCounts[i] > 0)
+			{
+				Vector3 newMean((float)(sums[i * 4] / outCounts[i]), (float)(sums[i * 4 + 1] / outCounts[i]), (float)(sums[i * 4 + 2] / outCounts[i]));
+
+				if (Vector3::DistanceSquared(outMeans[i], newMean) > FLT_EPSILON)
+				{
+					meanChanged = true;
+				}
+
+				outMeans[i] = newMean;
+			}
+		}
+	}
+
+	return iteration;
+}
+
+void PointCloudEngine::NormalClustering::AssignClustersBest(const float* x, const float* y, const float* z, UINT64 count, const Vector3* means, UINT meanCount, byte* clusters)
+{
+	if (SIMD::SupportsAVX2())
+	{
+		AssignClustersAVX2(x, y, z, count, means, meanCount, clusters);
+	}
+	else
+	{
+		AssignClustersScalar(x, y, z, count, means, meanCount, clusters);
+	}
+}
+
+void PointCloudEngine::NormalClustering::AssignClustersScalar(const float* x, const float* y, const float* z, UINT64 count, const Vector3* means, UINT meanCount, byte* clusters)
+{
+	for (UINT64 i = 0; i < count; i++)
+	{
+		float distances[maxClusters];
+
+		for (UINT j = 0; j < meanCount; j++)
+		{
+			float dx = x[i] - means[j].x;
+			float dy = y[i] - means[j].y;
+			float dz = z[i] - means[j].z;
+			distances[j] = (dx * dx + dy * dy) + dz * dz;
+		}
+
+		byte cluster = clusters[i];
+		float minDistance = distances[cluster];
+
+		for (UINT j = 0; j < meanCount; j++)
+		{
+			if (distances[j] < minDistance)
+			{
+				cluster = j;
+				minDistance = distances[j];
+			}
+		}
+
+		clusters[i] = cluster;
+	}
+}
+
+void PointCloudEngine::NormalClustering::AssignClustersAVX2(const float* x, const float* y, const float* z, UINT64 count, const Vector3* means, UINT meanCount, byte* clusters)
+{
+	__m256 meanX[maxClusters], meanY[maxClusters], meanZ[maxClusters];
+
+	for (UINT j = 0; j < meanCount; j++)
+	{
+		meanX[j] = _mm256_set1_ps(means[j].x);
+		meanY[j] = _mm256_set1_ps(means[j].y);
+		meanZ[j] = _mm256_set1_ps(means[j].z);
+	}
+
+	UINT64 i = 0;
+
+	// Eight normals at once, the clusters are widened to 32 bit lanes for the comparisons
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 normalX = _mm256_loadu_ps(x + i);
+		__m256 normalY = _mm256_loadu_ps(y + i);
+		__m256 normalZ = _mm256_loadu_ps(z + i);
+		__m256 distances[maxClusters];
+
+		for (UINT j = 0; j < meanCount; j++)
+		{
+			__m256 dx = _mm256_sub_ps(normalX, meanX[j]);
+			__m256 dy = _mm256_sub_ps(normalY, meanY[j]);
+			__m256 dz = _mm256_sub_ps(normalZ, meanZ[j]);
+			distances[j] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+		}
+
+		__m256i cluster = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(clusters + i)));
+		__m256 minDistance = distances[0];
+
+		// Start with the distance to the current cluster
+		for (UINT j = 1; j < meanCount; j++)
+		{
+			__m256 current = _mm256_castsi256_ps(_mm256_cmpeq_epi32(cluster, _mm256_set1_epi32(j)));
+			minDistance = _mm256_blendv_ps(minDistance, distances[j], current);
+		}
+
+		for (UINT j = 0; j < meanCount; j++)
+		{
+			__m256 closer = _mm256_cmp_ps(distances[j], minDistance, _CMP_LT_OQ);
+			minDistance = _mm256_blendv_ps(minDistance, distances[j], closer);
+			cluster = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(cluster), _mm256_castsi256_ps(_mm256_set1_epi32(j)), closer));
+		}
+
+		// Narrow the 32 bit lanes back to bytes
+		__m128i cluster16 = _mm_packus_epi32(_mm256_castsi256_si128(cluster), _mm256_extracti128_si256(cluster, 1));
+		_mm_storel_epi64((__m128i*)(clusters + i), _mm_packus_epi16(cluster16, cluster16));
+	}
+
+	// Avoid the penalty of mixing the upper ymm state with legacy SSE instructions
+	_mm256_zeroupper();
+
+	AssignClustersScalar(x + i, y + i, z + i, count - i, means, meanCount, clusters + i);
+}
+
+void PointCloudEngine::NormalClustering::Merge(const ClusterSummary* summaries, UINT summaryCount, UINT maxIterations, ClusterSummary& outSummary)
+{
+	// Gather the non empty child clusters as weighted normals
+	const UINT maxCount = 8 * maxClusters;
+	float x[maxCount], y[maxCount], z[maxCount];
+	const ClusterSummary* sources[maxCount];
+	UINT sourceClusters[maxCount];
+	UINT count = 0;
+
+	for (UINT i = 0; i < summaryCount; i++)
+	{
+		for (UINT j = 0; j < maxClusters; j++)
+		{
+			if (summaries[i].counts[j] > 0 && count < maxCount)
+			{
+				x[count] = summaries[i].means[j].x;
+				y[count] = summaries[i].means[j].y;
+				z[count] = summaries[i].means[j].z;
+				sources[count] = &summaries[i];
+				sourceClusters[count] = j;
+				count++;
+			}
+		}
+	}
+
+	const UINT meanCount = min(count, maxClusters);
+	byte clusters[maxCount] = {};
+	ZeroMemory(&outSummary, sizeof(ClusterSummary));
+
+	for (UINT i = 0; i < meanCount; i++)
+	{
+		outSummary.means[i] = Vector3(x[i], y[i], z[i]);
+	}
+
+	UINT iteration = 0;
+	bool meanChanged = true;
+
+	while (meanChanged && iteration < max(maxIterations, 1U))
+	{
+		iteration++;
+		AssignClustersScalar(x, y, z, count, outSummary.means, meanCount, clusters);
+
+		double sums[maxClusters * 4] = {};
+
+		for (UINT i = 0; i < count; i++)
+		{
+			double weight = (double)sources[i]->counts[sourceClusters[i]];
+			double* sum = sums + clusters[i] * 4;
+			sum[0] += weight * x[i];
+			sum[1] += weight * y[i];
+			sum[2] += weight * z[i];
+			sum[3] += weight;
+		}
+
+		meanChanged = false;
+
+		for (UINT i = 0; i < meanCount; i++)
+		{
+			if (sums[i * 4 + 3] > 0)
+			{
+				Vector3 newMean((float)(sums[i * 4] / sums[i * 4 + 3]), (float)(sums[i * 4 + 1] / sums[i * 4 + 3]), (float)(sums[i * 4 + 2] / sums[i * 4 + 3]));
+
+				if (Vector3::DistanceSquared(outSummary.means[i], newMean) > FLT_EPSILON)
+				{
+					meanChanged = true;
+				}
+
+				outSummary.means[i] = newMean;
+			}
+		}
+	}
+
+	// Add up the counts and colors and bound the cones with the angle between the means plus the cone of the child cluster
+	for (UINT i = 0; i < count; i++)
+	{
+		UINT64 weight = sources[i]->counts[sourceClusters[i]];
+		outSummary.counts[clusters[i]] += weight;
+
+		for (int channel = 0; channel < 3; channel++)
+		{
+			outSummary.colors[clusters[i]][channel] += weight * sources[i]->colors[sourceClusters[i]][channel];
+		}
+	}
+
+	for (UINT i = 0; i < meanCount; i++)
+	{
+		if (outSummary.counts[i] > 0)
+		{
+			for (int channel = 0; channel < 3; channel++)
+			{
+				outSummary.colors[i][channel] /= outSummary.counts[i];
+			}
+		}
+	}
+
+	Vector3 normalizedMeans[maxClusters];
+
+	for (UINT i = 0; i < meanCount; i++)
+	{
+		normalizedMeans[i] = outSummary.means[i];
+		normalizedMeans[i].Normalize();
+	}
+
+	for (UINT i = 0; i < count; i++)
+	{
+		Vector3 childMean(x[i], y[i], z[i]);
+		float angle = XM_PI;
+
+		// The average of opposite normals has no direction, then the cone covers everything
+		if (childMean.LengthSquared() > 0)
+		{
+			childMean.Normalize();
+			angle = min(XM_PI, acos(max(-1.0f, min(1.0f, normalizedMeans[clusters[i]].Dot(childMean)))) + sources[i]->cones[sourceClusters[i]]);
+		}
+
+		outSummary.cones[clusters[i]] = max(outSummary.cones[clusters[i]], angle);
+	}
+}
+
+void PointCloudEngine::NormalClustering::ChooseMeansPlusPlus(const float* x, const float* y, const float* z, UINT64 count, UINT meanCount, Vector3* outMeans)
+{
+	std::mt19937_64 generator(count);
+	std::vector<float> minDistances(count, FLT_MAX);
+	UINT64 chosen = 0;
+
+	for (UINT j = 0; j < meanCount; j++)
+	{
+		outMeans[j] = Vector3(x[chosen], y[chosen], z[chosen]);
+
+		if (j + 1 == meanCount)
+		{
+			break;
+		}
+
+		double distanceSum = 0;
+
+		for (UINT64 i = 0; i < count; i++)
+		{
+			float dx = x[i] - outMeans[j].x;
+			float dy = y[i] - outMeans[j].y;
+			float dz = z[i] - outMeans[j].z;
+			minDistances[i] = min(minDistances[i], (dx * dx + dy * dy) + dz * dz);
+			distanceSum += minDistances[i];
+		}
+
+		// All normals are already at a mean, continue with the next normal like the default initialization
+		if (distanceSum <= 0)
+		{
+			chosen = j + 1;
+			continue;
+		}
+
+		double threshold = std::uniform_real_distribution<double>(0, distanceSum)(generator);
+		chosen = count - 1;
+
+		for (UINT64 i = 0; i < count; i++)
+		{
+			threshold -= minDistances[i];
+
+			if (threshold < 0)
+			{
+				chosen = i;
+				break;
+			}
+		}
+	}
+}
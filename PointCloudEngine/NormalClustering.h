@@ -0,0 +1,55 @@
+#ifndef NORMALCLUSTERING_H
+#define NORMALCLUSTERING_H
+
+#pragma once
+#include "PointCloudEngine.h"
+
+namespace PointCloudEngine
+{
+	// Clusters of a node before they are quantized into the node properties, the bottom up builder merges them into the clusters of the parent
+	// The means are the average normals (not normalized) and the cones are the largest angles to the normalized means
+	struct ClusterSummary
+	{
+		Vector3 means[4];
+		float cones[4];
+		double colors[4][3];
+		UINT64 counts[4];
+	};
+
+	// k-means clustering of the normals of an octree node into at most four clusters (see ClusterNormal)
+	// The normals are stored as separate x, y and z arrays and each one is assigned to the mean with the smallest squared distance
+	// Large nodes are split into blocks of a fixed size whose sums are added in order, the result does not depend on the number of threads
+	class NormalClustering
+	{
+	public:
+		static const UINT maxClusters = 4;
+
+		// Increased whenever the clusters of the same normals change, it is part of the key of the cached octree files
+		// Version 1 summed the normals as floats, version 2 sums them as doubles in blocks and compares squared distances
+		static const UINT version = 2;
+
+		// Number of normals that are assigned and summed up by one task
+		static const UINT64 blockSize = 64 * 1024;
+
+		// Writes the cluster of each normal, the means (not normalized) and the number of normals in each cluster, returns the number of iterations
+		// The first normals are the initial means unless k-means++ is used, the iterations stop when no mean moves anymore or after maxIterations
+		static UINT Cluster(const float* x, const float* y, const float* z, UINT64 count, UINT maxIterations, bool kMeansPlusPlus, Vector3 outMeans[maxClusters], UINT64 outCounts[maxClusters], byte* outClusters);
+
+		// Single threaded assignment kernels, a normal stays in its cluster unless another mean is strictly closer (the first of the closest ones)
+		// The vectorized kernel computes the same squared distances as the scalar one, therefore both assign exactly the same clusters
+		static void AssignClustersBest(const float* x, const float* y, const float* z, UINT64 count, const Vector3* means, UINT meanCount, byte* clusters);
+		static void AssignClustersScalar(const float* x, const float* y, const float* z, UINT64 count, const Vector3* means, UINT meanCount, byte* clusters);
+		static void AssignClustersAVX2(const float* x, const float* y, const float* z, UINT64 count, const Vector3* means, UINT meanCount, byte* clusters);
+
+		// Clusters the clusters of the children with k-means where each one has the weight of its normal count, the first ones are the initial means
+		// The means, counts and colors are exact averages of the normals in the subtree, the cones are upper bounds from the child cones
+		static void Merge(const ClusterSummary* summaries, UINT summaryCount, UINT maxIterations, ClusterSummary& outSummary);
+
+	private:
+		// Picks each next mean with a probability proportional to the squared distance to the closest chosen mean
+		// The random numbers have a fixed seed, therefore the octree is the same every time it is built
+		static void ChooseMeansPlusPlus(const float* x, const float* y, const float* z, UINT64 count, UINT meanCount, Vector3* outMeans);
+	};
+}
+
+#endif
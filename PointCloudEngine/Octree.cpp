@@ -2,57 +2,35 @@
 
 PointCloudEngine::Octree::Octree(const std::wstring &pointcloudFile)
 {
-    if (!LoadFromOctreeFile())
+    if (!LoadFromOctreeFile(pointcloudFile))
     {
-        // Try to load .pointcloud file here
-        std::vector<Vertex> vertices;
-
-        if (!LoadPointcloudFile(vertices, rootPosition, rootSize, pointcloudFile))
+        // Point clouds that do not fit into the memory limit (in MB) are partitioned into temporary files in the Octrees folder
+        // Their names contain the cache key and the process id, other instances can build octrees at the same time
+        if (settings->octreeMemoryLimit > 0)
         {
-            throw std::exception("Could not load .pointcloud file!");
+            CreateDirectory((executableDirectory + L"/Octrees").c_str(), NULL);
+            OutOfCoreOctreeBuilder::Build(pointcloudFile, octreeFilepath + L"." + std::to_wstring(GetCurrentProcessId()), settings->octreeMemoryLimit * 1024ULL * 1024ULL, settings->octreeBuildMode, rootPosition, rootSize, nodes);
+            SaveToOctreeFile();
+            return;
         }
 
-		// Stores the indices in the nodes array of the children of a node
-		// Will only be used while creating the octree (for simplicity)
-		// Finding the correct child index is easier this way
-		std::vector<UINT> children;
-
-        // Stores the nodes that should be created for each octree level
-        std::queue<OctreeNodeCreationEntry> nodeCreationQueue;
+        // Try to map the .pointcloud file here
+        PointcloudFile pointcloud;
 
-        OctreeNodeCreationEntry rootEntry;
-        rootEntry.nodesIndex = UINT_MAX;
-        rootEntry.childrenIndex = UINT_MAX;
-        rootEntry.vertices = vertices;
-        rootEntry.position = rootPosition;
-        rootEntry.size = rootSize;
-        rootEntry.depth = 0;
-
-        nodeCreationQueue.push(rootEntry);
-
-        while (!nodeCreationQueue.empty())
+        if (!pointcloud.Open(pointcloudFile))
         {
-            // Remove the first entry from the queue
-            OctreeNodeCreationEntry first = nodeCreationQueue.front();
-            nodeCreationQueue.pop();
+            throw std::exception("Could not load .pointcloud file!");
+        }
 
-            // Assign the index at which this node will be stored
-            first.nodesIndex = nodes.size();
+        rootPosition = pointcloud.boundingCubePosition;
+        rootSize = pointcloud.boundingCubeSize;
 
-            // Create the nodes and fill the queue
-            nodes.push_back(OctreeNode(nodeCreationQueue, nodes, children, first));
-        }
+        // Decode the mapped records once and move them into the builder
+        std::vector<Vertex> vertices(pointcloud.vertexCount);
+        pointcloud.DecodeVertices(0, pointcloud.vertexCount, vertices.data());
+        pointcloud.Close();
 
-		// Now the nodes actually store the childrenStartOrLeafPositionFactors index for the children array instead of the nodes array
-		for (auto it = nodes.begin(); it != nodes.end(); it++)
-		{
-			// Overwrite the index with one that is referencing the nodes array (that's fine because the nodes array stores children after each other and in order)
-			// Then there is no need to store the children array anymore
-			if (it->properties.childrenMask != 0)
-			{
-				it->childrenStartOrLeafPositionFactors = children[it->childrenStartOrLeafPositionFactors];
-			}
-		}
+        OctreeBuilder::Build(settings->octreeBuildMode, std::move(vertices), rootPosition, rootSize, nodes);
 
         // Save the generated octree in a file
         SaveToOctreeFile();
@@ -90,33 +68,82 @@ std::vector<OctreeNodeVertex> PointCloudEngine::Octree::GetVertices(const Octree
     return octreeVertices;
 }
 
-bool PointCloudEngine::Octree::LoadFromOctreeFile()
+bool PointCloudEngine::Octree::LoadFromOctreeFile(const std::wstring &pointcloudFile)
 {
     // Try to load a previously saved octree file first before recreating the whole octree (saves a lot of time)
-    std::wstring filename = settings->pointcloudFile.substr(settings->pointcloudFile.find_last_of(L"\\/") + 1, settings->pointcloudFile.length());
-    filename = filename.substr(0, filename.length() - 11);
-    octreeFilepath = executableDirectory + L"/Octrees/" + filename + L".octree";
+    // The file name contains the cache key, changing the point cloud or the settings creates a new file instead of loading an outdated octree
+    if (!GetCacheKey(pointcloudFile, cacheKey))
+    {
+        throw std::exception("Could not load .pointcloud file!");
+    }
+
+    std::wstring filename = pointcloudFile.substr(pointcloudFile.find_last_of(L"\\/") + 1);
+    filename = filename.substr(0, filename.find_last_of(L'.'));
+
+    wchar_t key[17];
+    swprintf_s(key, L"%016llx", cacheKey);
+    octreeFilepath = executableDirectory + L"/Octrees/" + filename + L"_" + key + L".octree";
 
     // Try to load the octree from a file
     std::ifstream octreeFile(octreeFilepath, std::ios::in | std::ios::binary);
 
-    // Only save the data when the file doesn't exist already
+    // Missing or invalid files are generated again, SaveToOctreeFile then replaces them with a single rename
     if (octreeFile.is_open())
     {
-		// Read the root position as the first entry
+		// Files without the magic number and version have a 32 bit node count and are generated again
+		UINT magic = 0, version = 0;
+		UINT64 fileKey = 0;
+		octreeFile.read((char*)&magic, sizeof(UINT));
+		octreeFile.read((char*)&version, sizeof(UINT));
+		octreeFile.read((char*)&fileKey, sizeof(UINT64));
+
+		if (!octreeFile || magic != octreeMagic || version != octreeVersion || fileKey != cacheKey)
+		{
+			return false;
+		}
+
+		// Read the root position
 		octreeFile.read((char*)&rootPosition, sizeof(Vector3));
 
 		// Then the root size
 		octreeFile.read((char*)&rootSize, sizeof(float));
 
         // Load the size of the nodes vector
-        UINT nodesSize;
-        octreeFile.read((char*)&nodesSize, sizeof(UINT));
+        UINT64 nodesSize = 0;
+        octreeFile.read((char*)&nodesSize, sizeof(UINT64));
+
+        // Reject truncated files before allocating the nodes
+        std::streamoff nodesOffset = octreeFile.tellg();
+        octreeFile.seekg(0, std::ios::end);
+
+        if (!octreeFile || nodesSize > UINT_MAX || (UINT64)((std::streamoff)octreeFile.tellg() - nodesOffset) != nodesSize * sizeof(OctreeNode))
+        {
+            return false;
+        }
 
         // Read the binary data directly into the nodes vector
+        octreeFile.seekg(nodesOffset);
         nodes.resize(nodesSize);
         octreeFile.read((char*)nodes.data(), nodesSize * sizeof(OctreeNode));
 
+        if (!octreeFile)
+        {
+            return false;
+        }
+
+        octreeFile.close();
+
+        // Mark the file as recently used by updating its last write time, the eviction deletes the files that were not used for the longest time
+        HANDLE file = CreateFile(octreeFilepath.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            FILETIME now;
+            GetSystemTimeAsFileTime(&now);
+            SetFileTime(file, NULL, NULL, &now);
+            CloseHandle(file);
+        }
+
         // Stop here after loading the file
         return true;
     }
@@ -126,30 +153,173 @@ bool PointCloudEngine::Octree::LoadFromOctreeFile()
 
 void PointCloudEngine::Octree::SaveToOctreeFile()
 {
-    // Try to open a previously saved file
-    std::wifstream file(octreeFilepath);
+    // This is only called when no valid octree file could be loaded, an invalid file with the same name is replaced
+    // Save the octree in a file inside a new folder
+    CreateDirectory((executableDirectory + L"/Octrees").c_str(), NULL);
+
+    // Write into a temporary file of this process first and rename it afterwards, other instances only ever see complete octree files
+    std::wstring temporaryFilepath = octreeFilepath + L"." + std::to_wstring(GetCurrentProcessId()) + L".tmp";
+    std::ofstream octreeFile(temporaryFilepath, std::ios::out | std::ios::binary | std::ios::trunc);
+
+	// Write the magic number, version and cache key
+	UINT magic = octreeMagic, version = octreeVersion;
+	octreeFile.write((char*)&magic, sizeof(UINT));
+	octreeFile.write((char*)&version, sizeof(UINT));
+	octreeFile.write((char*)&cacheKey, sizeof(UINT64));
+
+	// Then the root position
+	octreeFile.write((char*)&rootPosition, sizeof(Vector3));
+
+	// Then the root size
+	octreeFile.write((char*)&rootSize, sizeof(float));
 
-    // Only save the data when the file doesn't exist already
-    if (!file.is_open())
+    // Write the size of the nodes vector
+    UINT64 nodesSize = nodes.size();
+    octreeFile.write((char*)&nodesSize, sizeof(UINT64));
+
+    // Write the nodes data in binary format
+    octreeFile.write((char*)nodes.data(), nodesSize * sizeof(OctreeNode));
+
+    octreeFile.flush();
+    bool written = (bool)octreeFile;
+    octreeFile.close();
+
+    // Incomplete files (e.g. when the disk is full) are discarded, the octree is generated again next time
+    if (!written || !MoveFileEx(temporaryFilepath.c_str(), octreeFilepath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
     {
-        // Save the octree in a file inside a new folder
-        CreateDirectory((executableDirectory + L"/Octrees").c_str(), NULL);
-        std::ofstream octreeFile(octreeFilepath, std::ios::out | std::ios::binary);
+        DeleteFile(temporaryFilepath.c_str());
+        return;
+    }
 
-		// Write the root position
-		octreeFile.write((char*)&rootPosition, sizeof(Vector3));
+    EvictOctreeFiles();
+}
 
-		// Then the root size
-		octreeFile.write((char*)&rootSize, sizeof(float));
+bool PointCloudEngine::Octree::GetCacheKey(const std::wstring &pointcloudFile, UINT64 &outCacheKey)
+{
+    MappedFile file;
 
-        // Write the size of the nodes vector
-        UINT nodesSize = nodes.size();
-        octreeFile.write((char*)&nodesSize, sizeof(UINT));
+    if (!file.Open(pointcloudFile))
+    {
+        return false;
+    }
 
-        // Write the nodes data in binary format
-        octreeFile.write((char*)nodes.data(), nodesSize * sizeof(OctreeNode));
+    UINT64 size = file.GetSize();
+    std::vector<UINT64> hashes;
 
-        octreeFile.flush();
-        octreeFile.close();
+    // Only the header and the chunk directory are needed, compressed chunks are not decompressed
+    PointcloudFile pointcloud;
+
+    if (!pointcloud.Open(pointcloudFile, false))
+    {
+        return false;
+    }
+
+    if (pointcloud.flags & pointcloudFlagChecksums)
+    {
+        // The checksums in the chunk directory already cover the vertex data, the header and the directory are hashed instead of the whole contents
+        // The splat radii after the directory are not covered, the nodes do not depend on them
+        hashes.push_back(Hash::XXHash64(file.GetData(), pointcloud.dataOffset));
+        hashes.push_back(Hash::XXHash64(pointcloud.chunks.data(), pointcloud.chunks.size() * sizeof(PointcloudChunk)));
+    }
+    else
+    {
+        // Hash the whole contents in blocks of a fixed size, the key does not depend on the number of threads
+        UINT64 blockCount = (size + hashBlockSize - 1) / hashBlockSize;
+        hashes.resize(blockCount);
+
+        ThreadPool::Get().ParallelFor(blockCount, 1, [&](UINT64 start, UINT64 end)
+        {
+            for (UINT64 i = start; i < end; i++)
+            {
+                UINT64 offset = i * hashBlockSize;
+                hashes[i] = Hash::XXHash64(file.GetData() + offset, min(hashBlockSize, size - offset), i);
+            }
+        });
+    }
+
+    pointcloud.Close();
+
+    // The queue, morton and subtree builders create the same nodes, only the bottom up builder creates different ones
+    UINT64 buildMode = (settings->octreeBuildMode == OctreeBuildMode::Aggregate) ? 1 : 0;
+
+    hashes.push_back(size);
+    hashes.push_back((UINT64)settings->maxOctreeDepth);
+    hashes.push_back(buildMode);
+    hashes.push_back(settings->maxClusterIterations);
+    hashes.push_back(settings->useKMeansPlusPlus ? 1 : 0);
+    hashes.push_back(NormalClustering::version);
+    hashes.push_back(settings->octreeMemoryLimit);
+    hashes.push_back(sizeof(OctreeNode));
+
+    outCacheKey = Hash::XXHash64(hashes.data(), hashes.size() * sizeof(UINT64));
+
+    return true;
+}
+
+void PointCloudEngine::Octree::EvictOctreeFiles() const
+{
+    // A cache size of 0 keeps all the files
+    if (settings->octreeCacheSize == 0)
+    {
+        return;
+    }
+
+    struct CachedFile
+    {
+        std::wstring path;
+        UINT64 size;
+        UINT64 lastUsed;
+    };
+
+    std::wstring directory = executableDirectory + L"/Octrees/";
+    std::vector<CachedFile> files;
+    WIN32_FIND_DATA findData;
+    HANDLE find = FindFirstFile((directory + L"*.octree").c_str(), &findData);
+
+    if (find == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+
+    do
+    {
+        if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        {
+            UINT64 size = ((UINT64)findData.nFileSizeHigh << 32) | findData.nFileSizeLow;
+            UINT64 lastUsed = ((UINT64)findData.ftLastWriteTime.dwHighDateTime << 32) | findData.ftLastWriteTime.dwLowDateTime;
+            files.push_back({ directory + findData.cFileName, size, lastUsed });
+        }
+    } while (FindNextFile(find, &findData));
+
+    FindClose(find);
+
+    // Keep the most recently used files and delete the rest once the cache size is exceeded
+    std::sort(files.begin(), files.end(), [](const CachedFile &a, const CachedFile &b) { return a.lastUsed > b.lastUsed; });
+
+    // The current file counts first since it is never deleted
+    UINT64 cacheSize = settings->octreeCacheSize * 1024ULL * 1024ULL;
+    UINT64 usedSize = 0;
+
+    for (const CachedFile &file : files)
+    {
+        if (file.path == octreeFilepath)
+        {
+            usedSize += file.size;
+        }
+    }
+
+    for (const CachedFile &file : files)
+    {
+        if (file.path == octreeFilepath)
+        {
+            continue;
+        }
+
+        usedSize += file.size;
+
+        if (usedSize > cacheSize)
+        {
+            DeleteFile(file.path.c_str());
+        }
     }
 }
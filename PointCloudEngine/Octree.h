@@ -12,7 +12,7 @@ namespace PointCloudEngine
         Octree(const std::wstring &pointcloudFile);
 
         std::vector<OctreeNodeVertex> GetVertices(const OctreeConstantBuffer &octreeConstantBufferData) const;
-        bool LoadFromOctreeFile();
+        bool LoadFromOctreeFile(const std::wstring &pointcloudFile);
         void SaveToOctreeFile();
 
         // Stores the hole octree, the root is the first element then all the children of the root node follow and so on
@@ -21,7 +21,24 @@ namespace PointCloudEngine
 		float rootSize = 0;
 
 	private:
+		// Octree files start with the magic number, version and cache key followed by the root position, root size and the 64 bit number of nodes
+		// Older files without a header or with another key are generated again
+		static const UINT octreeMagic = 0xFFFF4F43;
+		static const UINT octreeVersion = 3;
+
+		// Blocks of the .pointcloud file that are hashed in parallel
+		static const UINT64 hashBlockSize = 16 * 1024 * 1024;
+
 		std::wstring octreeFilepath;
+		UINT64 cacheKey = 0;
+
+		// Hash of the .pointcloud file contents and size together with all the settings that change the nodes, also part of the file name
+		// Files with chunk checksums only hash their header and chunk directory, the checksums stand in for the vertex data
+		// Returns false if the .pointcloud file cannot be mapped or is invalid
+		static bool GetCacheKey(const std::wstring &pointcloudFile, UINT64 &outCacheKey);
+
+		// Deletes the least recently used octree files until the Octrees folder fits into the octreeCacheSize, the current file is always kept
+		void EvictOctreeFiles() const;
     };
 }
 
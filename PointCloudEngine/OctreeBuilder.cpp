@@ -0,0 +1,518 @@
+#include "OctreeBuilder.h"
+
+void PointCloudEngine::OctreeBuilder::Build(OctreeBuildMode mode, std::vector<Vertex> vertices, const Vector3& rootPosition, float rootSize, std::vector<OctreeNode>& outNodes)
+{
+	Build(mode, std::move(vertices), rootPosition, rootSize, 0, outNodes);
+}
+
+void PointCloudEngine::OctreeBuilder::Build(OctreeBuildMode mode, std::vector<Vertex> vertices, const Vector3& rootPosition, float rootSize, UINT rootDepth, std::vector<OctreeNode>& outNodes)
+{
+	if (vertices.empty())
+	{
+		throw std::exception("Cannot create an octree without vertices!");
+	}
+
+	// The keys of the morton builder have 3 bits for each level
+	if ((mode == OctreeBuildMode::Morton || mode == OctreeBuildMode::Aggregate) && settings->maxOctreeDepth - (int)rootDepth <= (int)Morton::maxBits)
+	{
+		BuildMorton(vertices, rootPosition, rootSize, rootDepth, mode == OctreeBuildMode::Aggregate, outNodes);
+	}
+	else if (mode == OctreeBuildMode::Subtrees)
+	{
+		BuildSubtrees(vertices, rootPosition, rootSize, rootDepth, outNodes);
+	}
+	else
+	{
+		BuildQueue(vertices, rootPosition, rootSize, rootDepth, outNodes);
+	}
+}
+
+void PointCloudEngine::OctreeBuilder::BuildQueue(std::vector<Vertex>& vertices, const Vector3& rootPosition, float rootSize, UINT rootDepth, std::vector<OctreeNode>& outNodes)
+{
+	outNodes.clear();
+
+	// Stores the indices in the nodes array of the children of a node
+	// Will only be used while creating the octree (for simplicity)
+	// Finding the correct child index is easier this way
+	std::vector<UINT> children;
+
+	// Stores the nodes that should be created for each octree level
+	std::queue<OctreeNodeCreationEntry> nodeCreationQueue;
+	nodeCreationQueue.push(GetRootEntry(vertices, rootPosition, rootSize, rootDepth));
+
+	// The entries reference ranges of the vertices that are partitioned in place for the children
+	std::vector<Vertex> scratch(vertices.size());
+	std::vector<UINT64> levelStarts;
+
+	CreateNodes(nodeCreationQueue, outNodes, children, vertices, scratch, ~0ULL, levelStarts);
+	ResolveChildren(outNodes, children);
+}
+
+void PointCloudEngine::OctreeBuilder::BuildSubtrees(std::vector<Vertex>& vertices, const Vector3& rootPosition, float rootSize, UINT rootDepth, std::vector<OctreeNode>& outNodes)
+{
+	outNodes.clear();
+
+	std::vector<UINT> children;
+	std::queue<OctreeNodeCreationEntry> nodeCreationQueue;
+	nodeCreationQueue.push(GetRootEntry(vertices, rootPosition, rootSize, rootDepth));
+
+	std::vector<Vertex> scratch(vertices.size());
+	std::vector<UINT64> levelStarts;
+
+	// Create the top levels until there are enough subtrees to balance them between the threads
+	CreateNodes(nodeCreationQueue, outNodes, children, vertices, scratch, subtreesPerThread * ThreadPool::Get().GetThreadCount(), levelStarts);
+
+	// The remaining entries are the roots of the subtrees, they form the next level in breadth first order
+	std::vector<OctreeNodeCreationEntry> subtreeRoots;
+	UINT64 topNodeCount = outNodes.size();
+
+	while (!nodeCreationQueue.empty())
+	{
+		OctreeNodeCreationEntry subtreeRoot = nodeCreationQueue.front();
+		nodeCreationQueue.pop();
+
+		if (subtreeRoot.childrenIndex != UINT_MAX)
+		{
+			children[subtreeRoot.childrenIndex] = (UINT)(topNodeCount + subtreeRoots.size());
+		}
+
+		subtreeRoots.push_back(subtreeRoot);
+	}
+
+	ResolveChildren(outNodes, children);
+
+	// The subtrees partition disjoint vertex ranges, therefore they can be created independently with their own node arrays
+	std::vector<Subtree> subtrees(subtreeRoots.size());
+
+	ThreadPool::Get().ParallelFor(subtrees.size(), 1, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 i = start; i < end; i++)
+		{
+			std::vector<UINT> subtreeChildren;
+			std::queue<OctreeNodeCreationEntry> subtreeQueue;
+			subtreeQueue.push(subtreeRoots[i]);
+			subtreeQueue.front().childrenIndex = UINT_MAX;
+
+			CreateNodes(subtreeQueue, subtrees[i].nodes, subtreeChildren, vertices, scratch, ~0ULL, subtrees[i].levelStarts);
+			ResolveChildren(subtrees[i].nodes, subtreeChildren);
+			subtrees[i].levelStarts.push_back(subtrees[i].nodes.size());
+		}
+	});
+
+	// The nodes of each level are stored subtree after subtree, compute where each subtree starts in each level
+	UINT64 levelCount = 0;
+
+	for (auto it = subtrees.begin(); it != subtrees.end(); it++)
+	{
+		levelCount = max(levelCount, (UINT64)it->levelStarts.size() - 1);
+	}
+
+	UINT64 nodeCount = topNodeCount;
+
+	for (UINT64 level = 0; level < levelCount; level++)
+	{
+		for (auto it = subtrees.begin(); it != subtrees.end(); it++)
+		{
+			it->levelOffsets.push_back(nodeCount);
+
+			if (level + 1 < it->levelStarts.size())
+			{
+				nodeCount += it->levelStarts[level + 1] - it->levelStarts[level];
+			}
+		}
+	}
+
+	// The nodes reference their children with 32 bit indices on the GPU
+	if (nodeCount > UINT_MAX)
+	{
+		throw std::exception("Too many octree nodes, lower the maxOctreeDepth parameter!");
+	}
+
+	outNodes.resize(nodeCount);
+
+	// Copy the nodes of the subtrees to their breadth first positions and convert the indices of their children
+	ThreadPool::Get().ParallelFor(subtrees.size(), 1, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 i = start; i < end; i++)
+		{
+			Subtree& subtree = subtrees[i];
+
+			for (UINT64 level = 0; level + 1 < subtree.levelStarts.size(); level++)
+			{
+				for (UINT64 node = subtree.levelStarts[level]; node < subtree.levelStarts[level + 1]; node++)
+				{
+					OctreeNode& octreeNode = outNodes[subtree.levelOffsets[level] + node - subtree.levelStarts[level]];
+					octreeNode = subtree.nodes[node];
+
+					// The children of a node are in the next level
+					if (octreeNode.properties.childrenMask != 0)
+					{
+						octreeNode.childrenStartOrLeafPositionFactors = (UINT)(subtree.levelOffsets[level + 1] + octreeNode.childrenStartOrLeafPositionFactors - subtree.levelStarts[level + 1]);
+					}
+				}
+			}
+
+			subtree.nodes.clear();
+			subtree.nodes.shrink_to_fit();
+		}
+	});
+}
+
+OctreeNodeCreationEntry PointCloudEngine::OctreeBuilder::GetRootEntry(const std::vector<Vertex>& vertices, const Vector3& rootPosition, float rootSize, UINT rootDepth)
+{
+	OctreeNodeCreationEntry rootEntry;
+	rootEntry.nodesIndex = UINT_MAX;
+	rootEntry.childrenIndex = UINT_MAX;
+	rootEntry.begin = 0;
+	rootEntry.end = vertices.size();
+	rootEntry.position = rootPosition;
+	rootEntry.size = rootSize;
+	rootEntry.depth = (int)rootDepth;
+
+	return rootEntry;
+}
+
+void PointCloudEngine::OctreeBuilder::CreateNodes(std::queue<OctreeNodeCreationEntry>& nodeCreationQueue, std::vector<OctreeNode>& nodes, std::vector<UINT>& children, std::vector<Vertex>& vertices, std::vector<Vertex>& scratch, UINT64 stopEntryCount, std::vector<UINT64>& outLevelStarts)
+{
+	int depth = -1;
+
+	while (!nodeCreationQueue.empty())
+	{
+		// Stop at the start of a level, then the queue stores exactly the entries of this level
+		if (nodeCreationQueue.front().depth != depth)
+		{
+			if (nodeCreationQueue.size() >= stopEntryCount)
+			{
+				return;
+			}
+
+			depth = nodeCreationQueue.front().depth;
+			outLevelStarts.push_back(nodes.size());
+		}
+
+		// Remove the first entry from the queue
+		OctreeNodeCreationEntry first = nodeCreationQueue.front();
+		nodeCreationQueue.pop();
+
+		// The nodes reference their children with 32 bit indices on the GPU
+		if (nodes.size() >= UINT_MAX)
+		{
+			throw std::exception("Too many octree nodes, lower the maxOctreeDepth parameter!");
+		}
+
+		// Assign the index at which this node will be stored
+		first.nodesIndex = (UINT)nodes.size();
+
+		// Create the nodes and fill the queue
+		nodes.push_back(OctreeNode(nodeCreationQueue, nodes, children, vertices, scratch, first));
+	}
+}
+
+void PointCloudEngine::OctreeBuilder::ResolveChildren(std::vector<OctreeNode>& nodes, const std::vector<UINT>& children)
+{
+	// Now the nodes actually store the childrenStartOrLeafPositionFactors index for the children array instead of the nodes array
+	for (auto it = nodes.begin(); it != nodes.end(); it++)
+	{
+		// Overwrite the index with one that is referencing the nodes array (that's fine because the nodes array stores children after each other and in order)
+		// Then there is no need to store the children array anymore
+		if (it->properties.childrenMask != 0)
+		{
+			it->childrenStartOrLeafPositionFactors = children[it->childrenStartOrLeafPositionFactors];
+		}
+	}
+}
+
+void PointCloudEngine::OctreeBuilder::BuildMorton(const std::vector<Vertex>& vertices, const Vector3& rootPosition, float rootSize, UINT rootDepth, bool aggregate, std::vector<OctreeNode>& outNodes)
+{
+	const UINT64 vertexCount = vertices.size();
+	const UINT depth = max(settings->maxOctreeDepth - (int)rootDepth, 0);
+
+	std::vector<UINT64> keys(vertexCount);
+	std::vector<PointcloudIndex> order(vertexCount);
+
+	ThreadPool::Get().ParallelFor(vertexCount, 64 * 1024, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 i = start; i < end; i++)
+		{
+			Vector3 position = rootPosition;
+			float size = rootSize;
+			UINT64 key = 0;
+
+			for (UINT level = 0; level < depth; level++)
+			{
+				int childIndex = GetChildIndex(position, vertices[i].position);
+				key = (key << 3) | childIndex;
+				position = OctreeNode::GetChildPosition(position, size, childIndex);
+				size *= 0.5f;
+			}
+
+			keys[i] = key;
+			order[i] = (PointcloudIndex)i;
+		}
+	});
+
+	// The sort is stable, vertices with the same key stay in their original order
+	// Only the indices are sorted, the nodes read the vertices through them
+	RadixSort(keys, order, 3 * depth);
+
+	// Split the ranges top down, nodes with one vertex or at the max depth are leaves
+	std::vector<std::vector<MortonNode>> levels(1, std::vector<MortonNode>(1, { 0, vertexCount, 0, 0 }));
+	std::vector<UINT64> levelOffsets(1, 0);
+
+	for (UINT level = 0; level < depth; level++)
+	{
+		std::vector<MortonNode>& parents = levels[level];
+		UINT shift = 3 * (depth - level - 1);
+
+		ThreadPool::Get().ParallelFor(parents.size(), 1024, [&](UINT64 start, UINT64 end)
+		{
+			for (UINT64 i = start; i < end; i++)
+			{
+				MortonNode& parent = parents[i];
+
+				if (parent.end - parent.begin > 1)
+				{
+					UINT64 bounds[9];
+					GetChildBounds(keys, parent.begin, parent.end, shift, bounds);
+
+					for (int childIndex = 0; childIndex < 8; childIndex++)
+					{
+						if (bounds[childIndex + 1] > bounds[childIndex])
+						{
+							parent.childrenMask |= 1 << childIndex;
+						}
+					}
+				}
+			}
+		});
+
+		// The children of the parents follow each other in the next level
+		UINT64 childCount = 0;
+
+		for (auto it = parents.begin(); it != parents.end(); it++)
+		{
+			it->childrenStart = childCount;
+
+			for (int childIndex = 0; childIndex < 8; childIndex++)
+			{
+				childCount += (it->childrenMask >> childIndex) & 1;
+			}
+		}
+
+		if (childCount == 0)
+		{
+			break;
+		}
+
+		levelOffsets.push_back(levelOffsets.back() + parents.size());
+		levels.push_back(std::vector<MortonNode>(childCount));
+		std::vector<MortonNode>& children = levels.back();
+
+		// Adding the level can reallocate the outer vector, therefore the parents are referenced again
+		std::vector<MortonNode>& movedParents = levels[level];
+
+		ThreadPool::Get().ParallelFor(movedParents.size(), 1024, [&](UINT64 start, UINT64 end)
+		{
+			for (UINT64 i = start; i < end; i++)
+			{
+				const MortonNode& parent = movedParents[i];
+
+				if (parent.childrenMask != 0)
+				{
+					UINT64 bounds[9];
+					UINT64 child = parent.childrenStart;
+					GetChildBounds(keys, parent.begin, parent.end, shift, bounds);
+
+					for (int childIndex = 0; childIndex < 8; childIndex++)
+					{
+						if (bounds[childIndex + 1] > bounds[childIndex])
+						{
+							children[child++] = { bounds[childIndex], bounds[childIndex + 1], 0, 0 };
+						}
+					}
+				}
+			}
+		});
+	}
+
+	UINT64 nodeCount = levelOffsets.back() + levels.back().size();
+
+	// The nodes reference their children with 32 bit indices on the GPU
+	if (nodeCount > UINT_MAX)
+	{
+		throw std::exception("Too many octree nodes, lower the maxOctreeDepth parameter!");
+	}
+
+	outNodes.clear();
+	outNodes.resize(nodeCount);
+
+	// Create the nodes bottom up, then the children of a node already store their indices in the original order
+	// When aggregating, the indices of a leaf already are in their original order because they all have the same key
+	std::vector<PointcloudIndex> orderScratch(aggregate ? 0 : vertexCount);
+	std::vector<ClusterSummary> summaries, childSummaries;
+
+	for (int level = (int)levels.size() - 1; level >= 0; level--)
+	{
+		const std::vector<MortonNode>& levelNodes = levels[level];
+		childSummaries.swap(summaries);
+		summaries.resize(aggregate ? levelNodes.size() : 0);
+
+		ThreadPool::Get().ParallelFor(levelNodes.size(), 64, [&](UINT64 start, UINT64 end)
+		{
+			for (UINT64 i = start; i < end; i++)
+			{
+				const MortonNode& node = levelNodes[i];
+				OctreeNode& octreeNode = outNodes[levelOffsets[level] + i];
+
+				if (aggregate && node.childrenMask != 0)
+				{
+					UINT childCount = 0;
+
+					for (int childIndex = 0; childIndex < 8; childIndex++)
+					{
+						childCount += (node.childrenMask >> childIndex) & 1;
+					}
+
+					NormalClustering::Merge(childSummaries.data() + node.childrenStart, childCount, settings->maxClusterIterations, summaries[i]);
+					octreeNode.SetClusters(summaries[i]);
+					octreeNode.properties.childrenMask = node.childrenMask;
+					octreeNode.childrenStartOrLeafPositionFactors = (UINT)(levelOffsets[level + 1] + node.childrenStart);
+					continue;
+				}
+
+				if (node.childrenMask != 0)
+				{
+					MergeChildren(order, orderScratch, levels[level + 1], node);
+				}
+
+				// Follow the path of the key to compute the same cube as the queue builder
+				Vector3 position = rootPosition;
+				float size = rootSize;
+
+				for (int parentLevel = 0; parentLevel < level; parentLevel++)
+				{
+					int childIndex = (keys[node.begin] >> (3 * (depth - parentLevel - 1))) & 7;
+					position = OctreeNode::GetChildPosition(position, size, childIndex);
+					size *= 0.5f;
+				}
+
+				if (aggregate)
+				{
+					summaries[i] = OctreeNode::Summarize(vertices.data(), order.data() + node.begin, node.end - node.begin);
+					octreeNode.SetClusters(summaries[i]);
+					octreeNode.SetLeafPositionFactors(vertices.data(), order.data() + node.begin, node.end - node.begin, position, size);
+					continue;
+				}
+
+				octreeNode.Initialize(vertices.data(), order.data() + node.begin, node.end - node.begin, position, size, node.childrenMask == 0);
+
+				if (node.childrenMask != 0)
+				{
+					octreeNode.properties.childrenMask = node.childrenMask;
+					octreeNode.childrenStartOrLeafPositionFactors = (UINT)(levelOffsets[level + 1] + node.childrenStart);
+				}
+			}
+		});
+	}
+}
+
+int PointCloudEngine::OctreeBuilder::GetChildIndex(const Vector3& nodePosition, const Vector3& vertexPosition)
+{
+	// Same child order as in the OctreeNode constructor, the bits are set for the negative side of each axis
+	int childIndex = 0;
+	childIndex |= (vertexPosition.x > nodePosition.x) ? 0 : 4;
+	childIndex |= (vertexPosition.y > nodePosition.y) ? 0 : 2;
+	childIndex |= (vertexPosition.z > nodePosition.z) ? 0 : 1;
+
+	return childIndex;
+}
+
+void PointCloudEngine::OctreeBuilder::GetChildBounds(const std::vector<UINT64>& keys, UINT64 begin, UINT64 end, UINT shift, UINT64 outBounds[9])
+{
+	// All the keys of the range have the same digits above the shift
+	UINT64 prefix = keys[begin] & ~((8ULL << shift) - 1);
+
+	outBounds[0] = begin;
+	outBounds[8] = end;
+
+	for (int childIndex = 1; childIndex < 8; childIndex++)
+	{
+		outBounds[childIndex] = std::lower_bound(keys.begin() + outBounds[childIndex - 1], keys.begin() + end, prefix | ((UINT64)childIndex << shift)) - keys.begin();
+	}
+}
+
+void PointCloudEngine::OctreeBuilder::MergeRuns(const PointcloudIndex* order, UINT64 from[8], const UINT64 to[8], UINT runCount, PointcloudIndex* outOrder)
+{
+	while (true)
+	{
+		int smallest = -1;
+
+		for (UINT run = 0; run < runCount; run++)
+		{
+			if (from[run] < to[run] && (smallest < 0 || order[from[run]] < order[from[smallest]]))
+			{
+				smallest = run;
+			}
+		}
+
+		if (smallest < 0)
+		{
+			return;
+		}
+
+		*outOrder++ = order[from[smallest]++];
+	}
+}
+
+void PointCloudEngine::OctreeBuilder::MergeChildren(std::vector<PointcloudIndex>& order, std::vector<PointcloudIndex>& orderScratch, const std::vector<MortonNode>& children, const MortonNode& node)
+{
+	UINT64 runBegins[8], runEnds[8];
+	UINT runCount = 0;
+
+	for (int childIndex = 0; childIndex < 8; childIndex++)
+	{
+		if (node.childrenMask & (1 << childIndex))
+		{
+			const MortonNode& child = children[node.childrenStart + runCount];
+			runBegins[runCount] = child.begin;
+			runEnds[runCount] = child.end;
+			runCount++;
+		}
+	}
+
+	// The vertex indices are split into slices of the same value range, the slices of the runs are merged independently
+	UINT64 count = node.end - node.begin;
+	UINT64 sliceCount = (count + parallelMergeCount - 1) / parallelMergeCount;
+	UINT64 minIndex = ~0ULL, maxIndex = 0;
+
+	for (UINT run = 0; run < runCount; run++)
+	{
+		minIndex = min(minIndex, (UINT64)order[runBegins[run]]);
+		maxIndex = max(maxIndex, (UINT64)order[runEnds[run] - 1]);
+	}
+
+	ThreadPool::Get().ParallelFor(sliceCount, 1, [&](UINT64 start, UINT64 end)
+	{
+		for (UINT64 slice = start; slice < end; slice++)
+		{
+			UINT64 sliceBegin = minIndex + ((maxIndex - minIndex + 1) * slice) / sliceCount;
+			UINT64 sliceEnd = minIndex + ((maxIndex - minIndex + 1) * (slice + 1)) / sliceCount;
+			UINT64 from[8], to[8];
+			UINT64 offset = node.begin;
+
+			for (UINT run = 0; run < runCount; run++)
+			{
+				from[run] = std::lower_bound(order.begin() + runBegins[run], order.begin() + runEnds[run], sliceBegin) - order.begin();
+				to[run] = std::lower_bound(order.begin() + from[run], order.begin() + runEnds[run], sliceEnd) - order.begin();
+				offset += from[run] - runBegins[run];
+			}
+
+			MergeRuns(order.data(), from, to, runCount, orderScratch.data() + offset);
+		}
+	});
+
+	ThreadPool::Get().ParallelFor(count, parallelMergeCount, [&](UINT64 start, UINT64 end)
+	{
+		memcpy(order.data() + node.begin + start, orderScratch.data() + node.begin + start, (end - start) * sizeof(PointcloudIndex));
+	});
+}
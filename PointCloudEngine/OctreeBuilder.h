@@ -0,0 +1,81 @@
+#ifndef OCTREEBUILDER_H
+#define OCTREEBUILDER_H
+
+#pragma once
+#include "PointCloudEngine.h"
+
+namespace PointCloudEngine
+{
+	// Creates the breadth first nodes array of an octree (see Octree::nodes) from the vertices inside the root cube
+	// All build modes create the same nodes for the same maxOctreeDepth, only the aggregating builder approximates the clusters of the inner nodes
+	class OctreeBuilder
+	{
+	public:
+		// The vertices are passed by value because the builders reorder them, move them in to avoid a copy
+		static void Build(OctreeBuildMode mode, std::vector<Vertex> vertices, const Vector3& rootPosition, float rootSize, std::vector<OctreeNode>& outNodes);
+
+		// Creates the subtree of a node at rootDepth in the octree, it has the same nodes as the octree below this node
+		static void Build(OctreeBuildMode mode, std::vector<Vertex> vertices, const Vector3& rootPosition, float rootSize, UINT rootDepth, std::vector<OctreeNode>& outNodes);
+
+		// Child index of the cube that contains the vertex, the bits are set for the negative side of each axis
+		static int GetChildIndex(const Vector3& nodePosition, const Vector3& vertexPosition);
+
+	private:
+		// Nodes that are split into several tasks when merging the indices of their children
+		static const UINT64 parallelMergeCount = 256 * 1024;
+
+		// The subtree builder creates the top levels until there are this many subtrees per thread, the threads claim them one at a time
+		static const UINT subtreesPerThread = 16;
+
+		// Nodes of a subtree in breadth first order, each level starts at levelStarts and is copied to levelOffsets in the octree
+		struct Subtree
+		{
+			std::vector<OctreeNode> nodes;
+			std::vector<UINT64> levelStarts;
+			std::vector<UINT64> levelOffsets;
+		};
+
+		// Range of a node in the sorted vertex order, the children are stored in the next level starting at childrenStart
+		struct MortonNode
+		{
+			UINT64 begin;
+			UINT64 end;
+			UINT64 childrenStart;
+			byte childrenMask;
+		};
+
+		// Subdivides the nodes breadth first, the vertex range of each node is partitioned in place into the ranges of its children
+		// The partitions are stable, therefore the vertices of each node stay in their original order
+		static void BuildQueue(std::vector<Vertex>& vertices, const Vector3& rootPosition, float rootSize, UINT rootDepth, std::vector<OctreeNode>& outNodes);
+
+		// Creates the top levels like the queue builder, then the subtrees below them in parallel with their own node arrays
+		// The levels of the subtrees are interleaved into the breadth first order of the octree and their child indices are moved accordingly
+		static void BuildSubtrees(std::vector<Vertex>& vertices, const Vector3& rootPosition, float rootSize, UINT rootDepth, std::vector<OctreeNode>& outNodes);
+
+		static OctreeNodeCreationEntry GetRootEntry(const std::vector<Vertex>& vertices, const Vector3& rootPosition, float rootSize, UINT rootDepth);
+
+		// Creates the nodes of the queue entries breadth first, the entries of their children are added to the queue
+		// Stops at the start of a level with at least stopEntryCount entries, the index of the first node of each level is added to outLevelStarts
+		static void CreateNodes(std::queue<OctreeNodeCreationEntry>& nodeCreationQueue, std::vector<OctreeNode>& nodes, std::vector<UINT>& children, std::vector<Vertex>& vertices, std::vector<Vertex>& scratch, UINT64 stopEntryCount, std::vector<UINT64>& outLevelStarts);
+
+		// Replaces the indices into the children array by the indices of the first children in the nodes array
+		static void ResolveChildren(std::vector<OctreeNode>& nodes, const std::vector<UINT>& children);
+
+		// Each vertex gets a key with the child index of every level from the root to maxOctreeDepth (the first level in the highest digit)
+		// The keys are computed with the same comparisons and child cubes as the queue builder, therefore the octants are exactly the same
+		// After sorting, each node is a range of vertices with the same key prefix, the nodes of a level are in breadth first order
+		// The vertices of a node must be clustered in their original order, the sorted ranges of the children are merged bottom up to restore it
+		// Only the indices are reordered, each node reads its vertices through the indices of its range and the vertices are never moved
+		// With aggregate only the leaves are clustered from their vertices, the clusters of the inner nodes are merged from the clusters of their children
+		static void BuildMorton(const std::vector<Vertex>& vertices, const Vector3& rootPosition, float rootSize, UINT rootDepth, bool aggregate, std::vector<OctreeNode>& outNodes);
+
+		// Bounds of the eight child ranges of the sorted keys in [begin, end) that have the child index digit at the given shift
+		static void GetChildBounds(const std::vector<UINT64>& keys, UINT64 begin, UINT64 end, UINT shift, UINT64 outBounds[9]);
+
+		// Merges the ascending index runs [from, to) into the output
+		static void MergeRuns(const PointcloudIndex* order, UINT64 from[8], const UINT64 to[8], UINT runCount, PointcloudIndex* outOrder);
+		static void MergeChildren(std::vector<PointcloudIndex>& order, std::vector<PointcloudIndex>& orderScratch, const std::vector<MortonNode>& children, const MortonNode& node);
+	};
+}
+
+#endif
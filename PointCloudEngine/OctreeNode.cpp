@@ -5,9 +5,9 @@ PointCloudEngine::OctreeNode::OctreeNode()
     // Default constructor used for parsing from file
 }
 
-PointCloudEngine::OctreeNode::OctreeNode(std::queue<OctreeNodeCreationEntry> &nodeCreationQueue, std::vector<OctreeNode> &nodes, std::vector<UINT>& children, const OctreeNodeCreationEntry &entry)
+PointCloudEngine::OctreeNode::OctreeNode(std::queue<OctreeNodeCreationEntry> &nodeCreationQueue, std::vector<OctreeNode> &nodes, std::vector<UINT>& children, std::vector<Vertex>& vertices, std::vector<Vertex>& scratch, const OctreeNodeCreationEntry &entry)
 {
-    size_t vertexCount = entry.vertices.size();
+    UINT64 vertexCount = entry.end - entry.begin;
     
     if (vertexCount == 0)
     {
@@ -24,246 +24,209 @@ PointCloudEngine::OctreeNode::OctreeNode(std::queue<OctreeNodeCreationEntry> &no
 		children[entry.childrenIndex] = entry.nodesIndex;
     }
 
-    // Apply the k-means clustering algorithm to find clusters for the normals
-    Vector3 means[4];
-    const int k = min(vertexCount, 4);
-    UINT verticesPerMean[4] = { 0, 0, 0, 0 };
+    // Only subdivide further when this is not a leaf node and the max octree depth is not met yet
+    bool leaf = (vertexCount <= 1) || (entry.depth >= settings->maxOctreeDepth);
+    Initialize(vertices.data() + entry.begin, vertexCount, entry.position, entry.size, leaf);
 
-    // Set initial means to the first k normals
-    for (int i = 0; i < k; i++)
+    if (!leaf)
     {
-        means[i] = entry.vertices[i].normal;
-        verticesPerMean[i] = 1;
-    }
+		// Split the range into the ranges of the children with one partition along x, then two along y and four along z
+		// The vertices on the positive side come first, therefore the ranges are in the same order as the child indices
+		UINT64 childBounds[9];
+		childBounds[0] = entry.begin;
+		childBounds[8] = entry.end;
+		childBounds[4] = PartitionVertices(vertices, scratch, childBounds[0], childBounds[8], 0, entry.position.x);
+
+		for (int i = 0; i < 8; i += 4)
+		{
+			childBounds[i + 2] = PartitionVertices(vertices, scratch, childBounds[i], childBounds[i + 4], 1, entry.position.y);
+		}
 
-    // Save the index of the mean that each vertex is assigned to
-    bool meanChanged = true;
-    byte *clusters = new byte[vertexCount];
-    ZeroMemory(clusters, sizeof(byte) * vertexCount);
+		for (int i = 0; i < 8; i += 2)
+		{
+			childBounds[i + 1] = PartitionVertices(vertices, scratch, childBounds[i], childBounds[i + 2], 2, entry.position.z);
+		}
 
-    while (meanChanged)
-    {
-        // Assign all the vertices to the closest mean to them
-        for (UINT i = 0; i < vertexCount; i++)
-        {
-            float minDistance = Vector3::Distance(entry.vertices[i].normal, means[clusters[i]]);
+		// Store the start index of the children in the children array
+		childrenStartOrLeafPositionFactors = (UINT)children.size();
 
-            for (UINT j = 0; j < k; j++)
+        for (int i = 0; i < 8; i++)
+        {
+            if (childBounds[i + 1] > childBounds[i])
             {
-                float distance = Vector3::Distance(entry.vertices[i].normal, means[j]);
+                // Add a new entry to the queue
+                OctreeNodeCreationEntry childEntry;
+                childEntry.nodesIndex = UINT_MAX;
+				childEntry.childrenIndex = (UINT)children.size();
+                childEntry.begin = childBounds[i];
+                childEntry.end = childBounds[i + 1];
+                childEntry.position = GetChildPosition(entry.position, entry.size, i);
+                childEntry.size = entry.size * 0.5f;
+                childEntry.depth = entry.depth + 1;
 
-                if (distance < minDistance)
-                {
-                    clusters[i] = j;
-                    minDistance = distance;
-                }
-            }
-        }
+				// Add this entry to the mask
+				properties.childrenMask |= 1 << i;
 
-        // Calculate the new means from the vertices in each cluster
-        Vector3 newMeans[4];
+				// Reserve a spot for the children index that will be assigned later
+				children.push_back(UINT_MAX);
 
-        for (int i = 0; i < k; i++)
-        {
-            verticesPerMean[i] = 0;
+				// Add this to the queue
+                nodeCreationQueue.push(childEntry);
+            }
         }
+    }
+}
 
-        for (UINT i = 0; i < vertexCount; i++)
-        {
-            newMeans[clusters[i]] += entry.vertices[i].normal;
-            verticesPerMean[clusters[i]] += 1;
-        }
+void PointCloudEngine::OctreeNode::Initialize(const Vertex* vertices, UINT64 vertexCount, const Vector3& position, float size, bool leaf)
+{
+	Initialize(vertices, NULL, vertexCount, position, size, leaf);
+}
 
-        meanChanged = false;
+void PointCloudEngine::OctreeNode::Initialize(const Vertex* vertices, const PointcloudIndex* indices, UINT64 vertexCount, const Vector3& position, float size, bool leaf)
+{
+	SetClusters(Summarize(vertices, indices, vertexCount));
 
-        // Update the means
-        for (int i = 0; i < k; i++)
-        {
-            if (verticesPerMean[i] > 0)
-            {
-                newMeans[i] /= verticesPerMean[i];
+	if (leaf)
+	{
+		SetLeafPositionFactors(vertices, indices, vertexCount, position, size);
+	}
+}
 
-                if (Vector3::DistanceSquared(means[i], newMeans[i]) > FLT_EPSILON)
-                {
-                    meanChanged = true;
-                }
+ClusterSummary PointCloudEngine::OctreeNode::Summarize(const Vertex* vertices, UINT64 vertexCount)
+{
+	return Summarize(vertices, NULL, vertexCount);
+}
 
-                means[i] = newMeans[i];
-            }
-        }
+ClusterSummary PointCloudEngine::OctreeNode::Summarize(const Vertex* vertices, const PointcloudIndex* indices, UINT64 vertexCount)
+{
+    // Apply the k-means clustering algorithm to find clusters for the normals
+    ClusterSummary summary;
+    const int k = min(vertexCount, 4);
+
+    // The clustering kernel reads the normals from separate x, y and z arrays
+    std::vector<float> normals(3 * vertexCount);
+    float* normalsX = normals.data();
+    float* normalsY = normalsX + vertexCount;
+    float* normalsZ = normalsY + vertexCount;
 
+    // Without indices the vertices are read from one contiguous range
+    for (UINT64 i = 0; i < vertexCount; i++)
+    {
+        const Vertex& vertex = vertices[indices ? indices[i] : i];
+        normalsX[i] = vertex.normal.x;
+        normalsY[i] = vertex.normal.y;
+        normalsZ[i] = vertex.normal.z;
     }
 
+    // Save the index of the mean that each vertex is assigned to
+    byte *clusters = new byte[vertexCount];
+    NormalClustering::Cluster(normalsX, normalsY, normalsZ, vertexCount, settings->maxClusterIterations, settings->useKMeansPlusPlus, summary.means, summary.counts, clusters);
+
 	// Normalize the means
+	Vector3 means[4];
+
 	for (UINT i = 0; i < k; i++)
 	{
+		means[i] = summary.means[i];
 		means[i].Normalize();
 	}
 
     // Initialize average colors that are calculated per cluster
-	float normalCones[4] = { 0, 0, 0, 0 };
-    double averageReds[4] = { 0, 0, 0, 0 };
-    double averageGreens[4] = { 0, 0, 0, 0 };
-    double averageBlues[4] = { 0, 0, 0, 0 };
+    for (int i = 0; i < 4; i++)
+    {
+        summary.cones[i] = 0;
+        summary.colors[i][0] = summary.colors[i][1] = summary.colors[i][2] = 0;
+    }
 
     // Calculate color
-    for (UINT i = 0; i < vertexCount; i++)
+    for (size_t i = 0; i < vertexCount; i++)
     {
-        averageReds[clusters[i]] += entry.vertices[i].color[0];
-        averageGreens[clusters[i]] += entry.vertices[i].color[1];
-        averageBlues[clusters[i]] += entry.vertices[i].color[2];
+        const Vertex& vertex = vertices[indices ? indices[i] : i];
+        summary.colors[clusters[i]][0] += vertex.color[0];
+        summary.colors[clusters[i]][1] += vertex.color[1];
+        summary.colors[clusters[i]][2] += vertex.color[2];
 
 		// Calculate the angle in [0, pi] between the mean normal and this vertex normal
-		float angle = acos(means[clusters[i]].Dot(entry.vertices[i].normal));
+		float angle = acos(means[clusters[i]].Dot(vertex.normal));
 
 		// Save the maximum angle to any of the vertices in the cluster as normal cone
-		normalCones[clusters[i]] = max(normalCones[clusters[i]], angle);
+		summary.cones[clusters[i]] = max(summary.cones[clusters[i]], angle);
     }
 
 	delete[] clusters;
 
+    for (int i = 0; i < 4; i++)
+    {
+        if (summary.counts[i] > 0)
+        {
+            summary.colors[i][0] /= summary.counts[i];
+            summary.colors[i][1] /= summary.counts[i];
+            summary.colors[i][2] /= summary.counts[i];
+        }
+    }
+
+	return summary;
+}
+
+void PointCloudEngine::OctreeNode::SetClusters(const ClusterSummary& summary)
+{
     // Assign node properties
 	properties.childrenMask = 0;
+	UINT64 vertexCount = summary.counts[0] + summary.counts[1] + summary.counts[2] + summary.counts[3];
 
     for (int i = 0; i < 4; i++)
     {
-        if (verticesPerMean[i] > 0)
+        if (summary.counts[i] > 0)
         {
-            averageReds[i] /= verticesPerMean[i];
-            averageGreens[i] /= verticesPerMean[i];
-            averageBlues[i] /= verticesPerMean[i];
+            Vector3 mean = summary.means[i];
+            mean.Normalize();
 
-            properties.normals[i] = ClusterNormal(means[i], normalCones[i]);
-            properties.colors[i] = Color16(averageReds[i], averageGreens[i], averageBlues[i]);
+            properties.normals[i] = ClusterNormal(mean, summary.cones[i]);
+            properties.colors[i] = Color16(summary.colors[i][0], summary.colors[i][1], summary.colors[i][2]);
         }
     }
 
 	// Assign weights (one of the 4 can be omitted because the sum is always 100%)
 	for (int i = 0; i < 3; i++)
 	{
-		properties.weights[i] = (255.0f * verticesPerMean[i]) / vertexCount;
+		properties.weights[i] = (255.0f * summary.counts[i]) / vertexCount;
 	}
+}
 
-    // Only subdivide further when this is not a leaf node and the max octree depth is not met yet
-    if ((vertexCount > 1) && (entry.depth < settings->maxOctreeDepth))
-    {
-		// Split and create children vertices
-		std::vector<Vertex> childVertices[8];
-
-		// Fit each vertex into its corresponding child cube
-		for (auto it = entry.vertices.begin(); it != entry.vertices.end(); it++)
-		{
-			Vertex v = *it;
-
-			if (v.position.x > entry.position.x)
-			{
-				if (v.position.y > entry.position.y)
-				{
-					if (v.position.z > entry.position.z)
-					{
-						childVertices[0].push_back(v);
-					}
-					else
-					{
-						childVertices[1].push_back(v);
-					}
-				}
-				else
-				{
-					if (v.position.z > entry.position.z)
-					{
-						childVertices[2].push_back(v);
-					}
-					else
-					{
-						childVertices[3].push_back(v);
-					}
-				}
-			}
-			else
-			{
-				if (v.position.y > entry.position.y)
-				{
-					if (v.position.z > entry.position.z)
-					{
-						childVertices[4].push_back(v);
-					}
-					else
-					{
-						childVertices[5].push_back(v);
-					}
-				}
-				else
-				{
-					if (v.position.z > entry.position.z)
-					{
-						childVertices[6].push_back(v);
-					}
-					else
-					{
-						childVertices[7].push_back(v);
-					}
-				}
-			}
-		}
-
-		// Store the start index of the children in the children array
-		childrenStartOrLeafPositionFactors = children.size();
-
-        for (int i = 0; i < 8; i++)
-        {
-            if (childVertices[i].size() > 0)
-            {
-                // Add a new entry to the queue
-                OctreeNodeCreationEntry childEntry;
-                childEntry.nodesIndex = UINT_MAX;
-				childEntry.childrenIndex = children.size();
-                childEntry.vertices = childVertices[i];
-                childEntry.position = GetChildPosition(entry.position, entry.size, i);
-                childEntry.size = entry.size * 0.5f;
-                childEntry.depth = entry.depth + 1;
+void PointCloudEngine::OctreeNode::SetLeafPositionFactors(const Vertex* vertices, UINT64 vertexCount, const Vector3& position, float size)
+{
+	SetLeafPositionFactors(vertices, NULL, vertexCount, position, size);
+}
 
-				// Add this entry to the mask
-				properties.childrenMask |= 1 << i;
+void PointCloudEngine::OctreeNode::SetLeafPositionFactors(const Vertex* vertices, const PointcloudIndex* indices, UINT64 vertexCount, const Vector3& position, float size)
+{
+	// This is a leaf node with childrenMask=0 representing exactly one or more vertices
+	// The bounding cube can be much larger than the vertices that it represents -> the bounding cube position does not represent the vertex positions well
+	// Idea: store factors from the average vertex position in the childrenStartOrLeafPositionFactors to representing a more accurate position
+	// Each 8 bits store the distance factor from the smallest position of the bounding cube in respect to the size of the cube in each axis (x, y, z)
+	childrenStartOrLeafPositionFactors = 0;
 
-				// Reserve a spot for the children index that will be assigned later
-				children.push_back(UINT_MAX);
+	// Compute the average position of the vertices contained in this leaf node
+	Vector3 averagePosition = Vector3::Zero;
 
-				// Add this to the queue
-                nodeCreationQueue.push(childEntry);
-            }
-        }
-    }
-	else
+	for (size_t i = 0; i < vertexCount; i++)
 	{
-		// This is a leaf node with childrenMask=0 representing exactly one or more vertices
-		// The bounding cube can be much larger than the vertices that it represents -> the bounding cube position does not represent the vertex positions well
-		// Idea: store factors from the average vertex position in the childrenStartOrLeafPositionFactors to representing a more accurate position
-		// Each 8 bits store the distance factor from the smallest position of the bounding cube in respect to the size of the cube in each axis (x, y, z)
-		childrenStartOrLeafPositionFactors = 0;
-
-		// Compute the average position of the vertices contained in this leaf node
-		Vector3 averagePosition = Vector3::Zero;
-
-		for (UINT i = 0; i < vertexCount; i++)
-		{
-			averagePosition += entry.vertices[i].position;
-		}
+		averagePosition += vertices[indices ? indices[i] : i].position;
+	}
 
-		averagePosition /= vertexCount;
+	averagePosition /= vertexCount;
 
-		// Use the offset from the smallest position of the bounding cube to compute the factors
-		Vector3 offset = averagePosition - (entry.position - (0.5f * entry.size * Vector3::One));
+	// Use the offset from the smallest position of the bounding cube to compute the factors
+	Vector3 offset = averagePosition - (position - (0.5f * size * Vector3::One));
 
-		float factorX = offset.x / entry.size;
-		float factorY = offset.y / entry.size;
-		float factorZ = offset.z / entry.size;
+	float factorX = offset.x / size;
+	float factorY = offset.y / size;
+	float factorZ = offset.z / size;
 
-		// Store all of them in the 32bit uint
-		childrenStartOrLeafPositionFactors |= static_cast<UINT>(0xff * factorX) << 16;
-		childrenStartOrLeafPositionFactors |= static_cast<UINT>(0xff * factorY) << 8;
-		childrenStartOrLeafPositionFactors |= static_cast<UINT>(0xff * factorZ);
-	}
+	// Store all of them in the 32bit uint
+	childrenStartOrLeafPositionFactors |= static_cast<UINT>(0xff * factorX) << 16;
+	childrenStartOrLeafPositionFactors |= static_cast<UINT>(0xff * factorY) << 8;
+	childrenStartOrLeafPositionFactors |= static_cast<UINT>(0xff * factorZ);
 }
 
 void PointCloudEngine::OctreeNode::GetVertices(const std::vector<OctreeNode>& nodes, std::queue<OctreeNodeTraversalEntry> &nodesQueue, std::vector<OctreeNodeVertex> &octreeVertices, const OctreeNodeTraversalEntry &entry, const OctreeConstantBuffer &octreeConstantBufferData) const
@@ -490,7 +453,33 @@ bool PointCloudEngine::OctreeNode::IsLeafNode() const
 	return (properties.childrenMask == 0);
 }
 
-Vector3 PointCloudEngine::OctreeNode::GetChildPosition(const Vector3& parentPosition, const float& parentSize, int childIndex) const
+UINT64 PointCloudEngine::OctreeNode::PartitionVertices(std::vector<Vertex>& vertices, std::vector<Vertex>& scratch, UINT64 begin, UINT64 end, int axis, float center)
+{
+	// Vertices on the positive side are compacted at the start of the range, the others are collected in the scratch array and copied after them
+	UINT64 positiveEnd = begin;
+	UINT64 negativeEnd = begin;
+
+	for (UINT64 i = begin; i < end; i++)
+	{
+		const Vector3& position = vertices[i].position;
+		float value = (axis == 0) ? position.x : ((axis == 1) ? position.y : position.z);
+
+		if (value > center)
+		{
+			vertices[positiveEnd++] = vertices[i];
+		}
+		else
+		{
+			scratch[negativeEnd++] = vertices[i];
+		}
+	}
+
+	std::copy(scratch.begin() + begin, scratch.begin() + negativeEnd, vertices.begin() + positiveEnd);
+
+	return positiveEnd;
+}
+
+Vector3 PointCloudEngine::OctreeNode::GetChildPosition(const Vector3& parentPosition, const float& parentSize, int childIndex)
 {
 	/*
 	Vector3 childPositions[8] =
@@ -10,11 +10,32 @@ namespace PointCloudEngine
     {
     public:
         OctreeNode();
-        OctreeNode (std::queue<OctreeNodeCreationEntry> &nodeCreationQueue, std::vector<OctreeNode> &nodes, std::vector<UINT> &children, const OctreeNodeCreationEntry &entry);
+        OctreeNode (std::queue<OctreeNodeCreationEntry> &nodeCreationQueue, std::vector<OctreeNode> &nodes, std::vector<UINT> &children, std::vector<Vertex> &vertices, std::vector<Vertex> &scratch, const OctreeNodeCreationEntry &entry);
+
+		// Computes the normal clusters, colors and weights from the vertices in their order, leaf nodes also store the position factors
+		// The children of inner nodes are assigned by the builder
+		void Initialize(const Vertex* vertices, UINT64 vertexCount, const Vector3& position, float size, bool leaf);
+
+		// Same as above for the vertices at the indices in their order, the vertices themselves are not moved
+		void Initialize(const Vertex* vertices, const PointcloudIndex* indices, UINT64 vertexCount, const Vector3& position, float size, bool leaf);
+
+		// Clusters the normals of the vertices in their order and averages the colors of each cluster
+		static ClusterSummary Summarize(const Vertex* vertices, UINT64 vertexCount);
+		static ClusterSummary Summarize(const Vertex* vertices, const PointcloudIndex* indices, UINT64 vertexCount);
+
+		// Quantizes the clusters into the normals, colors and weights of the properties
+		void SetClusters(const ClusterSummary& summary);
+
+		// Stores the average position of the vertices of a leaf relative to its cube
+		void SetLeafPositionFactors(const Vertex* vertices, UINT64 vertexCount, const Vector3& position, float size);
+		void SetLeafPositionFactors(const Vertex* vertices, const PointcloudIndex* indices, UINT64 vertexCount, const Vector3& position, float size);
 
 		void GetVertices(const std::vector<OctreeNode> &nodes, std::queue<OctreeNodeTraversalEntry>& nodesQueue, std::vector<OctreeNodeVertex>& octreeVertices, const OctreeNodeTraversalEntry& entry, const OctreeConstantBuffer& octreeConstantBufferData) const;
         bool IsLeafNode() const;
 
+		// The child cube with the index (x, y, z bits set for the negative side) of the parent cube
+		static Vector3 GetChildPosition(const Vector3 &parentPosition, const float &parentSize, int childIndex);
+
 		// Stores either (1) the start index in the nodes array where the actual child indices are stored or (2) the leaf position factors
 		// (1) The childrenMask from the properties determines which children corresponds to which index
 		// (1) E.g. a childrenMask of 01011011 means that the array only stores the 2nd, 4th, 5th, 7th and 8th indices from the start right after each other
@@ -26,8 +47,11 @@ namespace PointCloudEngine
 		OctreeNodeProperties properties;
 
 	private:
-		Vector3 GetChildPosition(const Vector3 &parentPosition, const float &parentSize, int childIndex) const;
 		OctreeNodeVertex GetVertexFromTraversalEntry(const OctreeNodeTraversalEntry& entry) const;
+
+		// Stable partition of the vertices in [begin, end) into the ones above the center along the axis (0=x, 1=y, 2=z) and the others
+		// Returns the end of the first part, the scratch array has the same size as the vertices
+		static UINT64 PartitionVertices(std::vector<Vertex>& vertices, std::vector<Vertex>& scratch, UINT64 begin, UINT64 end, int axis, float center);
     };
 }
 
@@ -22,31 +22,36 @@ void OctreeRenderer::Initialize()
 	ERROR_MESSAGE_ON_HR(hr, NAMEOF(d3d11Device->CreateBuffer) + L" failed for the " + NAMEOF(octreeRendererConstantBuffer));
 
     // Create the buffer for the compute shader that stores all the octree nodes
-    // Maximum size is ~4.2 GB due to UINT_MAX
-    D3D11_BUFFER_DESC nodesBufferDesc;
-    ZeroMemory(&nodesBufferDesc, sizeof(nodesBufferDesc));
-    nodesBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-    nodesBufferDesc.ByteWidth = octree->nodes.size() * sizeof(OctreeNode);
-    nodesBufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-    nodesBufferDesc.StructureByteStride = sizeof(OctreeNode);
-    nodesBufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-
-    D3D11_SUBRESOURCE_DATA nodesBufferData;
-    ZeroMemory(&nodesBufferData, sizeof(nodesBufferData));
-	nodesBufferData.pSysMem = octree->nodes.data();
-
-    hr = d3d11Device->CreateBuffer(&nodesBufferDesc, &nodesBufferData, &nodesBuffer);
-	ERROR_MESSAGE_ON_HR(hr, NAMEOF(d3d11Device->CreateBuffer) + L" failed for the " + NAMEOF(nodesBuffer));
-
-    D3D11_SHADER_RESOURCE_VIEW_DESC nodesBufferSRVDesc;
-    ZeroMemory(&nodesBufferSRVDesc, sizeof(nodesBufferSRVDesc));
-    nodesBufferSRVDesc.Format = DXGI_FORMAT_UNKNOWN;
-    nodesBufferSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
-    nodesBufferSRVDesc.Buffer.ElementWidth = sizeof(OctreeNode);
-    nodesBufferSRVDesc.Buffer.NumElements = octree->nodes.size();
-
-    hr = d3d11Device->CreateShaderResourceView(nodesBuffer, &nodesBufferSRVDesc, &nodesBufferSRV);
-	ERROR_MESSAGE_ON_HR(hr, NAMEOF(d3d11Device->CreateShaderResourceView) + L" failed for the " + NAMEOF(nodesBufferSRV));
+    // Maximum size is ~4.2 GB due to UINT_MAX, larger octrees are only traversed on the CPU
+    UINT64 nodesBufferSize = octree->nodes.size() * sizeof(OctreeNode);
+
+    if (nodesBufferSize <= UINT_MAX)
+    {
+        D3D11_BUFFER_DESC nodesBufferDesc;
+        ZeroMemory(&nodesBufferDesc, sizeof(nodesBufferDesc));
+        nodesBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+        nodesBufferDesc.ByteWidth = (UINT)nodesBufferSize;
+        nodesBufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        nodesBufferDesc.StructureByteStride = sizeof(OctreeNode);
+        nodesBufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+
+        D3D11_SUBRESOURCE_DATA nodesBufferData;
+        ZeroMemory(&nodesBufferData, sizeof(nodesBufferData));
+        nodesBufferData.pSysMem = octree->nodes.data();
+
+        hr = d3d11Device->CreateBuffer(&nodesBufferDesc, &nodesBufferData, &nodesBuffer);
+        ERROR_MESSAGE_ON_HR(hr, NAMEOF(d3d11Device->CreateBuffer) + L" failed for the " + NAMEOF(nodesBuffer));
+
+        D3D11_SHADER_RESOURCE_VIEW_DESC nodesBufferSRVDesc;
+        ZeroMemory(&nodesBufferSRVDesc, sizeof(nodesBufferSRVDesc));
+        nodesBufferSRVDesc.Format = DXGI_FORMAT_UNKNOWN;
+        nodesBufferSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+        nodesBufferSRVDesc.Buffer.ElementWidth = sizeof(OctreeNode);
+        nodesBufferSRVDesc.Buffer.NumElements = (UINT)octree->nodes.size();
+
+        hr = d3d11Device->CreateShaderResourceView(nodesBuffer, &nodesBufferSRVDesc, &nodesBufferSRV);
+        ERROR_MESSAGE_ON_HR(hr, NAMEOF(d3d11Device->CreateShaderResourceView) + L" failed for the " + NAMEOF(nodesBufferSRV));
+    }
 
     // Create general buffer description for append/consume buffer
     D3D11_BUFFER_DESC appendConsumeBufferDesc;
@@ -199,8 +204,8 @@ void OctreeRenderer::Draw()
     d3d11DevCon->GSSetConstantBuffers(0, 1, &octreeConstantBuffer);
 	d3d11DevCon->PSSetConstantBuffers(0, 1, &octreeConstantBuffer);
 
-    // Get the vertex buffer and use the specified implementation
-    if (settings->useGPUTraversal)
+    // Get the vertex buffer and use the specified implementation, octrees without a nodes buffer are too large for the GPU
+    if (settings->useGPUTraversal && (nodesBuffer != NULL))
     {
         DrawOctreeCompute();
     }
@@ -0,0 +1,616 @@
+#include "OutOfCoreOctreeBuilder.h"
+
+PointCloudEngine::OutOfCoreOctreeBuilder::Statistics PointCloudEngine::OutOfCoreOctreeBuilder::Build(const std::wstring& pointcloudFile, const std::wstring& temporaryPrefix, UINT64 memoryLimit, OctreeBuildMode mode, Vector3& outRootPosition, float& outRootSize, std::vector<OctreeNode>& outNodes)
+{
+	Statistics statistics;
+	auto lastTime = std::chrono::high_resolution_clock::now();
+
+	// Adds the time since the last measurement to the I/O or the CPU time
+	auto measure = [&](double& outSeconds)
+	{
+		auto time = std::chrono::high_resolution_clock::now();
+		outSeconds += std::chrono::duration<double>(time - lastTime).count();
+		lastTime = time;
+	};
+
+	// Compressed chunks stay in the mapping and are only decompressed when they are decoded
+	PointcloudFile pointcloud;
+
+	if (!pointcloud.Open(pointcloudFile, false))
+	{
+		throw std::exception("Could not load .pointcloud file!");
+	}
+
+	if (pointcloud.vertexCount == 0)
+	{
+		throw std::exception("Cannot create an octree without vertices!");
+	}
+
+	const Vector3 rootPosition = pointcloud.boundingCubePosition;
+	const float rootSize = pointcloud.boundingCubeSize;
+	const UINT64 vertexCount = pointcloud.vertexCount;
+	const UINT64 limitVertexCount = max(memoryLimit / bytesPerVertex, 1ULL);
+	outRootPosition = rootPosition;
+	outRootSize = rootSize;
+
+	// Consecutive chunks are decoded together in blocks of up to blockVertexCount vertices, a larger chunk is a block on its own
+	std::vector<std::vector<UINT64>> blocks;
+	UINT64 blockCount = 0;
+
+	for (UINT64 chunk = 0; chunk < pointcloud.chunks.size(); chunk++)
+	{
+		if (blocks.empty() || blockCount + pointcloud.chunks[chunk].vertexCount > blockVertexCount)
+		{
+			blocks.push_back(std::vector<UINT64>());
+			blockCount = 0;
+		}
+
+		blocks.back().push_back(chunk);
+		blockCount += pointcloud.chunks[chunk].vertexCount;
+		statistics.largestBlock = max(statistics.largestBlock, blockCount);
+	}
+
+	auto decodeBlock = [&](const std::vector<UINT64>& blockChunks, Vertex* outVertices)
+	{
+		if (!pointcloud.DecodeChunks(blockChunks, outVertices, false))
+		{
+			throw std::exception("Could not decompress the .pointcloud file!");
+		}
+	};
+
+	// Nothing has to be written to the disk when all the vertices fit into the limit
+	if (vertexCount <= limitVertexCount || settings->maxOctreeDepth <= 0)
+	{
+		std::vector<Vertex> vertices(vertexCount);
+		decodeBlock(pointcloud.SelectChunks(PointcloudSelection()), vertices.data());
+		pointcloud.Close();
+		measure(statistics.ioSeconds);
+
+		OctreeBuilder::Build(mode, std::move(vertices), rootPosition, rootSize, outNodes);
+		measure(statistics.cpuSeconds);
+
+		statistics.bucketCount = 1;
+		statistics.largestBucket = vertexCount;
+
+		return statistics;
+	}
+
+	// Count the vertices in the cells of the deepest bucket level, then add them up for the levels above
+	const UINT countDepth = min((UINT)settings->maxOctreeDepth, maxBucketDepth);
+	std::vector<std::vector<UINT64>> cellCounts(countDepth + 1);
+	std::vector<Vertex> block(statistics.largestBlock);
+	std::vector<UINT64> blockCells(block.size());
+	cellCounts[countDepth].resize(1ULL << (3 * countDepth));
+
+	for (auto it = blocks.begin(); it != blocks.end(); it++)
+	{
+		UINT64 count = pointcloud.GetVertexCount(*it);
+		decodeBlock(*it, block.data());
+		measure(statistics.ioSeconds);
+
+		ThreadPool::Get().ParallelFor(count, 64 * 1024, [&](UINT64 start, UINT64 end)
+		{
+			for (UINT64 i = start; i < end; i++)
+			{
+				blockCells[i] = GetCell(rootPosition, rootSize, countDepth, block[i].position);
+			}
+		});
+
+		for (UINT64 i = 0; i < count; i++)
+		{
+			cellCounts[countDepth][blockCells[i]]++;
+		}
+
+		measure(statistics.cpuSeconds);
+	}
+
+	for (int depth = (int)countDepth - 1; depth >= 0; depth--)
+	{
+		cellCounts[depth].resize(1ULL << (3 * depth));
+
+		for (UINT64 cell = 0; cell < cellCounts[depth + 1].size(); cell++)
+		{
+			cellCounts[depth][cell >> 3] += cellCounts[depth + 1][cell];
+		}
+	}
+
+	// Subdivide the cells top down until their vertices fit into the limit, these cells are the buckets
+	std::vector<std::vector<TopCell>> levels(1, std::vector<TopCell>(1, { 0, ~0ULL, 0, 0, 0 }));
+	std::vector<Bucket> buckets;
+
+	for (UINT depth = 0; depth < levels.size(); depth++)
+	{
+		std::vector<TopCell> children;
+
+		for (auto it = levels[depth].begin(); it != levels[depth].end(); it++)
+		{
+			UINT64 count = cellCounts[depth][it->prefix];
+
+			if (count <= limitVertexCount || depth == countDepth)
+			{
+				Bucket bucket = {};
+				bucket.depth = depth;
+				bucket.prefix = it->prefix;
+				bucket.count = count;
+
+				it->bucket = buckets.size();
+				buckets.push_back(bucket);
+				continue;
+			}
+
+			it->childrenStart = children.size();
+
+			for (int childIndex = 0; childIndex < 8; childIndex++)
+			{
+				UINT64 childPrefix = (it->prefix << 3) | childIndex;
+
+				if (cellCounts[depth + 1][childPrefix] > 0)
+				{
+					it->childrenMask |= 1 << childIndex;
+					children.push_back({ childPrefix, ~0ULL, 0, 0, 0 });
+				}
+			}
+		}
+
+		if (!children.empty())
+		{
+			levels.push_back(std::move(children));
+		}
+	}
+
+	cellCounts.clear();
+
+	// Sort the buckets by their paths, then the buckets in each file and the nodes of each level are in breadth first order
+	auto getAlignedPrefix = [&](UINT depth, UINT64 prefix)
+	{
+		return prefix << (3 * (countDepth - depth));
+	};
+
+	std::vector<UINT64> bucketOrder(buckets.size());
+	std::vector<UINT64> bucketIndices(buckets.size());
+	std::vector<Bucket> sortedBuckets(buckets.size());
+
+	for (UINT64 i = 0; i < buckets.size(); i++)
+	{
+		bucketOrder[i] = i;
+	}
+
+	std::sort(bucketOrder.begin(), bucketOrder.end(), [&](UINT64 a, UINT64 b)
+	{
+		return getAlignedPrefix(buckets[a].depth, buckets[a].prefix) < getAlignedPrefix(buckets[b].depth, buckets[b].prefix);
+	});
+
+	for (UINT64 i = 0; i < buckets.size(); i++)
+	{
+		sortedBuckets[i] = buckets[bucketOrder[i]];
+		bucketIndices[bucketOrder[i]] = i;
+	}
+
+	buckets.swap(sortedBuckets);
+
+	for (auto level = levels.begin(); level != levels.end(); level++)
+	{
+		for (auto it = level->begin(); it != level->end(); it++)
+		{
+			it->bucket = (it->bucket != ~0ULL) ? bucketIndices[it->bucket] : ~0ULL;
+		}
+	}
+
+	// Consecutive buckets share a file as long as their vertices fit into the limit, each cell of the count level belongs to one bucket
+	std::vector<UINT64> fileStarts(1, 0);
+	std::vector<UINT> cellBuckets(1ULL << (3 * countDepth));
+	UINT64 fileVertexCount = 0;
+
+	for (UINT64 i = 0; i < buckets.size(); i++)
+	{
+		if (fileVertexCount > 0 && fileVertexCount + buckets[i].count > limitVertexCount)
+		{
+			fileStarts.push_back(i);
+			fileVertexCount = 0;
+		}
+
+		buckets[i].file = fileStarts.size() - 1;
+		fileVertexCount += buckets[i].count;
+
+		UINT64 cellStart = getAlignedPrefix(buckets[i].depth, buckets[i].prefix);
+		UINT64 cellEnd = getAlignedPrefix(buckets[i].depth, buckets[i].prefix + 1);
+
+		for (UINT64 cell = cellStart; cell < cellEnd; cell++)
+		{
+			cellBuckets[cell] = (UINT)i;
+		}
+
+		statistics.bucketDepth = max(statistics.bucketDepth, buckets[i].depth);
+		statistics.largestBucket = max(statistics.largestBucket, buckets[i].count);
+	}
+
+	fileStarts.push_back(buckets.size());
+	statistics.bucketCount = buckets.size();
+	statistics.fileCount = fileStarts.size() - 1;
+
+	if (statistics.fileCount > maxFileCount)
+	{
+		throw std::exception("The octreeMemoryLimit is too small for this point cloud!");
+	}
+
+	std::vector<std::ofstream> files(statistics.fileCount);
+	std::ofstream nodesFile;
+
+	auto deleteFiles = [&]()
+	{
+		for (UINT64 file = 0; file < files.size(); file++)
+		{
+			files[file].close();
+			DeleteFile(GetFilename(temporaryPrefix, L"bucket" + std::to_wstring(file) + L".tmp").c_str());
+		}
+
+		nodesFile.close();
+		DeleteFile(GetFilename(temporaryPrefix, L"nodes.tmp").c_str());
+	};
+
+	try
+	{
+		// Stream the vertices into the bucket files, the vertices of each bucket stay in their original order
+		std::vector<std::vector<Vertex>> fileBuffers(files.size());
+
+		for (UINT64 file = 0; file < files.size(); file++)
+		{
+			files[file].open(GetFilename(temporaryPrefix, L"bucket" + std::to_wstring(file) + L".tmp"), std::ios::out | std::ios::binary | std::ios::trunc);
+			fileBuffers[file].reserve(fileBufferVertexCount);
+
+			if (!files[file].is_open())
+			{
+				throw std::exception("Could not create the temporary octree files!");
+			}
+		}
+
+		auto flush = [&](UINT64 file)
+		{
+			measure(statistics.cpuSeconds);
+			files[file].write((const char*)fileBuffers[file].data(), fileBuffers[file].size() * sizeof(Vertex));
+			statistics.bytesWritten += fileBuffers[file].size() * sizeof(Vertex);
+			fileBuffers[file].clear();
+			measure(statistics.ioSeconds);
+		};
+
+		for (auto it = blocks.begin(); it != blocks.end(); it++)
+		{
+			UINT64 count = pointcloud.GetVertexCount(*it);
+			decodeBlock(*it, block.data());
+			measure(statistics.ioSeconds);
+
+			ThreadPool::Get().ParallelFor(count, 64 * 1024, [&](UINT64 start, UINT64 end)
+			{
+				for (UINT64 i = start; i < end; i++)
+				{
+					blockCells[i] = buckets[cellBuckets[GetCell(rootPosition, rootSize, countDepth, block[i].position)]].file;
+				}
+			});
+
+			for (UINT64 i = 0; i < count; i++)
+			{
+				std::vector<Vertex>& fileBuffer = fileBuffers[blockCells[i]];
+				fileBuffer.push_back(block[i]);
+
+				if (fileBuffer.size() == fileBufferVertexCount)
+				{
+					flush(blockCells[i]);
+				}
+			}
+		}
+
+		for (UINT64 file = 0; file < files.size(); file++)
+		{
+			flush(file);
+			files[file].close();
+
+			if (!files[file])
+			{
+				throw std::exception("Could not write the temporary octree files!");
+			}
+		}
+
+		pointcloud.Close();
+		block.clear();
+		block.shrink_to_fit();
+		blockCells.clear();
+		blockCells.shrink_to_fit();
+		fileBuffers.clear();
+		measure(statistics.ioSeconds);
+
+		// Create the subtree of each bucket and store its nodes in a temporary file
+		nodesFile.open(GetFilename(temporaryPrefix, L"nodes.tmp"), std::ios::out | std::ios::binary | std::ios::trunc);
+		UINT64 nodesWritten = 0;
+
+		for (UINT64 file = 0; file < files.size(); file++)
+		{
+			UINT64 firstBucket = fileStarts[file];
+			UINT64 lastBucket = fileStarts[file + 1];
+			UINT64 count = 0;
+
+			for (UINT64 i = firstBucket; i < lastBucket; i++)
+			{
+				count += buckets[i].count;
+			}
+
+			std::wstring filename = GetFilename(temporaryPrefix, L"bucket" + std::to_wstring(file) + L".tmp");
+			std::vector<Vertex> vertices(count);
+			std::ifstream bucketFile(filename, std::ios::in | std::ios::binary);
+			bucketFile.read((char*)vertices.data(), count * sizeof(Vertex));
+
+			if (!bucketFile)
+			{
+				throw std::exception("Could not read the temporary octree files!");
+			}
+
+			bucketFile.close();
+			DeleteFile(filename.c_str());
+			statistics.bytesRead += count * sizeof(Vertex);
+			measure(statistics.ioSeconds);
+
+			// Stable counting sort of the vertices by their bucket
+			if (lastBucket - firstBucket > 1)
+			{
+				std::vector<UINT> vertexBuckets(count);
+				std::vector<UINT64> bucketStarts(lastBucket - firstBucket + 1, 0);
+
+				ThreadPool::Get().ParallelFor(count, 64 * 1024, [&](UINT64 start, UINT64 end)
+				{
+					for (UINT64 i = start; i < end; i++)
+					{
+						vertexBuckets[i] = cellBuckets[GetCell(rootPosition, rootSize, countDepth, vertices[i].position)];
+					}
+				});
+
+				for (UINT64 i = firstBucket; i < lastBucket; i++)
+				{
+					bucketStarts[i - firstBucket + 1] = bucketStarts[i - firstBucket] + buckets[i].count;
+				}
+
+				std::vector<Vertex> sortedVertices(count);
+
+				for (UINT64 i = 0; i < count; i++)
+				{
+					sortedVertices[bucketStarts[vertexBuckets[i] - firstBucket]++] = vertices[i];
+				}
+
+				vertices.swap(sortedVertices);
+			}
+
+			UINT64 offset = 0;
+
+			for (UINT64 i = firstBucket; i < lastBucket; i++)
+			{
+				Bucket& bucket = buckets[i];
+				Vector3 position;
+				float size;
+				GetCellCube(rootPosition, rootSize, bucket.depth, bucket.prefix, position, size);
+
+				// The clusters of the bucket root are the same as the ones of the in memory builders
+				bucket.summary = OctreeNode::Summarize(vertices.data() + offset, bucket.count);
+
+				std::vector<OctreeNode> nodes;
+				std::vector<Vertex> bucketVertices;
+
+				if (bucket.count == count)
+				{
+					bucketVertices.swap(vertices);
+				}
+				else
+				{
+					bucketVertices.assign(vertices.begin() + offset, vertices.begin() + offset + bucket.count);
+				}
+
+				OctreeBuilder::Build(mode, std::move(bucketVertices), position, size, bucket.depth, nodes);
+				GetLevelStarts(nodes, bucket.levelStarts);
+				offset += bucket.count;
+				measure(statistics.cpuSeconds);
+
+				bucket.nodesOffset = nodesWritten;
+				nodesFile.write((const char*)nodes.data(), nodes.size() * sizeof(OctreeNode));
+				nodesWritten += nodes.size();
+				statistics.bytesWritten += nodes.size() * sizeof(OctreeNode);
+				measure(statistics.ioSeconds);
+			}
+		}
+
+		nodesFile.close();
+
+		if (!nodesFile)
+		{
+			throw std::exception("Could not write the temporary octree files!");
+		}
+
+		// Each level of the octree consists of the top cells of this level and the levels of the buckets above it, both in the order of their paths
+		UINT64 levelCount = levels.size();
+		UINT64 nodeCount = 0;
+
+		for (auto it = buckets.begin(); it != buckets.end(); it++)
+		{
+			levelCount = max(levelCount, it->depth + it->levelStarts.size() - 1);
+			it->levelOffsets.resize(it->levelStarts.size() - 1);
+		}
+
+		for (UINT64 level = 0; level < levelCount; level++)
+		{
+			UINT64 cell = 0;
+			UINT64 cellCount = (level < levels.size()) ? levels[level].size() : 0;
+
+			for (UINT64 i = 0; i <= buckets.size(); i++)
+			{
+				UINT64 bucketPrefix = (i < buckets.size()) ? getAlignedPrefix(buckets[i].depth, buckets[i].prefix) : ~0ULL;
+
+				for (; cell < cellCount && getAlignedPrefix((UINT)level, levels[level][cell].prefix) < bucketPrefix; cell++)
+				{
+					TopCell& topCell = levels[level][cell];
+					topCell.node = nodeCount++;
+
+					if (topCell.bucket != ~0ULL)
+					{
+						buckets[topCell.bucket].levelOffsets[0] = topCell.node;
+					}
+				}
+
+				if (i < buckets.size() && buckets[i].depth < level && level - buckets[i].depth < buckets[i].levelOffsets.size())
+				{
+					Bucket& bucket = buckets[i];
+					UINT64 bucketLevel = level - bucket.depth;
+					bucket.levelOffsets[bucketLevel] = nodeCount;
+					nodeCount += bucket.levelStarts[bucketLevel + 1] - bucket.levelStarts[bucketLevel];
+				}
+			}
+		}
+
+		// The nodes reference their children with 32 bit indices on the GPU
+		if (nodeCount > UINT_MAX)
+		{
+			throw std::exception("Too many octree nodes, lower the maxOctreeDepth parameter!");
+		}
+
+		outNodes.clear();
+		outNodes.resize(nodeCount);
+
+		// Read the levels of the subtrees to their breadth first positions and convert the indices of their children
+		std::ifstream nodesInput(GetFilename(temporaryPrefix, L"nodes.tmp"), std::ios::in | std::ios::binary);
+
+		for (auto it = buckets.begin(); it != buckets.end(); it++)
+		{
+			for (UINT64 level = 0; level < it->levelOffsets.size(); level++)
+			{
+				UINT64 count = it->levelStarts[level + 1] - it->levelStarts[level];
+				nodesInput.seekg((it->nodesOffset + it->levelStarts[level]) * sizeof(OctreeNode));
+				nodesInput.read((char*)(outNodes.data() + it->levelOffsets[level]), count * sizeof(OctreeNode));
+				statistics.bytesRead += count * sizeof(OctreeNode);
+			}
+		}
+
+		if (!nodesInput)
+		{
+			throw std::exception("Could not read the temporary octree files!");
+		}
+
+		nodesInput.close();
+		measure(statistics.ioSeconds);
+
+		ThreadPool::Get().ParallelFor(buckets.size(), 1, [&](UINT64 start, UINT64 end)
+		{
+			for (UINT64 i = start; i < end; i++)
+			{
+				const Bucket& bucket = buckets[i];
+
+				for (UINT64 level = 0; level + 1 < bucket.levelOffsets.size(); level++)
+				{
+					for (UINT64 node = bucket.levelOffsets[level]; node < bucket.levelOffsets[level] + bucket.levelStarts[level + 1] - bucket.levelStarts[level]; node++)
+					{
+						OctreeNode& octreeNode = outNodes[node];
+
+						if (octreeNode.properties.childrenMask != 0)
+						{
+							octreeNode.childrenStartOrLeafPositionFactors = (UINT)(bucket.levelOffsets[level + 1] + octreeNode.childrenStartOrLeafPositionFactors - bucket.levelStarts[level + 1]);
+						}
+					}
+				}
+			}
+		});
+
+		// Merge the clusters of the top cells bottom up from the clusters of their children
+		for (int level = (int)levels.size() - 1; level >= 0; level--)
+		{
+			for (auto it = levels[level].begin(); it != levels[level].end(); it++)
+			{
+				if (it->bucket != ~0ULL)
+				{
+					it->summary = buckets[it->bucket].summary;
+					continue;
+				}
+
+				ClusterSummary childSummaries[8];
+				UINT childCount = 0;
+
+				for (int childIndex = 0; childIndex < 8; childIndex++)
+				{
+					if (it->childrenMask & (1 << childIndex))
+					{
+						childSummaries[childCount] = levels[level + 1][it->childrenStart + childCount].summary;
+						childCount++;
+					}
+				}
+
+				OctreeNode& octreeNode = outNodes[it->node];
+				NormalClustering::Merge(childSummaries, childCount, settings->maxClusterIterations, it->summary);
+				octreeNode.SetClusters(it->summary);
+				octreeNode.properties.childrenMask = it->childrenMask;
+				octreeNode.childrenStartOrLeafPositionFactors = (UINT)levels[level + 1][it->childrenStart].node;
+			}
+		}
+
+		deleteFiles();
+		measure(statistics.cpuSeconds);
+	}
+	catch (...)
+	{
+		deleteFiles();
+		throw;
+	}
+
+	return statistics;
+}
+
+UINT64 PointCloudEngine::OutOfCoreOctreeBuilder::GetCell(const Vector3& rootPosition, float rootSize, UINT depth, const Vector3& vertexPosition)
+{
+	// Same cubes and comparisons as the builders
+	Vector3 position = rootPosition;
+	float size = rootSize;
+	UINT64 cell = 0;
+
+	for (UINT level = 0; level < depth; level++)
+	{
+		int childIndex = OctreeBuilder::GetChildIndex(position, vertexPosition);
+		cell = (cell << 3) | childIndex;
+		position = OctreeNode::GetChildPosition(position, size, childIndex);
+		size *= 0.5f;
+	}
+
+	return cell;
+}
+
+void PointCloudEngine::OutOfCoreOctreeBuilder::GetCellCube(const Vector3& rootPosition, float rootSize, UINT depth, UINT64 prefix, Vector3& outPosition, float& outSize)
+{
+	outPosition = rootPosition;
+	outSize = rootSize;
+
+	for (UINT level = 0; level < depth; level++)
+	{
+		int childIndex = (prefix >> (3 * (depth - level - 1))) & 7;
+		outPosition = OctreeNode::GetChildPosition(outPosition, outSize, childIndex);
+		outSize *= 0.5f;
+	}
+}
+
+void PointCloudEngine::OutOfCoreOctreeBuilder::GetLevelStarts(const std::vector<OctreeNode>& nodes, std::vector<UINT64>& outLevelStarts)
+{
+	// The children of each level follow each other in the next level
+	outLevelStarts.assign(1, 0);
+	UINT64 levelEnd = min((UINT64)nodes.size(), 1ULL);
+
+	while (outLevelStarts.back() < levelEnd)
+	{
+		UINT64 childCount = 0;
+
+		for (UINT64 i = outLevelStarts.back(); i < levelEnd; i++)
+		{
+			for (int childIndex = 0; childIndex < 8; childIndex++)
+			{
+				childCount += (nodes[i].properties.childrenMask >> childIndex) & 1;
+			}
+		}
+
+		outLevelStarts.push_back(levelEnd);
+		levelEnd += childCount;
+	}
+}
+
+std::wstring PointCloudEngine::OutOfCoreOctreeBuilder::GetFilename(const std::wstring& temporaryPrefix, const std::wstring& name)
+{
+	return temporaryPrefix + L"." + name;
+}
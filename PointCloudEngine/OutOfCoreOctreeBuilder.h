@@ -0,0 +1,87 @@
+#ifndef OUTOFCOREOCTREEBUILDER_H
+#define OUTOFCOREOCTREEBUILDER_H
+
+#pragma once
+#include "PointCloudEngine.h"
+
+namespace PointCloudEngine
+{
+	// Creates the octree of a .pointcloud file whose vertices do not fit into memory together with the builders
+	// The vertices are partitioned into the cells of the top levels (buckets) and written to temporary files, the subtree of each bucket is created on its own
+	// The nodes below the buckets are the same as the ones of the in memory builders, the clusters of the top levels are merged from the clusters of the buckets
+	class OutOfCoreOctreeBuilder
+	{
+	public:
+		// Seconds spent reading and writing files (including decoding the .pointcloud file) and computing, the bytes of the temporary files
+		struct Statistics
+		{
+			double ioSeconds = 0;
+			double cpuSeconds = 0;
+			UINT64 bytesWritten = 0;
+			UINT64 bytesRead = 0;
+			UINT bucketDepth = 0;
+			UINT64 bucketCount = 0;
+			UINT64 fileCount = 0;
+			UINT64 largestBucket = 0;
+
+			// Vertices of the largest block of chunks that is decoded at once, compressed chunks are decompressed one block at a time
+			UINT64 largestBlock = 0;
+		};
+
+		// The vertices of the buckets in each temporary file and the vertices of the builder take at most memoryLimit bytes
+		// A single bucket can exceed the limit when too many vertices share the cell of the deepest bucket level
+		// The names of the temporary files start with the temporary prefix (path and name), it has to be unique for each build that runs at the same time
+		static Statistics Build(const std::wstring& pointcloudFile, const std::wstring& temporaryPrefix, UINT64 memoryLimit, OctreeBuildMode mode, Vector3& outRootPosition, float& outRootSize, std::vector<OctreeNode>& outNodes);
+
+		// Peak heap memory per vertex of a bucket file with the morton builder and about two nodes per vertex
+		static const UINT64 bytesPerVertex = 3 * sizeof(Vertex) + 2 * sizeof(UINT64) + 2 * sizeof(PointcloudIndex) + 2 * sizeof(OctreeNode);
+
+	private:
+		// The buckets are at most this many levels below the root, the vertices are counted in the cells of this level first
+		static const UINT maxBucketDepth = 6;
+
+		// Number of temporary files that are written at the same time
+		static const UINT64 maxFileCount = 256;
+
+		// Vertices that are decoded from the .pointcloud file at once (whole chunks) and buffered for each temporary file
+		static const UINT64 blockVertexCount = 1 << 22;
+		static const UINT64 fileBufferVertexCount = 8 * 1024;
+
+		// A bucket is a cell at the bucket depth or a cell with a single vertex above it, the subtree nodes are stored in a temporary file
+		struct Bucket
+		{
+			UINT depth;
+			UINT64 prefix;
+			UINT64 count;
+			UINT64 file;
+			UINT64 nodesOffset;
+			std::vector<UINT64> levelStarts;
+			std::vector<UINT64> levelOffsets;
+			ClusterSummary summary;
+		};
+
+		// Cell of the top levels that is split into its children or the root of a bucket, the children are stored in the next level starting at childrenStart
+		struct TopCell
+		{
+			UINT64 prefix;
+			UINT64 bucket;
+			UINT64 childrenStart;
+			UINT64 node;
+			byte childrenMask;
+			ClusterSummary summary;
+		};
+
+		// Path of child indices from the root to the cell of the vertex at the given depth (the first level in the highest digit)
+		static UINT64 GetCell(const Vector3& rootPosition, float rootSize, UINT depth, const Vector3& vertexPosition);
+
+		// Follows the path of the cell from the root to compute its cube
+		static void GetCellCube(const Vector3& rootPosition, float rootSize, UINT depth, UINT64 prefix, Vector3& outPosition, float& outSize);
+
+		// Start of each level of a breadth first nodes array and its end
+		static void GetLevelStarts(const std::vector<OctreeNode>& nodes, std::vector<UINT64>& outLevelStarts);
+
+		static std::wstring GetFilename(const std::wstring& temporaryPrefix, const std::wstring& name);
+	};
+}
+
+#endif
@@ -59,47 +59,29 @@ ID3D11Buffer* nullBuffer[1] = { NULL };
 ID3D11UnorderedAccessView* nullUAV[1] = { NULL };
 ID3D11ShaderResourceView* nullSRV[1] = { NULL };
 
-bool LoadPointcloudFile(std::vector<Vertex>& outVertices, Vector3& outBoundingCubePosition, float& outBoundingCubeSize, const std::wstring& pointcloudFile)
+bool LoadPointcloudFile(std::vector<Vertex>& outVertices, Vector3& outBoundingCubePosition, float& outBoundingCubeSize, const std::wstring& pointcloudFile, const PointcloudSelection& selection)
 {
 	try
 	{
-		struct PointcloudVertex
-		{
-			// Stores the .pointcloud vertices
-			Vector3 position;
-			char normal[3];
-			unsigned char color[3];
-		};
-
-		// Try to load the point cloud from the file
-		// This file has a header with the bounding cube position and size followed by the length of the vertex array
-		// Then the position, 8bit normal and 8bit rgb color of each vertex is stored in binary data
-		std::ifstream file(pointcloudFile, std::ios::in | std::ios::binary);
-
-		// Load the bounding cube position and size
-		file.read((char*)&outBoundingCubePosition, sizeof(Vector3));
-		file.read((char*)&outBoundingCubeSize, sizeof(float));
+		// Map the file instead of reading it into a temporary array, the records are decoded straight from the mapping
+		PointcloudFile pointcloud;
 
-		// Load the size of the vertices vector
-		UINT vertexCount;
-		file.read((char*)&vertexCount, sizeof(UINT));
+		if (!pointcloud.Open(pointcloudFile))
+		{
+			return false;
+		}
 
-		// Read the binary data directly into the vertices vector
-		std::vector<PointcloudVertex> pointcloudVertices = std::vector<PointcloudVertex>(vertexCount);
-		file.read((char*)pointcloudVertices.data(), vertexCount * sizeof(PointcloudVertex));
+		outBoundingCubePosition = pointcloud.boundingCubePosition;
+		outBoundingCubeSize = pointcloud.boundingCubeSize;
 
-		// Convert to the required vertex format
-		outVertices = std::vector<Vertex>(vertexCount);
+		// Convert the selected chunks (all of them by default) to the required vertex format
+		std::vector<UINT64> selectedChunks = pointcloud.SelectChunks(selection);
+		outVertices.resize(pointcloud.GetVertexCount(selectedChunks));
 
-		for (UINT i = 0; i < vertexCount; i++)
+		if (!pointcloud.DecodeChunks(selectedChunks, outVertices.data(), selection.verifyChecksums))
 		{
-			outVertices[i].position = pointcloudVertices[i].position;
-			outVertices[i].normal.x = pointcloudVertices[i].normal[0] / 127.0f;
-			outVertices[i].normal.y = pointcloudVertices[i].normal[1] / 127.0f;
-			outVertices[i].normal.z = pointcloudVertices[i].normal[2] / 127.0f;
-			outVertices[i].color[0] = pointcloudVertices[i].color[0];
-			outVertices[i].color[1] = pointcloudVertices[i].color[1];
-			outVertices[i].color[2] = pointcloudVertices[i].color[2];
+			outVertices.clear();
+			return false;
 		}
 	}
 	catch (const std::exception& e)
@@ -150,12 +132,17 @@ void ChangeRenderingResolution(int newResolutionX, int newResolutionY)
 
 void DrawBlended(UINT vertexCount, ID3D11Buffer* constantBuffer, const void* constantBufferData, int &useBlending)
 {
-	// Draw with blending
+	DrawBlended([&]() { d3d11DevCon->Draw(vertexCount, 0); }, constantBuffer, constantBufferData, useBlending);
+}
+
+void DrawBlended(const std::function<void()>& draw, ID3D11Buffer* constantBuffer, const void* constantBufferData, int &useBlending)
+{
+	// Draw with blending, the draw function issues the draw calls of the splats (e.g. one for each vertex buffer)
 	// Before this is called all the shaders, buffers and resources have to be set already!
 	// Draw only the depth to the depth texture, don't draw any color
 	d3d11DevCon->ClearDepthStencilView(blendingDepthView, D3D11_CLEAR_DEPTH, 1.0f, 0);
 	d3d11DevCon->OMSetRenderTargets(0, NULL, blendingDepthView);
-	d3d11DevCon->Draw(vertexCount, 0);
+	draw();
 
 	// Draw again but this time with the actual depth buffer, render target and blending
 	useBlending = true;
@@ -172,7 +159,7 @@ void DrawBlended(UINT vertexCount, ID3D11Buffer* constantBuffer, const void* con
 	d3d11DevCon->OMSetDepthStencilState(disabledDepthStencilState, 0);
 
 	// Draw again only adding the colors and weights of the overlapping splats together
-	d3d11DevCon->Draw(vertexCount, 0);
+	draw();
 
 	// Unbind shader resources
 	d3d11DevCon->PSSetShaderResources(0, 1, nullSRV);
@@ -245,6 +232,27 @@ int CALLBACK WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
     // Load the settings
     settings = new Settings(pathPointCloudEngine + L"\\Settings.txt");
 
+	// Run the CPU benchmarks instead of the engine when started with "-benchmark file.pointcloud"
+	int argumentCount = 0;
+	LPWSTR* arguments = CommandLineToArgvW(GetCommandLineW(), &argumentCount);
+	bool runBenchmark = (arguments != NULL) && (argumentCount > 2) && (std::wstring(arguments[1]).compare(L"-benchmark") == 0);
+
+	if (runBenchmark)
+	{
+		Benchmark::Run(arguments[2]);
+	}
+
+	LocalFree(arguments);
+
+	if (runBenchmark)
+	{
+		SAFE_DELETE(settings);
+		Gdiplus::GdiplusShutdown(gdiplusToken);
+		CoUninitialize();
+
+		return S_OK;
+	}
+
 	InitializeWindow(hInstance, nShowCmd);
 	InitializeRenderingResources();
 	InitializeScene();
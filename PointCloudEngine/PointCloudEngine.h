@@ -49,6 +49,18 @@ namespace PointCloudEngine
 		OpticalFlowForward,
 		OpticalFlowBackward
 	};
+
+	// Queue subdivides the nodes breadth first on one thread by partitioning their vertex ranges (the original builder)
+	// Morton sorts the vertices by their paths from the root and derives the same nodes from the sorted ranges in parallel
+	// Subtrees creates the top levels like Queue and then the subtrees below them in parallel
+	// Aggregate creates the nodes like Morton but only clusters the leaves, the clusters of the parents are merged from the clusters of their children
+	enum class OctreeBuildMode
+	{
+		Queue,
+		Morton,
+		Subtrees,
+		Aggregate
+	};
 }
 
 using namespace PointCloudEngine;
@@ -62,11 +74,23 @@ using namespace PointCloudEngine;
 #include "Component.h"
 #include "SceneObject.h"
 #include "Hierarchy.h"
+#include "SIMD.h"
+#include "ThreadPool.h"
+#include "Hash.h"
+#include "Rans.h"
+#include "PointcloudCompression.h"
+#include "Morton.h"
+#include "RadixSort.h"
+#include "MappedFile.h"
+#include "PointcloudFile.h"
 #include "Structures.h"
 #include "Utils.h"
 #include "Settings.h"
 #include "IRenderer.h"
+#include "NormalClustering.h"
 #include "OctreeNode.h"
+#include "OctreeBuilder.h"
+#include "OutOfCoreOctreeBuilder.h"
 #include "Octree.h"
 #include "OBJFile.h"
 #include "TextRenderer.h"
@@ -77,6 +101,7 @@ using namespace PointCloudEngine;
 #include "PullPush.h"
 #include "GUI.h"
 #include "Scene.h"
+#include "Benchmark.h"
 
 // Global variables, accessable in other files
 extern std::wstring executablePath;
@@ -121,11 +146,12 @@ extern ID3D11Buffer* lightingConstantBuffer;
 extern LightingConstantBuffer lightingConstantBufferData;
 
 // Global function declarations
-extern bool LoadPointcloudFile(std::vector<Vertex> &outVertices, Vector3 &outBoundingCubePosition, float &outBoundingCubeSize, const std::wstring &pointcloudFile);
+extern bool LoadPointcloudFile(std::vector<Vertex> &outVertices, Vector3 &outBoundingCubePosition, float &outBoundingCubeSize, const std::wstring &pointcloudFile, const PointcloudSelection &selection = PointcloudSelection());
 extern void SaveScreenshotToFile();
 extern void SetFullscreen(bool fullscreen);
 extern void ChangeRenderingResolution(int newResolutionX, int newResolutionY);
 extern void DrawBlended(UINT vertexCount, ID3D11Buffer* constantBuffer, const void* constantBufferData, int &useBlending);
+extern void DrawBlended(const std::function<void()>& draw, ID3D11Buffer* constantBuffer, const void* constantBufferData, int &useBlending);
 extern void InitializeRenderingResources();
 
 // Function declarations
@@ -0,0 +1,316 @@
+#ifndef POINTCLOUDCOMPRESSION_H
+#define POINTCLOUDCOMPRESSION_H
+
+#pragma once
+
+// This header is shared with PlyToPointcloud and therefore only depends on the Windows API and the standard library
+#include <windows.h>
+#include <vector>
+#include <cstring>
+#include "Rans.h"
+
+namespace PointCloudEngine
+{
+	// Lossless compression of the vertex records of one chunk, every chunk can be decompressed independently
+	// The records are split into a position, a normal and a color stream that store the values column by column (all x, then all y, then all z)
+	// Positions are the float bits or the fixed point values of the encoding as integers, stored as zigzag encoded deltas with a variable number of bytes
+	// Normals and colors are stored as byte deltas, the deltas are small when the vertices have a spatial order
+	// Each stream is then compressed with rANS or stored as it is if that is smaller
+	// Chunks that do not get smaller are stored as uncompressed records, the size of the chunk tells them apart
+	namespace PointcloudCompression
+	{
+		enum class StreamMode : UINT64 { Raw = 0, Rans = 1 };
+
+		struct StreamHeader
+		{
+			StreamMode mode;
+			UINT64 rawSize;
+			UINT64 storedSize;
+		};
+
+		// Byte offsets of the normal and color inside the records of each encoding
+		struct RecordLayout
+		{
+			UINT size;
+			UINT normalOffset;
+			UINT colorOffset;
+		};
+
+		inline UINT64 ZigZag(UINT delta)
+		{
+			return (delta << 1) ^ (UINT)((int)delta >> 31);
+		}
+
+		inline UINT UnZigZag(UINT64 value)
+		{
+			return (UINT)(value >> 1) ^ (0U - (UINT)(value & 1));
+		}
+
+		inline void WriteVarint(UINT64 value, std::vector<BYTE>& output)
+		{
+			while (value >= 0x80)
+			{
+				output.push_back((BYTE)(value | 0x80));
+				value >>= 7;
+			}
+
+			output.push_back((BYTE)value);
+		}
+
+		inline bool ReadVarint(const BYTE*& pointer, const BYTE* end, UINT64& outValue)
+		{
+			// Most values take one or two bytes
+			if (end - pointer >= 2)
+			{
+				if (pointer[0] < 0x80)
+				{
+					outValue = *pointer++;
+					return true;
+				}
+
+				if (pointer[1] < 0x80)
+				{
+					outValue = (pointer[0] & 0x7F) | ((UINT64)pointer[1] << 7);
+					pointer += 2;
+					return true;
+				}
+			}
+
+			outValue = 0;
+
+			for (UINT shift = 0; shift < 64; shift += 7)
+			{
+				if (pointer == end)
+				{
+					return false;
+				}
+
+				BYTE value = *pointer++;
+				outValue |= (UINT64)(value & 0x7F) << shift;
+
+				if (value < 0x80)
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		inline void ReadPosition(const BYTE* record, UINT positionBits, UINT* outPosition)
+		{
+			if (positionBits == 16)
+			{
+				USHORT position[3];
+				memcpy(position, record, sizeof(position));
+				outPosition[0] = position[0];
+				outPosition[1] = position[1];
+				outPosition[2] = position[2];
+			}
+			else if (positionBits == 21)
+			{
+				UINT64 position;
+				memcpy(&position, record, sizeof(UINT64));
+				outPosition[0] = position & 0x1FFFFF;
+				outPosition[1] = (position >> 21) & 0x1FFFFF;
+				outPosition[2] = (position >> 42) & 0x1FFFFF;
+			}
+			else
+			{
+				memcpy(outPosition, record, 3 * sizeof(UINT));
+			}
+		}
+
+		// The 21 bit values are combined with the bits that are already in the record, the record has to be zero initially
+		inline void WritePositionComponent(BYTE* record, UINT positionBits, UINT axis, UINT value)
+		{
+			if (positionBits == 16)
+			{
+				USHORT component = (USHORT)value;
+				memcpy(record + axis * sizeof(USHORT), &component, sizeof(USHORT));
+			}
+			else if (positionBits == 21)
+			{
+				UINT64 position;
+				memcpy(&position, record, sizeof(UINT64));
+				position |= (UINT64)(value & 0x1FFFFF) << (21 * axis);
+				memcpy(record, &position, sizeof(UINT64));
+			}
+			else
+			{
+				memcpy(record + axis * sizeof(UINT), &value, sizeof(UINT));
+			}
+		}
+
+		inline void WriteStream(const std::vector<BYTE>& stream, std::vector<BYTE>& output)
+		{
+			std::vector<BYTE> encoded;
+			Rans::Encode(stream.data(), stream.size(), encoded);
+
+			StreamHeader header;
+			header.rawSize = stream.size();
+			header.mode = (encoded.size() < stream.size()) ? StreamMode::Rans : StreamMode::Raw;
+			header.storedSize = (header.mode == StreamMode::Rans) ? encoded.size() : stream.size();
+
+			const std::vector<BYTE>& stored = (header.mode == StreamMode::Rans) ? encoded : stream;
+			UINT64 offset = output.size();
+			output.resize(offset + sizeof(StreamHeader) + stored.size());
+			memcpy(output.data() + offset, &header, sizeof(StreamHeader));
+			memcpy(output.data() + offset + sizeof(StreamHeader), stored.data(), stored.size());
+		}
+
+		// Reads the next stream and advances the pointer, the raw bytes are decoded into the buffer
+		inline bool ReadStream(const BYTE*& pointer, const BYTE* end, UINT64 maxRawSize, std::vector<BYTE>& buffer)
+		{
+			StreamHeader header;
+
+			if ((UINT64)(end - pointer) < sizeof(StreamHeader))
+			{
+				return false;
+			}
+
+			memcpy(&header, pointer, sizeof(StreamHeader));
+			pointer += sizeof(StreamHeader);
+
+			if (header.storedSize > (UINT64)(end - pointer) || (header.mode == StreamMode::Raw && header.storedSize != header.rawSize) || header.rawSize > maxRawSize)
+			{
+				return false;
+			}
+
+			buffer.resize(header.rawSize);
+
+			if (header.mode == StreamMode::Raw)
+			{
+				memcpy(buffer.data(), pointer, header.rawSize);
+			}
+			else if (header.mode != StreamMode::Rans || !Rans::Decode(pointer, header.storedSize, buffer.data(), header.rawSize))
+			{
+				return false;
+			}
+
+			pointer += header.storedSize;
+
+			return true;
+		}
+
+		inline void Compress(const BYTE* records, UINT64 count, const RecordLayout& layout, UINT positionBits, std::vector<BYTE>& output)
+		{
+			std::vector<BYTE> stream;
+			stream.reserve(count * 3 * sizeof(UINT));
+			output.clear();
+
+			for (UINT axis = 0; axis < 3; axis++)
+			{
+				UINT previous = 0;
+
+				for (UINT64 i = 0; i < count; i++)
+				{
+					UINT position[3];
+					ReadPosition(records + i * layout.size, positionBits, position);
+					WriteVarint(ZigZag(position[axis] - previous), stream);
+					previous = position[axis];
+				}
+			}
+
+			WriteStream(stream, output);
+
+			// Normals and then colors
+			for (UINT offset : { layout.normalOffset, layout.colorOffset })
+			{
+				stream.resize(3 * count);
+
+				for (UINT component = 0; component < 3; component++)
+				{
+					BYTE previous = 0;
+					BYTE* column = stream.data() + component * count;
+
+					for (UINT64 i = 0; i < count; i++)
+					{
+						BYTE value = records[i * layout.size + offset + component];
+						column[i] = value - previous;
+						previous = value;
+					}
+				}
+
+				WriteStream(stream, output);
+			}
+
+			if (output.size() >= count * layout.size)
+			{
+				output.assign(records, records + count * layout.size);
+			}
+		}
+
+		// Returns false if the data is corrupted, the bytes of the records that are not part of a vertex are set to zero
+		inline bool Decompress(const BYTE* input, UINT64 size, UINT64 count, const RecordLayout& layout, UINT positionBits, BYTE* outRecords)
+		{
+			const BYTE* pointer = input;
+			const BYTE* end = input + size;
+			std::vector<BYTE> stream;
+
+			if (size == count * layout.size)
+			{
+				memcpy(outRecords, input, size);
+				return true;
+			}
+
+			memset(outRecords, 0, count * layout.size);
+
+			// Each position value takes at most five bytes
+			if (!ReadStream(pointer, end, 15 * count, stream))
+			{
+				return false;
+			}
+
+			const BYTE* streamPointer = stream.data();
+			const BYTE* streamEnd = stream.data() + stream.size();
+
+			for (UINT axis = 0; axis < 3; axis++)
+			{
+				UINT previous = 0;
+
+				for (UINT64 i = 0; i < count; i++)
+				{
+					UINT64 value;
+
+					if (!ReadVarint(streamPointer, streamEnd, value))
+					{
+						return false;
+					}
+
+					previous += UnZigZag(value);
+					WritePositionComponent(outRecords + i * layout.size, positionBits, axis, previous);
+				}
+			}
+
+			if (streamPointer != streamEnd)
+			{
+				return false;
+			}
+
+			for (UINT offset : { layout.normalOffset, layout.colorOffset })
+			{
+				if (!ReadStream(pointer, end, 3 * count, stream) || stream.size() != 3 * count)
+				{
+					return false;
+				}
+
+				for (UINT component = 0; component < 3; component++)
+				{
+					BYTE previous = 0;
+					const BYTE* column = stream.data() + component * count;
+
+					for (UINT64 i = 0; i < count; i++)
+					{
+						previous += column[i];
+						outRecords[i * layout.size + offset + component] = previous;
+					}
+				}
+			}
+
+			return pointer == end;
+		}
+	}
+}
+
+#endif
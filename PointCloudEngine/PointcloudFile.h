@@ -0,0 +1,942 @@
+#ifndef POINTCLOUDFILE_H
+#define POINTCLOUDFILE_H
+
+#pragma once
+
+// This header is shared with PlyToPointcloud and therefore only depends on the Windows API and SimpleMath
+#include <windows.h>
+#include <SimpleMath.h>
+#include <string>
+#include <cstring>
+#include <cstddef>
+#include <cmath>
+#include <cfloat>
+#include <vector>
+#include <algorithm>
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "SIMD.h"
+#include "Hash.h"
+#include "PointcloudCompression.h"
+
+using namespace DirectX::SimpleMath;
+
+namespace PointCloudEngine
+{
+	struct PointcloudVertex
+	{
+		// Stores the .pointcloud vertices
+		// The struct is padded to 20 bytes, the records in the file include these 2 padding bytes
+		Vector3 position;
+		char normal[3];
+		unsigned char color[3];
+	};
+
+	// Quantized records store the position as fixed point offsets inside the bounding cube
+	// The largest position error along each axis is half the size of a grid cell, the converter stores the measured error in the header
+	struct PointcloudVertexFixed16
+	{
+		// 16 bits per axis, 12 bytes without padding
+		USHORT position[3];
+		char normal[3];
+		unsigned char color[3];
+	};
+
+	struct PointcloudVertexFixed21
+	{
+		// 21 bits per axis packed into a little endian 64 bit integer (x in the lowest bits), 14 bytes without padding
+		BYTE position[8];
+		char normal[3];
+		unsigned char color[3];
+	};
+
+	struct Vertex
+	{
+		// Stores the .pointcloud file vertices
+		Vector3 position;
+		Vector3 normal;
+		byte color[3];
+
+		// Quantized splat radius (see PointcloudFile::DecodeRadius), zero if the file has no radii
+		byte radius;
+	};
+
+	// Version 2 files start with this magic number, it is a NaN when read as the bounding cube x coordinate of a version 1 file
+	const UINT pointcloudMagic = 0xFFFF5043;
+	const UINT pointcloudVersion = 2;
+
+	// Number of vertices per chunk that the converter writes, version 1 files are split into chunks of the same size when they are opened
+	const UINT64 pointcloudChunkSize = 1024 * 1024;
+
+	// Vertex counts and offsets are always 64 bit, the index arrays that hold one entry per vertex use this type
+	// Defining POINTCLOUD_32BIT_INDICES halves the memory of these arrays but limits the files to UINT_MAX vertices
+#ifdef POINTCLOUD_32BIT_INDICES
+	typedef UINT PointcloudIndex;
+#else
+	typedef UINT64 PointcloudIndex;
+#endif
+
+	const UINT64 maxPointcloudVertexCount = (sizeof(PointcloudIndex) < sizeof(UINT64)) ? UINT_MAX : ~0ULL;
+
+	// Order of the vertices in the file
+	// Random and stratified order allow selecting the density by looking at the first k vertices
+	// Spatial order sorts the vertices along a morton curve so that chunks can be skipped by region, each chunk is shuffled internally
+	// Morton order does not shuffle the chunks, neighboring vertices are close to each other which makes the compression more effective
+	enum class PointcloudOrder : UINT { Random = 0, Stratified = 1, Spatial = 2, Morton = 3 };
+
+	// Encoding of the vertex records, the normals and colors are always stored with 8 bits
+	enum class PointcloudEncoding : UINT { Float = 0, Fixed16 = 1, Fixed21 = 2 };
+
+	// Bits of the header flags
+	const UINT pointcloudFlagChecksums = 1;
+	const UINT pointcloudFlagCompressed = 2;
+	const UINT pointcloudFlagRadii = 4;
+
+	// Splat radii are stored with one byte per vertex on a logarithmic scale relative to the bounding cube size
+	const float pointcloudRadiusStepsPerOctave = 12.0f;
+
+	struct PointcloudHeader
+	{
+		// Stores the .pointcloud header of version 2 files
+		// New fields are only appended, files with a shorter header (smaller data offset) use the default values for the missing fields
+		UINT magic = pointcloudMagic;
+		UINT version = pointcloudVersion;
+		Vector3 boundingCubePosition;
+		float boundingCubeSize = 0;
+		UINT64 vertexCount = 0;
+		UINT64 seed = 0;
+		UINT64 dataOffset = sizeof(PointcloudHeader);
+		UINT64 chunkCount = 0;
+		UINT64 chunkDirectoryOffset = 0;
+		PointcloudOrder order = PointcloudOrder::Random;
+		UINT flags = 0;
+		PointcloudEncoding encoding = PointcloudEncoding::Float;
+		float positionError = 0;
+		UINT64 radiiOffset = 0;
+	};
+
+	struct PointcloudChunk
+	{
+		// Stores an entry of the chunk directory that follows the vertex data in version 2 files
+		UINT64 offset = 0;
+		UINT64 size = 0;
+		UINT64 vertexCount = 0;
+		Vector3 minPosition;
+		Vector3 maxPosition;
+		UINT64 checksum = 0;
+	};
+
+	// Selects a subset of the chunks when loading, by default all the chunks are selected
+	struct PointcloudSelection
+	{
+		// Indices of the chunks, empty selects all the chunks
+		std::vector<UINT64> chunks;
+
+		// Skip the chunks whose bounding box does not intersect the region
+		bool useRegion = false;
+		Vector3 regionMin;
+		Vector3 regionMax;
+
+		// Compare the checksums of the selected chunks if the file has them
+		bool verifyChecksums = false;
+	};
+
+	// Read-only view of a .pointcloud file that is memory mapped instead of read into a temporary array
+	// Version 1 files have a header with the bounding cube position and size followed by the length of the vertex array
+	// Version 2 files have the PointcloudHeader that also stores the seed and order of the vertices and the location of the chunk directory
+	// Then the position, 8bit normal and 8bit rgb color of each vertex is stored in binary data, the positions are either floats or quantized
+	// The chunk directory stores the byte offset, vertex count, bounding box and optional checksum of consecutive ranges of vertices
+	// Files with the radii flag store one quantized splat radius per vertex in vertex order after the chunk directory
+	// Compressed files store each chunk as an independently compressed block, these are decompressed in parallel when the file is opened
+	// Without decompressing them when opening, only DecodeChunks can read the vertices and it decompresses each selected chunk on its own
+	class PointcloudFile
+	{
+	public:
+		Vector3 boundingCubePosition;
+		float boundingCubeSize = 0;
+		UINT64 vertexCount = 0;
+		UINT version = 0;
+		UINT64 seed = 0;
+		UINT64 dataOffset = 0;
+		PointcloudOrder order = PointcloudOrder::Random;
+		UINT flags = 0;
+		PointcloudEncoding encoding = PointcloudEncoding::Float;
+		UINT recordSize = sizeof(PointcloudVertex);
+		float positionError = 0;
+		std::vector<PointcloudChunk> chunks;
+
+		// Files that are larger than the memory can leave their compressed chunks in the mapping until they are decoded
+		template<typename T> bool Open(const T& filename, bool decompress = true)
+		{
+			Close();
+			chunks.clear();
+
+			if (!mappedFile.Open(filename))
+			{
+				return false;
+			}
+
+			const BYTE* data = mappedFile.GetData();
+			UINT64 size = mappedFile.GetSize();
+			UINT64 chunkDirectoryOffset = 0;
+			UINT magic = 0;
+
+			if (size >= sizeof(UINT))
+			{
+				memcpy(&magic, data, sizeof(UINT));
+			}
+
+			if (magic == pointcloudMagic)
+			{
+				PointcloudHeader header;
+				const UINT64 minHeaderSize = offsetof(PointcloudHeader, dataOffset) + sizeof(UINT64);
+
+				if (size < minHeaderSize)
+				{
+					Close();
+					return false;
+				}
+
+				memcpy(&header, data, minHeaderSize);
+
+				if (header.version > pointcloudVersion || header.dataOffset < minHeaderSize || size < header.dataOffset || header.vertexCount > maxPointcloudVertexCount)
+				{
+					Close();
+					return false;
+				}
+
+				// The header fields that are stored in the file overwrite the default values
+				memcpy(&header, data, min(header.dataOffset, (UINT64)sizeof(PointcloudHeader)));
+
+				if (header.encoding > PointcloudEncoding::Fixed21)
+				{
+					Close();
+					return false;
+				}
+
+				version = header.version;
+				boundingCubePosition = header.boundingCubePosition;
+				boundingCubeSize = header.boundingCubeSize;
+				vertexCount = header.vertexCount;
+				seed = header.seed;
+				dataOffset = header.dataOffset;
+				order = header.order;
+				flags = header.flags;
+				encoding = header.encoding;
+				positionError = header.positionError;
+				radiiOffset = ((flags & pointcloudFlagRadii) != 0) ? header.radiiOffset : 0;
+
+				if (header.chunkCount > 0)
+				{
+					// Compare the count with the remaining bytes instead of computing the end, a corrupt count would overflow
+					if (header.chunkDirectoryOffset < dataOffset || header.chunkDirectoryOffset > size || header.chunkCount > (size - header.chunkDirectoryOffset) / sizeof(PointcloudChunk))
+					{
+						Close();
+						return false;
+					}
+
+					chunkDirectoryOffset = header.chunkDirectoryOffset;
+					chunks.resize(header.chunkCount);
+					memcpy(chunks.data(), data + header.chunkDirectoryOffset, header.chunkCount * sizeof(PointcloudChunk));
+				}
+			}
+			else
+			{
+				const UINT64 headerSize = sizeof(Vector3) + sizeof(float) + sizeof(UINT);
+
+				if (size < headerSize)
+				{
+					Close();
+					return false;
+				}
+
+				memcpy(&boundingCubePosition, data, sizeof(Vector3));
+				memcpy(&boundingCubeSize, data + sizeof(Vector3), sizeof(float));
+				UINT vertexCount32 = 0;
+				memcpy(&vertexCount32, data + sizeof(Vector3) + sizeof(float), sizeof(UINT));
+				vertexCount = vertexCount32;
+
+				version = 1;
+				seed = 0;
+				dataOffset = headerSize;
+				order = PointcloudOrder::Random;
+				flags = 0;
+				encoding = PointcloudEncoding::Float;
+				positionError = 0;
+				radiiOffset = 0;
+			}
+
+			recordSize = GetRecordSize(encoding);
+			positionMin = boundingCubePosition - 0.5f * Vector3(boundingCubeSize, boundingCubeSize, boundingCubeSize);
+			positionStep = GetPositionStep(encoding, boundingCubeSize);
+
+			// Compressed chunks are stored between the header and the chunk directory, uncompressed records fill the vertex array
+			bool compressed = (flags & pointcloudFlagCompressed) != 0;
+
+			// Bound the vertex count by the file size before computing any offsets from it, a corrupt count must not overflow
+			// Uncompressed records have to fit into the file, the converter writes at most pointcloudChunkSize vertices into each compressed chunk
+			UINT64 maxVertexCount = compressed ? chunks.size() * pointcloudChunkSize : (size - dataOffset) / recordSize;
+
+			if (vertexCount > maxVertexCount)
+			{
+				Close();
+				return false;
+			}
+
+			UINT64 dataEnd = compressed ? chunkDirectoryOffset : dataOffset + vertexCount * recordSize;
+
+			// Reject truncated files instead of reading past the end of the mapping
+			if (size < dataEnd || (compressed && chunks.empty() && vertexCount > 0) || (radiiOffset > 0 && (radiiOffset < dataEnd || radiiOffset > size || size - radiiOffset < vertexCount)))
+			{
+				Close();
+				return false;
+			}
+
+			if (chunks.empty())
+			{
+				CreateVirtualChunks();
+			}
+
+			// Every chunk has to be inside the vertex data, the chunks store the vertices in order
+			UINT64 chunkStart = 0;
+			chunkStarts.resize(chunks.size());
+
+			for (UINT64 i = 0; i < chunks.size(); i++)
+			{
+				const PointcloudChunk& chunk = chunks[i];
+				bool validSize = compressed || (chunk.size == chunk.vertexCount * recordSize && chunk.offset == dataOffset + chunkStart * recordSize);
+
+				if (!validSize || chunk.offset < dataOffset || chunk.offset > dataEnd || chunk.size > dataEnd - chunk.offset || chunk.vertexCount > vertexCount - chunkStart)
+				{
+					Close();
+					return false;
+				}
+
+				chunkStarts[i] = chunkStart;
+				chunkStart += chunk.vertexCount;
+			}
+
+			if (chunkStart != vertexCount)
+			{
+				Close();
+				return false;
+			}
+
+			if (compressed && !decompress)
+			{
+				records = NULL;
+			}
+			else if (compressed)
+			{
+				if (!DecompressChunks())
+				{
+					Close();
+					return false;
+				}
+
+				records = decompressedRecords.data();
+			}
+			else
+			{
+				records = data + dataOffset;
+			}
+
+			pointcloudVertices = (encoding == PointcloudEncoding::Float) ? (const PointcloudVertex*)records : NULL;
+			radii = (radiiOffset > 0) ? data + radiiOffset : NULL;
+
+			return true;
+		}
+
+		// Returns the indices of the selected chunks in ascending order
+		std::vector<UINT64> SelectChunks(const PointcloudSelection& selection) const
+		{
+			std::vector<UINT64> selectedChunks;
+
+			for (UINT64 i = 0; i < chunks.size(); i++)
+			{
+				if (!selection.chunks.empty() && std::find(selection.chunks.begin(), selection.chunks.end(), i) == selection.chunks.end())
+				{
+					continue;
+				}
+
+				if (selection.useRegion)
+				{
+					const PointcloudChunk& chunk = chunks[i];
+
+					if (chunk.maxPosition.x < selection.regionMin.x || chunk.maxPosition.y < selection.regionMin.y || chunk.maxPosition.z < selection.regionMin.z ||
+						chunk.minPosition.x > selection.regionMax.x || chunk.minPosition.y > selection.regionMax.y || chunk.minPosition.z > selection.regionMax.z)
+					{
+						continue;
+					}
+				}
+
+				selectedChunks.push_back(i);
+			}
+
+			return selectedChunks;
+		}
+
+		UINT64 GetVertexCount(const std::vector<UINT64>& selectedChunks) const
+		{
+			UINT64 count = 0;
+
+			for (auto it = selectedChunks.begin(); it != selectedChunks.end(); it++)
+			{
+				count += chunks[*it].vertexCount;
+			}
+
+			return count;
+		}
+
+		// Index of the first vertex of the chunk in the vertex array
+		UINT64 GetChunkStart(UINT64 chunk) const
+		{
+			return chunkStarts[chunk];
+		}
+
+		bool VerifyChunk(UINT64 chunk) const
+		{
+			if ((flags & pointcloudFlagChecksums) == 0)
+			{
+				return true;
+			}
+
+			return Hash::XXHash64(mappedFile.GetData() + chunks[chunk].offset, chunks[chunk].size) == chunks[chunk].checksum;
+		}
+
+		// Decodes the selected chunks one after the other into the output array, the chunks are processed in parallel
+		// Compressed chunks that were not decompressed by Open are decompressed into a temporary array of their own
+		// Returns false if the checksum of a chunk does not match or it cannot be decompressed, in that case the output is incomplete
+		bool DecodeChunks(const std::vector<UINT64>& selectedChunks, Vertex* outVertices, bool verifyChecksums) const
+		{
+			std::vector<UINT64> outputOffsets(selectedChunks.size());
+			std::atomic<bool> valid(true);
+			UINT64 outputOffset = 0;
+
+			for (UINT64 i = 0; i < selectedChunks.size(); i++)
+			{
+				outputOffsets[i] = outputOffset;
+				outputOffset += chunks[selectedChunks[i]].vertexCount;
+			}
+
+			ThreadPool::Get().ParallelFor(selectedChunks.size(), 1, [&](UINT64 start, UINT64 end)
+			{
+				for (UINT64 i = start; i < end; i++)
+				{
+					UINT64 chunk = selectedChunks[i];
+
+					if (verifyChecksums && !VerifyChunk(chunk))
+					{
+						valid = false;
+						continue;
+					}
+
+					UINT64 chunkStart = GetChunkStart(chunk);
+					Vertex* output = outVertices + outputOffsets[i];
+					std::vector<BYTE> chunkRecords;
+					const BYTE* input = records;
+
+					if (records == NULL)
+					{
+						if (!DecompressChunk(chunk, chunkRecords))
+						{
+							valid = false;
+							continue;
+						}
+
+						input = chunkRecords.data();
+					}
+					else
+					{
+						input += chunkStart * recordSize;
+					}
+
+					// Large chunks are split further so that a few chunks still use all the threads
+					ThreadPool::Get().ParallelFor(chunks[chunk].vertexCount, 64 * 1024, [&](UINT64 start, UINT64 end)
+					{
+						DecodeRecords(input + start * recordSize, chunkStart + start, (UINT)(end - start), output + start);
+					});
+				}
+			});
+
+			return valid;
+		}
+
+		// Releases the mapping and the decompressed records, the header values and the chunk directory stay valid
+		void Close()
+		{
+			mappedFile.Close();
+			records = NULL;
+			pointcloudVertices = NULL;
+			radii = NULL;
+			std::vector<BYTE>().swap(decompressedRecords);
+		}
+
+		// The packed records directly inside the mapped file, valid until the file is closed
+		// NULL for compressed files that were opened without decompressing them, GetVertex and DecodeVertices also need these records
+		const BYTE* GetRecords() const
+		{
+			return records;
+		}
+
+		// The packed records of files with float positions, NULL for quantized positions
+		const PointcloudVertex* GetPointcloudVertices() const
+		{
+			return pointcloudVertices;
+		}
+
+		// The quantized splat radius of each vertex, NULL if the file has no radii
+		const BYTE* GetRadii() const
+		{
+			return radii;
+		}
+
+		// Decodes a single vertex on access without materializing the whole vertex array
+		Vertex GetVertex(UINT64 index) const
+		{
+			Vertex vertex;
+			DecodeRecords(index, 1, &vertex);
+
+			return vertex;
+		}
+
+		// Decodes the vertices in parallel chunks with the widest instruction set that is supported
+		void DecodeVertices(UINT64 start, UINT64 count, Vertex* outVertices) const
+		{
+			ThreadPool::Get().ParallelFor(count, 64 * 1024, [&](UINT64 chunkStart, UINT64 chunkEnd)
+			{
+				DecodeRecords(start + chunkStart, (UINT)(chunkEnd - chunkStart), outVertices + chunkStart);
+			});
+		}
+
+		// Decodes the records single threaded with the kernel of the encoding, the count of a single call is small
+		void DecodeRecords(UINT64 start, UINT count, Vertex* outVertices) const
+		{
+			DecodeRecords(records + start * recordSize, start, count, outVertices);
+		}
+
+		// Same as above for records outside of the file, the input holds the record of the vertex at the start index
+		void DecodeRecords(const BYTE* input, UINT64 start, UINT count, Vertex* outVertices) const
+		{
+			switch (encoding)
+			{
+				case PointcloudEncoding::Fixed16:
+					DecodeFixed16Best((const PointcloudVertexFixed16*)input, count, positionMin, positionStep, outVertices);
+					break;
+				case PointcloudEncoding::Fixed21:
+					DecodeFixed21Best((const PointcloudVertexFixed21*)input, count, positionMin, positionStep, outVertices);
+					break;
+				default:
+					DecodeVerticesBest((const PointcloudVertex*)input, count, outVertices);
+					break;
+			}
+
+			// The kernels leave the radius zero, it shares the cache lines that were just written
+			if (radii != NULL)
+			{
+				for (UINT i = 0; i < count; i++)
+				{
+					outVertices[i].radius = radii[start + i];
+				}
+			}
+		}
+
+		static UINT GetRecordSize(PointcloudEncoding encoding)
+		{
+			switch (encoding)
+			{
+				case PointcloudEncoding::Fixed16:
+					return sizeof(PointcloudVertexFixed16);
+				case PointcloudEncoding::Fixed21:
+					return sizeof(PointcloudVertexFixed21);
+				default:
+					return sizeof(PointcloudVertex);
+			}
+		}
+
+		static PointcloudCompression::RecordLayout GetRecordLayout(PointcloudEncoding encoding)
+		{
+			switch (encoding)
+			{
+				case PointcloudEncoding::Fixed16:
+					return { sizeof(PointcloudVertexFixed16), offsetof(PointcloudVertexFixed16, normal), offsetof(PointcloudVertexFixed16, color) };
+				case PointcloudEncoding::Fixed21:
+					return { sizeof(PointcloudVertexFixed21), offsetof(PointcloudVertexFixed21, normal), offsetof(PointcloudVertexFixed21, color) };
+				default:
+					return { sizeof(PointcloudVertex), offsetof(PointcloudVertex, normal), offsetof(PointcloudVertex, color) };
+			}
+		}
+
+		static UINT GetPositionBits(PointcloudEncoding encoding)
+		{
+			switch (encoding)
+			{
+				case PointcloudEncoding::Fixed16:
+					return 16;
+				case PointcloudEncoding::Fixed21:
+					return 21;
+				default:
+					return 32;
+			}
+		}
+
+		// Size of a grid cell, the grid points include both sides of the bounding cube
+		static float GetPositionStep(PointcloudEncoding encoding, float boundingCubeSize)
+		{
+			if (encoding == PointcloudEncoding::Float)
+			{
+				return 0;
+			}
+
+			return boundingCubeSize / ((1U << GetPositionBits(encoding)) - 1);
+		}
+
+		// Largest error along each axis, rounding to the nearest grid point and the float rounding of the decoding
+		static float GetPositionErrorBound(PointcloudEncoding encoding, const Vector3& boundingCubePosition, float boundingCubeSize)
+		{
+			if (encoding == PointcloudEncoding::Float)
+			{
+				return 0;
+			}
+
+			float largestCoordinate = max(max(fabsf(boundingCubePosition.x), fabsf(boundingCubePosition.y)), fabsf(boundingCubePosition.z)) + 0.5f * boundingCubeSize;
+
+			return 0.5f * GetPositionStep(encoding, boundingCubeSize) + FLT_EPSILON * (boundingCubeSize + largestCoordinate);
+		}
+
+		// Rounds up so that the decoded radius is never smaller, zero radii (duplicate points) get the smallest code
+		static BYTE EncodeRadius(float radius, float boundingCubeSize)
+		{
+			if (!(radius > 0) || !(boundingCubeSize > 0))
+			{
+				return (boundingCubeSize > 0) ? 255 : 0;
+			}
+
+			float steps = floorf(pointcloudRadiusStepsPerOctave * log2f(boundingCubeSize / radius));
+
+			return (BYTE)(1 + min(254.0f, max(0.0f, steps)));
+		}
+
+		// Code zero means that the radius is unknown
+		static float DecodeRadius(BYTE code, float boundingCubeSize)
+		{
+			return (code == 0) ? 0 : boundingCubeSize * exp2f(-(code - 1) / pointcloudRadiusStepsPerOctave);
+		}
+
+		static void DecodeVertex(const PointcloudVertex& pointcloudVertex, Vertex& outVertex)
+		{
+			outVertex.position = pointcloudVertex.position;
+			outVertex.normal.x = pointcloudVertex.normal[0] / 127.0f;
+			outVertex.normal.y = pointcloudVertex.normal[1] / 127.0f;
+			outVertex.normal.z = pointcloudVertex.normal[2] / 127.0f;
+			outVertex.color[0] = pointcloudVertex.color[0];
+			outVertex.color[1] = pointcloudVertex.color[1];
+			outVertex.color[2] = pointcloudVertex.color[2];
+			outVertex.radius = 0;
+		}
+
+		// The multiplication and addition are separate operations in all the kernels so that they produce exactly the same floats
+		static Vector3 DecodePosition(UINT x, UINT y, UINT z, const Vector3& positionMin, float positionStep)
+		{
+			return Vector3(positionMin.x + (float)x * positionStep, positionMin.y + (float)y * positionStep, positionMin.z + (float)z * positionStep);
+		}
+
+		static void DecodeVertex(const PointcloudVertexFixed16& pointcloudVertex, const Vector3& positionMin, float positionStep, Vertex& outVertex)
+		{
+			outVertex.position = DecodePosition(pointcloudVertex.position[0], pointcloudVertex.position[1], pointcloudVertex.position[2], positionMin, positionStep);
+			outVertex.normal.x = pointcloudVertex.normal[0] / 127.0f;
+			outVertex.normal.y = pointcloudVertex.normal[1] / 127.0f;
+			outVertex.normal.z = pointcloudVertex.normal[2] / 127.0f;
+			outVertex.color[0] = pointcloudVertex.color[0];
+			outVertex.color[1] = pointcloudVertex.color[1];
+			outVertex.color[2] = pointcloudVertex.color[2];
+			outVertex.radius = 0;
+		}
+
+		static void DecodeVertex(const PointcloudVertexFixed21& pointcloudVertex, const Vector3& positionMin, float positionStep, Vertex& outVertex)
+		{
+			UINT64 position;
+			memcpy(&position, pointcloudVertex.position, sizeof(UINT64));
+
+			outVertex.position = DecodePosition(position & 0x1FFFFF, (position >> 21) & 0x1FFFFF, (position >> 42) & 0x1FFFFF, positionMin, positionStep);
+			outVertex.normal.x = pointcloudVertex.normal[0] / 127.0f;
+			outVertex.normal.y = pointcloudVertex.normal[1] / 127.0f;
+			outVertex.normal.z = pointcloudVertex.normal[2] / 127.0f;
+			outVertex.color[0] = pointcloudVertex.color[0];
+			outVertex.color[1] = pointcloudVertex.color[1];
+			outVertex.color[2] = pointcloudVertex.color[2];
+			outVertex.radius = 0;
+		}
+
+		// Single threaded decoding kernels, the vectorized ones produce exactly the same floats as the scalar one
+		static void DecodeVerticesBest(const PointcloudVertex* input, UINT count, Vertex* output)
+		{
+			if (SIMD::SupportsAVX2())
+			{
+				DecodeVerticesAVX2(input, count, output);
+			}
+			else if (SIMD::SupportsSSE41())
+			{
+				DecodeVerticesSSE41(input, count, output);
+			}
+			else
+			{
+				DecodeVerticesScalar(input, count, output);
+			}
+		}
+
+		static void DecodeVerticesScalar(const PointcloudVertex* input, UINT count, Vertex* output)
+		{
+			for (UINT i = 0; i < count; i++)
+			{
+				DecodeVertex(input[i], output[i]);
+			}
+		}
+
+		static void DecodeVerticesSSE41(const PointcloudVertex* input, UINT count, Vertex* output)
+		{
+			const __m128 scale = _mm_set1_ps(127.0f);
+
+			for (UINT i = 0; i < count; i++)
+			{
+				// The 16 byte loads at offset 0 and 4 both stay inside the 20 byte record
+				const BYTE* record = (const BYTE*)(input + i);
+				__m128 position = _mm_loadu_ps((const float*)record);
+				__m128i rest = _mm_loadu_si128((const __m128i*)(record + 4));
+
+				// Division instead of multiplication with the reciprocal to match the scalar rounding
+				__m128 normal = _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_srli_si128(rest, 8))), scale);
+
+				StoreVertex(position, normal, rest, output + i);
+			}
+		}
+
+		static void DecodeVerticesAVX2(const PointcloudVertex* input, UINT count, Vertex* output)
+		{
+			const __m256 scale = _mm256_set1_ps(127.0f);
+			UINT i = 0;
+
+			// Two vertices at once, the normals of both are converted in a single register
+			for (; i + 1 < count; i += 2)
+			{
+				const BYTE* record = (const BYTE*)(input + i);
+				__m128 positionA = _mm_loadu_ps((const float*)record);
+				__m128 positionB = _mm_loadu_ps((const float*)(record + sizeof(PointcloudVertex)));
+				__m128i restA = _mm_loadu_si128((const __m128i*)(record + 4));
+				__m128i restB = _mm_loadu_si128((const __m128i*)(record + sizeof(PointcloudVertex) + 4));
+
+				// Bytes 0 to 3 hold the normal of the first vertex, bytes 4 to 7 the normal of the second vertex
+				__m128i normalBytes = _mm_unpackhi_epi32(restA, restB);
+				__m256 normals = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(normalBytes)), scale);
+
+				StoreVertex(positionA, _mm256_castps256_ps128(normals), restA, output + i);
+				StoreVertex(positionB, _mm256_extractf128_ps(normals, 1), restB, output + i + 1);
+			}
+
+			// Avoid the penalty of mixing the upper ymm state with legacy SSE instructions
+			_mm256_zeroupper();
+
+			DecodeVerticesSSE41(input + i, count - i, output + i);
+		}
+
+		static void DecodeFixed16Best(const PointcloudVertexFixed16* input, UINT count, const Vector3& positionMin, float positionStep, Vertex* output)
+		{
+			if (SIMD::SupportsSSE41())
+			{
+				DecodeFixed16SSE41(input, count, positionMin, positionStep, output);
+			}
+			else
+			{
+				DecodeFixed16Scalar(input, count, positionMin, positionStep, output);
+			}
+		}
+
+		static void DecodeFixed16Scalar(const PointcloudVertexFixed16* input, UINT count, const Vector3& positionMin, float positionStep, Vertex* output)
+		{
+			for (UINT i = 0; i < count; i++)
+			{
+				DecodeVertex(input[i], positionMin, positionStep, output[i]);
+			}
+		}
+
+		static void DecodeFixed16SSE41(const PointcloudVertexFixed16* input, UINT count, const Vector3& positionMin, float positionStep, Vertex* output)
+		{
+			const __m128 scale = _mm_set1_ps(127.0f);
+			const __m128 step = _mm_set1_ps(positionStep);
+			const __m128 offset = _mm_setr_ps(positionMin.x, positionMin.y, positionMin.z, 0);
+			const __m128i colorShuffle = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 9, 10, 11, -1, -1, -1, -1, -1);
+
+			for (UINT i = 0; i < count; i++)
+			{
+				__m128i record = LoadRecord(input + i, i + 1 < count);
+
+				// The fourth lane of the position holds the first normal bytes, it is replaced by the normal x coordinate
+				__m128 position = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(record)), step), offset);
+				__m128 normal = _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_srli_si128(record, 6))), scale);
+
+				StoreVertexColors(position, normal, _mm_shuffle_epi8(record, colorShuffle), output + i);
+			}
+		}
+
+		static void DecodeFixed21Best(const PointcloudVertexFixed21* input, UINT count, const Vector3& positionMin, float positionStep, Vertex* output)
+		{
+			if (SIMD::SupportsSSE41())
+			{
+				DecodeFixed21SSE41(input, count, positionMin, positionStep, output);
+			}
+			else
+			{
+				DecodeFixed21Scalar(input, count, positionMin, positionStep, output);
+			}
+		}
+
+		static void DecodeFixed21Scalar(const PointcloudVertexFixed21* input, UINT count, const Vector3& positionMin, float positionStep, Vertex* output)
+		{
+			for (UINT i = 0; i < count; i++)
+			{
+				DecodeVertex(input[i], positionMin, positionStep, output[i]);
+			}
+		}
+
+		static void DecodeFixed21SSE41(const PointcloudVertexFixed21* input, UINT count, const Vector3& positionMin, float positionStep, Vertex* output)
+		{
+			const __m128 scale = _mm_set1_ps(127.0f);
+			const __m128 step = _mm_set1_ps(positionStep);
+			const __m128 offset = _mm_setr_ps(positionMin.x, positionMin.y, positionMin.z, 0);
+			const __m128i colorShuffle = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 11, 12, 13, -1, -1, -1, -1, -1);
+
+			for (UINT i = 0; i < count; i++)
+			{
+				__m128i record = LoadRecord(input + i, i + 1 < count);
+
+				UINT64 bits;
+				memcpy(&bits, input[i].position, sizeof(UINT64));
+				__m128i cell = _mm_setr_epi32((int)(bits & 0x1FFFFF), (int)((bits >> 21) & 0x1FFFFF), (int)((bits >> 42) & 0x1FFFFF), 0);
+
+				__m128 position = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(cell), step), offset);
+				__m128 normal = _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_srli_si128(record, 8))), scale);
+
+				StoreVertexColors(position, normal, _mm_shuffle_epi8(record, colorShuffle), output + i);
+			}
+		}
+	private:
+		MappedFile mappedFile;
+		const BYTE* records = NULL;
+		const PointcloudVertex* pointcloudVertices = NULL;
+		const BYTE* radii = NULL;
+		UINT64 radiiOffset = 0;
+		Vector3 positionMin;
+		float positionStep = 0;
+
+		// Index of the first vertex of each chunk
+		std::vector<UINT64> chunkStarts;
+
+		// Compressed files are decompressed into memory when they are opened
+		std::vector<BYTE> decompressedRecords;
+
+		bool DecompressChunks()
+		{
+			std::atomic<bool> valid(true);
+
+			// The vertex count of a corrupt file can still be too large for the memory
+			try
+			{
+				decompressedRecords.resize(vertexCount * recordSize);
+			}
+			catch (const std::bad_alloc&)
+			{
+				return false;
+			}
+
+			ThreadPool::Get().ParallelFor(chunks.size(), 1, [&](UINT64 start, UINT64 end)
+			{
+				for (UINT64 i = start; i < end && valid; i++)
+				{
+					if (!DecompressChunk(i, decompressedRecords.data() + chunkStarts[i] * recordSize))
+					{
+						valid = false;
+					}
+				}
+			});
+
+			return valid;
+		}
+
+		bool DecompressChunk(UINT64 chunk, BYTE* outRecords) const
+		{
+			const PointcloudChunk& entry = chunks[chunk];
+
+			return PointcloudCompression::Decompress(mappedFile.GetData() + entry.offset, entry.size, entry.vertexCount, GetRecordLayout(encoding), GetPositionBits(encoding), outRecords);
+		}
+
+		bool DecompressChunk(UINT64 chunk, std::vector<BYTE>& outRecords) const
+		{
+			// The vertex count of a corrupt chunk can still be too large for the memory
+			try
+			{
+				outRecords.resize(chunks[chunk].vertexCount * recordSize);
+			}
+			catch (const std::bad_alloc&)
+			{
+				return false;
+			}
+
+			return DecompressChunk(chunk, outRecords.data());
+		}
+
+		// Files without a chunk directory are split into chunks without bounding boxes, these cover the whole bounding cube
+		void CreateVirtualChunks()
+		{
+			Vector3 halfSize = 0.5f * Vector3(boundingCubeSize, boundingCubeSize, boundingCubeSize);
+
+			for (UINT64 start = 0; start < vertexCount; start += pointcloudChunkSize)
+			{
+				PointcloudChunk chunk;
+				chunk.vertexCount = min(pointcloudChunkSize, vertexCount - start);
+				chunk.offset = dataOffset + start * recordSize;
+				chunk.size = chunk.vertexCount * recordSize;
+				chunk.minPosition = boundingCubePosition - halfSize;
+				chunk.maxPosition = boundingCubePosition + halfSize;
+				chunks.push_back(chunk);
+			}
+		}
+
+		// The position register holds the record bytes 0 to 15, the normal register the decoded normal in the first three lanes
+		// The rest register holds the record bytes 4 to 19 with the colors in bytes 11 to 13
+		static void StoreVertex(__m128 position, __m128 normal, __m128i rest, Vertex* output)
+		{
+			const __m128i colorShuffle = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 11, 12, 13, -1, -1, -1, -1, -1);
+
+			StoreVertexColors(position, normal, _mm_shuffle_epi8(rest, colorShuffle), output);
+		}
+
+		// The colors register holds the color bytes in bytes 8 to 10 and zeros in byte 11 that become the radius
+		static void StoreVertexColors(__m128 position, __m128 normal, __m128i colors, Vertex* output)
+		{
+			// Position xyz and normal x, then normal yz and the color bytes with a zeroed radius byte
+			__m128 first = _mm_insert_ps(position, normal, 0x30);
+			__m128 second = _mm_blend_ps(_mm_shuffle_ps(normal, normal, _MM_SHUFFLE(0, 0, 2, 1)), _mm_castsi128_ps(colors), 0x4);
+
+			float* destination = (float*)output;
+			_mm_storeu_ps(destination, first);
+			_mm_storel_pi((__m64*)(destination + 4), second);
+			_mm_store_ss(destination + 6, _mm_movehl_ps(second, second));
+		}
+
+		// Quantized records are smaller than 16 bytes, the last record of a range is copied so that the load stays inside the mapping
+		template<typename T> static __m128i LoadRecord(const T* record, bool hasNext)
+		{
+			if (hasNext)
+			{
+				return _mm_loadu_si128((const __m128i*)record);
+			}
+
+			BYTE buffer[16] = {};
+			memcpy(buffer, record, sizeof(T));
+
+			return _mm_loadu_si128((const __m128i*)buffer);
+		}
+	};
+}
+
+#endif
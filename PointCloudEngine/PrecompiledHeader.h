@@ -18,6 +18,8 @@
 #include <limits>
 #include <map>
 #include <queue>
+#include <chrono>
+#include <thread>
 #include <math.h>
 #include <wincodec.h>
 #include <CommCtrl.h>
@@ -0,0 +1,85 @@
+#ifndef RADIXSORT_H
+#define RADIXSORT_H
+
+#pragma once
+
+// This header is shared with PlyToPointcloud and therefore only depends on the Windows API and the standard library
+#include <windows.h>
+#include <vector>
+#include <cstring>
+#include "ThreadPool.h"
+
+namespace PointCloudEngine
+{
+	// Stable parallel LSD radix sort of 64 bit keys together with their values (usually 32 or 64 bit indices), 8 bits per pass
+	// Only the lowest keyBits of the keys are sorted, the result does not depend on the number of threads
+	template<typename Value> void RadixSort(std::vector<UINT64>& keys, std::vector<Value>& values, UINT keyBits)
+	{
+		const UINT digitBits = 8;
+		const UINT digitCount = 1 << digitBits;
+		const UINT64 count = keys.size();
+
+		if (count < 2)
+		{
+			return;
+		}
+
+		UINT64 blockSize = max(64ULL * 1024, count / (4ULL * ThreadPool::Get().GetThreadCount()) + 1);
+		UINT64 blockCount = (count + blockSize - 1) / blockSize;
+
+		std::vector<UINT64> keysScratch(count);
+		std::vector<Value> valuesScratch(count);
+		std::vector<UINT64> blockOffsets(blockCount * digitCount);
+
+		for (UINT shift = 0; shift < keyBits; shift += digitBits)
+		{
+			// Histogram of the digits in each block
+			ThreadPool::Get().ParallelFor(blockCount, 1, [&](UINT64 start, UINT64 end)
+			{
+				for (UINT64 block = start; block < end; block++)
+				{
+					UINT64* histogram = blockOffsets.data() + block * digitCount;
+					memset(histogram, 0, digitCount * sizeof(UINT64));
+
+					for (UINT64 i = block * blockSize; i < min(count, (block + 1) * blockSize); i++)
+					{
+						histogram[(keys[i] >> shift) & (digitCount - 1)]++;
+					}
+				}
+			});
+
+			// Each block writes its part of a digit after the same digit of all the previous blocks
+			UINT64 offset = 0;
+
+			for (UINT digit = 0; digit < digitCount; digit++)
+			{
+				for (UINT64 block = 0; block < blockCount; block++)
+				{
+					UINT64 digitCountInBlock = blockOffsets[block * digitCount + digit];
+					blockOffsets[block * digitCount + digit] = offset;
+					offset += digitCountInBlock;
+				}
+			}
+
+			ThreadPool::Get().ParallelFor(blockCount, 1, [&](UINT64 start, UINT64 end)
+			{
+				for (UINT64 block = start; block < end; block++)
+				{
+					UINT64* offsets = blockOffsets.data() + block * digitCount;
+
+					for (UINT64 i = block * blockSize; i < min(count, (block + 1) * blockSize); i++)
+					{
+						UINT64 destination = offsets[(keys[i] >> shift) & (digitCount - 1)]++;
+						keysScratch[destination] = keys[i];
+						valuesScratch[destination] = values[i];
+					}
+				}
+			});
+
+			keys.swap(keysScratch);
+			values.swap(valuesScratch);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,228 @@
+#ifndef RANS_H
+#define RANS_H
+
+#pragma once
+
+// This header is shared with PlyToPointcloud and therefore only depends on the Windows API and the standard library
+#include <windows.h>
+#include <vector>
+#include <cstring>
+
+namespace PointCloudEngine
+{
+	// Order-0 range asymmetric numeral system entropy coder for byte streams (based on the byte-wise rANS coder by Fabian Giesen)
+	// Four interleaved states hide the latency of the decoding dependency chain, symbol i is coded with state i % 4
+	// The stream starts with the normalized frequencies of all 256 symbols, then the final states, then the renormalization bytes
+	namespace Rans
+	{
+		const UINT scaleBits = 12;
+		const UINT scale = 1 << scaleBits;
+		const UINT lowerBound = 1 << 23;
+		const UINT stateCount = 4;
+		const UINT64 tableSize = 256 * sizeof(USHORT);
+
+		// Scales the counts so that they sum up to the scale, every symbol that occurs keeps a frequency of at least one
+		inline void NormalizeFrequencies(const UINT64* counts, UINT64 total, UINT* outFrequencies)
+		{
+			UINT sum = 0;
+
+			for (UINT symbol = 0; symbol < 256; symbol++)
+			{
+				outFrequencies[symbol] = (counts[symbol] == 0) ? 0 : max(1U, (UINT)((counts[symbol] * scale) / total));
+				sum += outFrequencies[symbol];
+			}
+
+			// Correct the rounding error with the most frequent symbols, they lose the least compression
+			while (sum != scale)
+			{
+				UINT largest = 0;
+
+				for (UINT symbol = 1; symbol < 256; symbol++)
+				{
+					if (outFrequencies[symbol] > outFrequencies[largest])
+					{
+						largest = symbol;
+					}
+				}
+
+				if (sum < scale)
+				{
+					outFrequencies[largest] += scale - sum;
+					sum = scale;
+				}
+				else
+				{
+					UINT decrease = min(sum - scale, outFrequencies[largest] - 1);
+
+					// All the symbols have a frequency of one and there are more than the scale, impossible with 256 symbols
+					if (decrease == 0)
+					{
+						break;
+					}
+
+					outFrequencies[largest] -= decrease;
+					sum -= decrease;
+				}
+			}
+		}
+
+		inline void Encode(const BYTE* input, UINT64 count, std::vector<BYTE>& output)
+		{
+			UINT64 counts[256] = {};
+			UINT frequencies[256], starts[256];
+
+			for (UINT64 i = 0; i < count; i++)
+			{
+				counts[input[i]]++;
+			}
+
+			NormalizeFrequencies(counts, max(count, 1ULL), frequencies);
+
+			UINT start = 0;
+
+			for (UINT symbol = 0; symbol < 256; symbol++)
+			{
+				starts[symbol] = start;
+				start += frequencies[symbol];
+			}
+
+			// The encoder writes backwards, the renormalization writes at most two bytes per symbol
+			std::vector<BYTE> buffer(2 * count + stateCount * sizeof(UINT));
+			BYTE* end = buffer.data() + buffer.size();
+			BYTE* pointer = end;
+			UINT states[stateCount] = { lowerBound, lowerBound, lowerBound, lowerBound };
+
+			for (UINT64 i = count; i > 0; i--)
+			{
+				BYTE symbol = input[i - 1];
+				UINT& state = states[(i - 1) % stateCount];
+				UINT frequency = frequencies[symbol];
+				UINT stateMax = ((lowerBound >> scaleBits) << 8) * frequency;
+
+				while (state >= stateMax)
+				{
+					*--pointer = (BYTE)state;
+					state >>= 8;
+				}
+
+				state = ((state / frequency) << scaleBits) + (state % frequency) + starts[symbol];
+			}
+
+			// The decoder reads the states in ascending order
+			for (UINT i = stateCount; i > 0; i--)
+			{
+				pointer -= sizeof(UINT);
+				memcpy(pointer, &states[i - 1], sizeof(UINT));
+			}
+
+			output.resize(tableSize + (end - pointer));
+
+			for (UINT symbol = 0; symbol < 256; symbol++)
+			{
+				USHORT frequency = frequencies[symbol];
+				memcpy(output.data() + symbol * sizeof(USHORT), &frequency, sizeof(USHORT));
+			}
+
+			memcpy(output.data() + tableSize, pointer, end - pointer);
+		}
+
+		// Everything that the decoder needs for one slot in a single lookup
+		struct DecodeSlot
+		{
+			USHORT frequency;
+			USHORT offset;
+			BYTE symbol;
+		};
+
+		inline bool DecodeSymbol(UINT& state, const DecodeSlot* slots, const BYTE*& pointer, const BYTE* end, BYTE& outSymbol)
+		{
+			const DecodeSlot& slot = slots[state & (scale - 1)];
+
+			outSymbol = slot.symbol;
+			state = slot.frequency * (state >> scaleBits) + slot.offset;
+
+			while (state < lowerBound)
+			{
+				if (pointer == end)
+				{
+					return false;
+				}
+
+				state = (state << 8) | *pointer++;
+			}
+
+			return true;
+		}
+
+		// Returns false if the stream is corrupted, the reads never leave the input
+		inline bool Decode(const BYTE* input, UINT64 size, BYTE* output, UINT64 count)
+		{
+			if (size < tableSize + stateCount * sizeof(UINT))
+			{
+				return false;
+			}
+
+			std::vector<DecodeSlot> slots(scale);
+			UINT start = 0;
+
+			for (UINT symbol = 0; symbol < 256; symbol++)
+			{
+				USHORT frequency;
+				memcpy(&frequency, input + symbol * sizeof(USHORT), sizeof(USHORT));
+
+				if (start + frequency > scale)
+				{
+					return false;
+				}
+
+				for (UINT i = 0; i < frequency; i++)
+				{
+					slots[start + i] = { frequency, (USHORT)i, (BYTE)symbol };
+				}
+
+				start += frequency;
+			}
+
+			if (start != scale)
+			{
+				return false;
+			}
+
+			const BYTE* pointer = input + tableSize;
+			const BYTE* end = input + size;
+			UINT states[stateCount];
+
+			for (UINT i = 0; i < stateCount; i++)
+			{
+				memcpy(&states[i], pointer, sizeof(UINT));
+				pointer += sizeof(UINT);
+			}
+
+			// The states are independent until the renormalization, decoding them together keeps them in registers
+			UINT64 i = 0;
+
+			for (; i + stateCount <= count; i += stateCount)
+			{
+				if (!DecodeSymbol(states[0], slots.data(), pointer, end, output[i]) ||
+					!DecodeSymbol(states[1], slots.data(), pointer, end, output[i + 1]) ||
+					!DecodeSymbol(states[2], slots.data(), pointer, end, output[i + 2]) ||
+					!DecodeSymbol(states[3], slots.data(), pointer, end, output[i + 3]))
+				{
+					return false;
+				}
+			}
+
+			for (; i < count; i++)
+			{
+				if (!DecodeSymbol(states[i % stateCount], slots.data(), pointer, end, output[i]))
+				{
+					return false;
+				}
+			}
+
+			return pointer == end;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#pragma once
+
+// This header is shared with PlyToPointcloud and therefore only depends on the Windows API and the compiler intrinsics
+#include <windows.h>
+#include <intrin.h>
+#include <immintrin.h>
+
+namespace PointCloudEngine
+{
+	// Instruction sets that are detected at runtime, the scalar code path is always available
+	namespace SIMD
+	{
+		inline bool DetectSSE41()
+		{
+			int info[4];
+			__cpuid(info, 1);
+
+			return (info[2] & (1 << 19)) != 0;
+		}
+
+		inline bool DetectAVX2()
+		{
+			int info[4];
+			__cpuid(info, 0);
+
+			if (info[0] < 7)
+			{
+				return false;
+			}
+
+			// The operating system has to save the ymm registers on context switches (OSXSAVE and XCR0)
+			__cpuid(info, 1);
+			bool osxsave = (info[2] & (1 << 27)) != 0;
+			bool avx = (info[2] & (1 << 28)) != 0;
+
+			if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+			{
+				return false;
+			}
+
+			__cpuidex(info, 7, 0);
+
+			return (info[1] & (1 << 5)) != 0;
+		}
+
+		inline bool SupportsSSE41()
+		{
+			static const bool supported = DetectSSE41();
+			return supported;
+		}
+
+		inline bool SupportsAVX2()
+		{
+			static const bool supported = DetectAVX2();
+			return supported;
+		}
+	}
+}
+
+#endif
@@ -49,6 +49,7 @@ PointCloudEngine::Settings::Settings(std::wstring filename)
 		TryParse(NAMEOF(pointcloudFile), &pointcloudFile);
 		TryParse(NAMEOF(samplingRate), &samplingRate);
 		TryParse(NAMEOF(scale), &scale);
+		TryParse(NAMEOF(useSplatRadii), &useSplatRadii);
 
 		// Parse lighting parameters
 		TryParse(NAMEOF(useLighting), &useLighting);
@@ -108,6 +109,11 @@ PointCloudEngine::Settings::Settings(std::wstring filename)
 		TryParse(NAMEOF(useCulling), &useCulling);
 		TryParse(NAMEOF(useGPUTraversal), &useGPUTraversal);
 		TryParse(NAMEOF(maxOctreeDepth), &maxOctreeDepth);
+		TryParse(NAMEOF(octreeBuildMode), &octreeBuildMode);
+		TryParse(NAMEOF(maxClusterIterations), &maxClusterIterations);
+		TryParse(NAMEOF(useKMeansPlusPlus), &useKMeansPlusPlus);
+		TryParse(NAMEOF(octreeMemoryLimit), &octreeMemoryLimit);
+		TryParse(NAMEOF(octreeCacheSize), &octreeCacheSize);
 		TryParse(NAMEOF(overlapFactor), &overlapFactor);
 		TryParse(NAMEOF(splatResolution), &splatResolution);
 		TryParse(NAMEOF(appendBufferCount), &appendBufferCount);
@@ -162,10 +168,10 @@ std::wstring PointCloudEngine::Settings::ToKeyValueString()
 	settingsStream << std::endl;
 
 	settingsStream << L"# Pointcloud File Parameters" << std::endl;
-	settingsStream << L"# Delete old .octree files when changing the " << NAMEOF(maxOctreeDepth) << std::endl;
 	settingsStream << NAMEOF(pointcloudFile) << L"=" << pointcloudFile << std::endl;
 	settingsStream << NAMEOF(samplingRate) << L"=" << samplingRate << std::endl;
 	settingsStream << NAMEOF(scale) << L"=" << scale << std::endl;
+	settingsStream << NAMEOF(useSplatRadii) << L"=" << useSplatRadii << std::endl;
 	settingsStream << std::endl;
 
 	settingsStream << L"# Lighting Parameters" << std::endl;
@@ -233,6 +239,11 @@ std::wstring PointCloudEngine::Settings::ToKeyValueString()
 	settingsStream << NAMEOF(useCulling) << L"=" << useCulling << std::endl;
 	settingsStream << NAMEOF(useGPUTraversal) << L"=" << useGPUTraversal << std::endl;
 	settingsStream << NAMEOF(maxOctreeDepth) << L"=" << maxOctreeDepth << std::endl;
+	settingsStream << NAMEOF(octreeBuildMode) << L"=" << (int)octreeBuildMode << std::endl;
+	settingsStream << NAMEOF(maxClusterIterations) << L"=" << maxClusterIterations << std::endl;
+	settingsStream << NAMEOF(useKMeansPlusPlus) << L"=" << useKMeansPlusPlus << std::endl;
+	settingsStream << NAMEOF(octreeMemoryLimit) << L"=" << octreeMemoryLimit << std::endl;
+	settingsStream << NAMEOF(octreeCacheSize) << L"=" << octreeCacheSize << std::endl;
 	settingsStream << NAMEOF(overlapFactor) << L"=" << overlapFactor << std::endl;
 	settingsStream << NAMEOF(splatResolution) << L"=" << splatResolution << std::endl;
 	settingsStream << NAMEOF(appendBufferCount) << L"=" << appendBufferCount << std::endl;
@@ -44,6 +44,9 @@ namespace PointCloudEngine
 		float samplingRate = 0.01f;
 		float scale = 1.0f;
 
+		// Size the splats with the per vertex radii of the .pointcloud file if it has them (PlyToPointcloud -radii)
+		bool useSplatRadii = true;
+
 		// Lighting parameters
 		bool useLighting = true;
 		bool useHeadlight = true;
@@ -103,6 +106,11 @@ namespace PointCloudEngine
 		bool useGPUTraversal = true;
 		int octreeLevel = -1;
 		int maxOctreeDepth = 16;
+		OctreeBuildMode octreeBuildMode = OctreeBuildMode::Morton;
+		UINT maxClusterIterations = 32;
+		bool useKMeansPlusPlus = false;
+		UINT octreeMemoryLimit = 0;
+		UINT octreeCacheSize = 16384;
 		float overlapFactor = 2.0f;
 		float splatResolution = 0.01f;
 		UINT appendBufferCount = 6000000;
@@ -157,6 +165,10 @@ namespace PointCloudEngine
 				{
 					*((ShadingMode*)outParameterValue) = (ShadingMode)std::stoi(settingsMap[parameterName]);
 				}
+				else if (typeid(T) == typeid(OctreeBuildMode))
+				{
+					*((OctreeBuildMode*)outParameterValue) = (OctreeBuildMode)std::stoi(settingsMap[parameterName]);
+				}
 				else
 				{
 					ERROR_MESSAGE(NAMEOF(TryParse) + L" cannot parse " + parameterName + L" because its type is unknown!");
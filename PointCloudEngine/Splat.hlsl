@@ -22,7 +22,9 @@ void GS(point VS_OUTPUT input[1], inout TriangleStream<GS_SPLAT_OUTPUT> output)
     float3 cameraForward = float3(View[0][2], View[1][2], View[2][2]);
 
     // Billboard should face in the same direction as the normal
-	float splatSizeWorld = length(mul(float3(samplingRate, 0, 0), World).xyz);
+	// The per vertex radii cover the local point spacing, the sampling rate is the fallback for files without radii
+	float splatSize = (useRadii && input[0].radius > 0) ? 2 * input[0].radius : samplingRate;
+	float splatSizeWorld = length(mul(float3(splatSize, 0, 0), World).xyz);
     float3 up = 0.5f * splatSizeWorld * normalize(cross(input[0].normal, cameraRight));
     float3 right = 0.5f * splatSizeWorld * normalize(cross(input[0].normal, up));
 
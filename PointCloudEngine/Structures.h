@@ -90,14 +90,6 @@ namespace PointCloudEngine
 		}
     };
 
-    struct Vertex
-    {
-        // Stores the .pointcloud file vertices
-        Vector3 position;
-        Vector3 normal;
-        byte color[3];
-    };
-
 	struct MeshVertex
 	{
 		// Instead of storing the actual vertex data, gather it from buffers in the vertex shader
@@ -138,7 +130,11 @@ namespace PointCloudEngine
     {
         UINT nodesIndex;
 		UINT childrenIndex;
-        std::vector<Vertex> vertices;
+
+		// Range of the vertices of this node in the vertex array that is shared by all the entries
+		UINT64 begin;
+		UINT64 end;
+
         Vector3 position;
         float size;
         int depth;
@@ -229,6 +225,10 @@ namespace PointCloudEngine
 		int textureLOD;
 		int resolutionX;
 		int resolutionY;
+		float radiusScale;
+		int useRadii;				// Bool in the shader
+		float padding0;
+		float padding1;
 	};
 
 	struct LightingConstantBuffer
@@ -0,0 +1,208 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#pragma once
+
+// This header is shared with PlyToPointcloud and therefore only depends on the Windows API and the standard library
+#include <windows.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+
+namespace PointCloudEngine
+{
+	// Persistent worker threads that execute loops split into chunks
+	// The calling thread also executes chunks and only waits for chunks that are already being executed by other threads
+	// Therefore ParallelFor can be called from inside another ParallelFor without deadlocking
+	class ThreadPool
+	{
+	public:
+		static ThreadPool& Get()
+		{
+			static ThreadPool threadPool;
+			return threadPool;
+		}
+
+		// Number of threads that execute chunks, including the calling thread
+		UINT GetThreadCount() const
+		{
+			return activeWorkers + 1;
+		}
+
+		// Limits the number of threads that execute chunks (at least the calling thread), e.g. to measure the scaling of a benchmark
+		// Zero uses all the hardware threads again
+		void SetThreadLimit(UINT threadLimit)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				activeWorkers = (threadLimit == 0) ? (UINT)workers.size() : min((UINT)workers.size(), max(threadLimit, 1U) - 1);
+			}
+
+			condition.notify_all();
+		}
+
+		// Calls function(start, end) for consecutive ranges of at most chunkSize elements in [0, count)
+		void ParallelFor(UINT64 count, UINT64 chunkSize, const std::function<void(UINT64, UINT64)>& function)
+		{
+			if (count == 0)
+			{
+				return;
+			}
+
+			chunkSize = max(chunkSize, 1ULL);
+
+			// Avoid the synchronization overhead if there is nothing to split
+			if (count <= chunkSize || activeWorkers == 0)
+			{
+				for (UINT64 start = 0; start < count; start += chunkSize)
+				{
+					function(start, min(start + chunkSize, count));
+				}
+
+				return;
+			}
+
+			std::shared_ptr<Job> job = std::make_shared<Job>(count, chunkSize, function);
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				jobs.push_back(job);
+			}
+
+			condition.notify_all();
+
+			while (job->ExecuteChunk());
+
+			RemoveJob(job);
+
+			std::unique_lock<std::mutex> lock(job->mutex);
+			job->condition.wait(lock, [&] { return job->remainingChunks == 0; });
+		}
+
+	private:
+		struct Job
+		{
+			UINT64 count;
+			UINT64 chunkSize;
+			UINT64 chunkCount;
+			std::function<void(UINT64, UINT64)> function;
+			std::atomic<UINT64> nextChunk;
+			std::atomic<UINT64> remainingChunks;
+			std::mutex mutex;
+			std::condition_variable condition;
+
+			Job(UINT64 count, UINT64 chunkSize, const std::function<void(UINT64, UINT64)>& function) : count(count), chunkSize(chunkSize), function(function)
+			{
+				chunkCount = (count + chunkSize - 1) / chunkSize;
+				nextChunk = 0;
+				remainingChunks = chunkCount;
+			}
+
+			// Returns false if all the chunks are already claimed by other threads
+			bool ExecuteChunk()
+			{
+				UINT64 chunk = nextChunk++;
+
+				if (chunk >= chunkCount)
+				{
+					return false;
+				}
+
+				UINT64 start = chunk * chunkSize;
+				function(start, min(start + chunkSize, count));
+
+				if (--remainingChunks == 0)
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					condition.notify_all();
+				}
+
+				return true;
+			}
+		};
+
+		std::vector<std::thread> workers;
+		std::atomic<UINT> activeWorkers;
+		std::deque<std::shared_ptr<Job>> jobs;
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool stop = false;
+
+		ThreadPool()
+		{
+			UINT hardwareThreads = std::thread::hardware_concurrency();
+			activeWorkers = max(hardwareThreads, 1U) - 1;
+
+			for (UINT i = 0; i < activeWorkers; i++)
+			{
+				workers.push_back(std::thread(&ThreadPool::Work, this, i));
+			}
+		}
+
+		~ThreadPool()
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				stop = true;
+			}
+
+			condition.notify_all();
+
+			for (auto it = workers.begin(); it != workers.end(); it++)
+			{
+				it->join();
+			}
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// Workers above the thread limit wait until the limit is raised again
+		void Work(UINT index)
+		{
+			while (true)
+			{
+				std::shared_ptr<Job> job;
+
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					condition.wait(lock, [&] { return stop || (!jobs.empty() && index < activeWorkers); });
+
+					if (jobs.empty() || index >= activeWorkers)
+					{
+						return;
+					}
+
+					job = jobs.front();
+				}
+
+				// Newer jobs get picked up once all the chunks of the oldest job are claimed
+				if (!job->ExecuteChunk())
+				{
+					RemoveJob(job);
+				}
+			}
+		}
+
+		void RemoveJob(const std::shared_ptr<Job>& job)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			for (auto it = jobs.begin(); it != jobs.end(); it++)
+			{
+				if (*it == job)
+				{
+					jobs.erase(it);
+					break;
+				}
+			}
+		}
+	};
+}
+
+#endif